@@ -0,0 +1,253 @@
+#include "AsyncLogging.h"
+#include "LogFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <stdio.h>
+
+static std::atomic<uint64_t> s_nextId(0);
+
+AsyncLogging::AsyncLogging(const std::string &basename, off_t rollSize, int flushInterval, int rollInterval)
+    : basename_(basename)
+    , rollSize_(rollSize)
+    , flushInterval_(flushInterval)
+    , rollInterval_(rollInterval)
+    , id_(++s_nextId)
+    , running_(false)
+    , thread_(std::bind(&AsyncLogging::threadFunc, this), "Logging")
+    , pendingBuffers_(0)
+    , droppedBytes_(0)
+    , droppedMessages_(0)
+    , roundsStarted_(0)
+    , roundsFinished_(0)
+    , flushRequested_(false)
+{
+}
+
+AsyncLogging::~AsyncLogging()
+{
+    if (running_)
+    {
+        stop();
+    }
+}
+
+void AsyncLogging::start()
+{
+    running_ = true;
+    thread_.start();
+}
+
+void AsyncLogging::stop()
+{
+    if (!thread_.started())
+    {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        running_ = false;
+        cond_.notify_one();
+    }
+    thread_.join();
+}
+
+void AsyncLogging::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!running_)
+    {
+        return;
+    }
+    // 正在进行的这一轮可能已经收集过缓冲区了，要等下一轮写完
+    const uint64_t target = roundsStarted_ + 1;
+    flushRequested_ = true;
+    cond_.notify_one();
+    flushedCond_.wait(lock, [&]() { return roundsFinished_ >= target; });
+}
+
+AsyncLogging::BufferPtr AsyncLogging::newBuffer()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!freeBuffers_.empty())
+    {
+        BufferPtr buffer = std::move(freeBuffers_.back());
+        freeBuffers_.pop_back();
+        return buffer;
+    }
+    lock.unlock();
+
+    BufferPtr buffer(new std::string);
+    buffer->reserve(kBufferSize);
+    return buffer;
+}
+
+AsyncLogging::ThreadBuffer& AsyncLogging::threadBuffer()
+{
+    // 线程退出的时候标记一下，后台线程写完它剩下的日志以后删掉
+    struct Holder
+    {
+        uint64_t owner = 0;
+        ThreadBufferPtr buffer;
+
+        ~Holder() { release(); }
+        void release()
+        {
+            if (buffer)
+            {
+                std::unique_lock<std::mutex> lock(buffer->mutex);
+                buffer->exited = true;
+            }
+            buffer.reset();
+        }
+    };
+    static thread_local Holder t_holder;
+
+    if (t_holder.owner != id_)
+    {
+        // 这个线程之前在往另一个AsyncLogging写，旧的缓冲区交给那边的后台线程处理
+        t_holder.release();
+        ThreadBufferPtr buffer = std::make_shared<ThreadBuffer>();
+        buffer->current = newBuffer();
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            threadBuffers_.push_back(buffer);
+        }
+        t_holder.owner = id_;
+        t_holder.buffer = std::move(buffer);
+    }
+    return *t_holder.buffer;
+}
+
+void AsyncLogging::append(const char *logline, size_t len)
+{
+    ThreadBuffer &tb = threadBuffer();
+    std::unique_lock<std::mutex> lock(tb.mutex);
+    if (tb.current->size() + len > kBufferSize && !tb.current->empty())
+    {
+        if (pendingBuffers_ >= kMaxPendingBuffers)
+        {
+            // 磁盘跟不上了，丢掉这个缓冲区，不能让内存无限增长，也不能阻塞前台线程
+            droppedBytes_ += tb.current->size();
+            droppedMessages_ += std::count(tb.current->begin(), tb.current->end(), '\n');
+            tb.current->clear();
+        }
+        else
+        {
+            tb.full.push_back(std::move(tb.current));
+            tb.current = newBuffer();
+            // 加锁通知，避免后台线程检查完pendingBuffers_还没开始等的时候错过通知
+            std::unique_lock<std::mutex> pendingLock(mutex_);
+            ++pendingBuffers_;
+            cond_.notify_one();
+        }
+    }
+    tb.current->append(logline, len);
+}
+
+void AsyncLogging::collectBuffers(BufferVector &buffers)
+{
+    std::vector<ThreadBufferPtr> threads;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        threads = threadBuffers_;
+    }
+
+    size_t taken = 0;
+    std::vector<ThreadBuffer*> exited;
+    for (const ThreadBufferPtr &tb : threads)
+    {
+        // 加锁的顺序和append一样：先线程的锁，newBuffer里再拿mutex_
+        std::unique_lock<std::mutex> lock(tb->mutex);
+        taken += tb->full.size();
+        for (BufferPtr &buffer : tb->full)
+        {
+            buffers.push_back(std::move(buffer));
+        }
+        tb->full.clear();
+
+        if (tb->exited)
+        {
+            if (tb->current && !tb->current->empty())
+            {
+                buffers.push_back(std::move(tb->current));
+            }
+            exited.push_back(tb.get());
+        }
+        else if (!tb->current->empty())
+        {
+            buffers.push_back(std::move(tb->current));
+            tb->current = newBuffer();
+        }
+    }
+    pendingBuffers_ -= taken;
+
+    if (!exited.empty())
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        threadBuffers_.erase(std::remove_if(threadBuffers_.begin(), threadBuffers_.end(),
+            [&](const ThreadBufferPtr &tb)
+            {
+                return std::find(exited.begin(), exited.end(), tb.get()) != exited.end();
+            }),
+            threadBuffers_.end());
+    }
+}
+
+void AsyncLogging::threadFunc()
+{
+    LogFile output(basename_, rollSize_, rollInterval_);
+    BufferVector buffersToWrite;
+    uint64_t reportedDropped = 0;
+    bool exit = false;
+
+    while (!exit)
+    {
+        uint64_t round = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (running_ && pendingBuffers_ == 0 && !flushRequested_)
+            {
+                cond_.wait_for(lock, std::chrono::seconds(flushInterval_));
+            }
+            flushRequested_ = false;
+            // stop()以后还要再写最后一轮
+            exit = !running_;
+            round = ++roundsStarted_;
+        }
+
+        collectBuffers(buffersToWrite);
+
+        const uint64_t dropped = droppedMessages_;
+        if (dropped != reportedDropped)
+        {
+            char buf[256] = {0};
+            int n = snprintf(buf, sizeof buf, "[ERROR] AsyncLogging dropped %lu log messages (%lu bytes) in total, disk is too slow\n",
+                (unsigned long)dropped, (unsigned long)droppedBytes_.load());
+            output.append(buf, n);
+            reportedDropped = dropped;
+        }
+        for (const BufferPtr &buffer : buffersToWrite)
+        {
+            output.append(buffer->data(), buffer->size());
+        }
+        output.flush();
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            for (BufferPtr &buffer : buffersToWrite)
+            {
+                // 特别长的日志会把缓冲区撑大，这种就不留着复用了
+                if (freeBuffers_.size() < kMaxPendingBuffers && buffer->capacity() <= 2 * kBufferSize)
+                {
+                    buffer->clear();
+                    freeBuffers_.push_back(std::move(buffer));
+                }
+            }
+            roundsFinished_ = round;
+            flushedCond_.notify_all();
+        }
+        buffersToWrite.clear();
+    }
+}
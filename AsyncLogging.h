@@ -0,0 +1,91 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ *  异步日志的后端：前台线程只把日志拷贝到自己线程的缓冲区，后台线程负责写文件（LogFile，按大小和时间滚动）
+ *
+ *  用法：
+ *      AsyncLogging log("/tmp/server", 500*1000*1000);
+ *      log.start();
+ *      Logger::instance().setOutput(std::bind(&AsyncLogging::append, &log, _1, _2));
+ *      Logger::instance().setFlush(std::bind(&AsyncLogging::flush, &log));
+ *
+ *  每个线程有自己的前台缓冲区，平时只锁自己的（基本没有竞争），写满了就挂到自己的待写队列上，
+ *  后台线程被唤醒或者每隔flushInterval秒把所有线程写满的和正在写的缓冲区换走，一起写到文件里，
+ *  同一个线程的日志顺序不变
+ *  磁盘跟不上、待写的缓冲区超过kMaxPendingBuffers个时，新写满的缓冲区直接丢掉，记到droppedBytes/droppedMessages中，
+ *  后台线程会在文件里写一行丢了多少
+ */
+class AsyncLogging : noncopyable
+{
+public:
+    static const size_t kBufferSize = 256*1024;
+    static const size_t kMaxPendingBuffers = 64;
+
+    AsyncLogging(const std::string &basename, off_t rollSize, int flushInterval = 3, int rollInterval = 24*60*60);
+    ~AsyncLogging();
+
+    // 线程安全
+    void append(const char *logline, size_t len);
+
+    void start();
+    // 把所有线程缓冲区中的日志写完再返回
+    void stop();
+    // 等后台线程把调用之前的日志都写到文件里再返回，不能在后台线程中调用
+    void flush();
+
+    uint64_t droppedBytes() const { return droppedBytes_; }
+    uint64_t droppedMessages() const { return droppedMessages_; }
+private:
+    using BufferPtr = std::unique_ptr<std::string>;
+    using BufferVector = std::vector<BufferPtr>;
+
+    // 一个前台线程的缓冲区，mutex只在这个线程append和后台线程换缓冲区的时候用
+    struct ThreadBuffer
+    {
+        std::mutex mutex;
+        BufferPtr current;
+        BufferVector full; // 写满了等后台线程写的
+        bool exited = false; // 线程已经退出，写完以后可以从threadBuffers_中删掉
+    };
+    using ThreadBufferPtr = std::shared_ptr<ThreadBuffer>;
+
+    ThreadBuffer& threadBuffer();
+    BufferPtr newBuffer();
+    void threadFunc();
+    // 把所有线程写满的和正在写的缓冲区换出来放到buffers中
+    void collectBuffers(BufferVector &buffers);
+
+    const std::string basename_;
+    const off_t rollSize_;
+    const int flushInterval_;
+    const int rollInterval_;
+    const uint64_t id_; // 区分不同的AsyncLogging对象，线程局部变量用它找到自己的缓冲区
+
+    std::atomic_bool running_;
+    Thread thread_;
+
+    std::atomic<size_t> pendingBuffers_; // 所有线程写满了还没写到文件里的缓冲区个数
+    std::atomic<uint64_t> droppedBytes_;
+    std::atomic<uint64_t> droppedMessages_;
+
+    std::mutex mutex_; // 保护下面的成员
+    std::condition_variable cond_;
+    std::condition_variable flushedCond_;
+    std::vector<ThreadBufferPtr> threadBuffers_;
+    BufferVector freeBuffers_; // 写完的缓冲区留着复用
+    uint64_t roundsStarted_;   // 后台线程开始的写文件的轮数，flush用来判断自己要等哪一轮
+    uint64_t roundsFinished_;
+    bool flushRequested_;
+};
@@ -0,0 +1,239 @@
+#include "BinaryLogging.h"
+#include "CurrentThread.h"
+
+#include <algorithm>
+#include <functional>
+#include <errno.h>
+#include <unistd.h>
+
+const char BinaryLogging::kMagic[8] = { 'M', 'M', 'B', 'L', 'O', 'G', '0', '1' };
+
+std::atomic_bool BinaryLogging::s_running(false);
+__thread BinaryLogging::Ring *BinaryLogging::t_ring = nullptr;
+
+namespace
+{
+struct FormatInfo
+{
+    int level;
+    std::string file;
+    int line;
+    std::string fmt;
+    std::string types;
+};
+
+void writeBytes(FILE *fp, const void *data, size_t len)
+{
+    if (len > 0 && ::fwrite_unlocked(data, 1, len, fp) != len)
+    {
+        ::fprintf(stderr, "BinaryLogging write failed %d\n", errno);
+    }
+}
+
+void writeU32(FILE *fp, uint32_t v) { writeBytes(fp, &v, sizeof v); }
+
+void writeString(FILE *fp, const std::string &s)
+{
+    writeU32(fp, static_cast<uint32_t>(s.size()));
+    writeBytes(fp, s.data(), s.size());
+}
+}
+
+struct BinaryLogging::State
+{
+    std::mutex mutex; // 保护formats和rings
+    std::vector<FormatInfo> formats;
+    std::vector<RingPtr> rings;
+    std::unique_ptr<Thread> thread;
+    FILE *fp = nullptr;
+};
+
+BinaryLogging::State& BinaryLogging::state()
+{
+    static State s;
+    return s;
+}
+
+BinaryLogging::Ring::Ring(int threadId)
+    : data(new char[kRingSize])
+    , tid(threadId)
+    , cachedReadPos(0)
+    , writePos(0)
+    , dropped(0)
+    , readPos(0)
+    , reportedDropped(0)
+    , exited(false)
+{
+}
+
+uint32_t BinaryLogging::registerFormat(int level, const char *file, int line, const char *fmt, const std::string &types)
+{
+    State &s = state();
+    std::unique_lock<std::mutex> lock(s.mutex);
+    s.formats.push_back(FormatInfo{ level, file, line, fmt, types });
+    return static_cast<uint32_t>(s.formats.size() - 1);
+}
+
+BinaryLogging::Ring* BinaryLogging::newThreadRing()
+{
+    // 线程退出的时候标记一下，后台线程写完剩下的记录以后删掉
+    struct Holder
+    {
+        RingPtr ring;
+        ~Holder()
+        {
+            if (ring)
+            {
+                ring->exited = true;
+            }
+        }
+    };
+    static thread_local Holder t_holder;
+
+    t_holder.ring = std::make_shared<Ring>(CurrentThread::tid());
+    State &s = state();
+    std::unique_lock<std::mutex> lock(s.mutex);
+    s.rings.push_back(t_holder.ring);
+    return t_holder.ring.get();
+}
+
+uint64_t BinaryLogging::droppedRecords()
+{
+    State &s = state();
+    std::unique_lock<std::mutex> lock(s.mutex);
+    uint64_t dropped = 0;
+    for (const RingPtr &ring : s.rings)
+    {
+        dropped += ring->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+void BinaryLogging::start(const std::string &filename)
+{
+    State &s = state();
+    if (s.thread)
+    {
+        LOG_ERROR("BinaryLogging::start already started \n");
+        return;
+    }
+    s.fp = ::fopen(filename.c_str(), "we");
+    if (s.fp == nullptr)
+    {
+        LOG_ERROR("BinaryLogging::start open %s failed:%d \n", filename.c_str(), errno);
+        return;
+    }
+    writeBytes(s.fp, kMagic, sizeof kMagic);
+
+    s.thread.reset(new Thread(&BinaryLogging::writerLoop, "BinaryLogging"));
+
+    s_running = true;
+    s.thread->start();
+}
+
+void BinaryLogging::stop()
+{
+    State &s = state();
+    if (!s.thread)
+    {
+        return;
+    }
+    s_running = false;
+    s.thread->join();
+    s.thread.reset();
+}
+
+void BinaryLogging::writerLoop()
+{
+    State &s = state();
+    size_t writtenFormats = 0;
+    std::vector<RingPtr> rings;
+    std::vector<uint64_t> ends;
+    while (true)
+    {
+        // 先看是否要退出，退出前最后再写一轮
+        const bool stopping = !s_running;
+
+        // 先记下各个缓冲区的写位置，再写格式串：这些记录用到的格式串一定已经登记了
+        {
+            std::unique_lock<std::mutex> lock(s.mutex);
+            rings = s.rings;
+        }
+        ends.clear();
+        for (const RingPtr &ring : rings)
+        {
+            ends.push_back(ring->writePos.load(std::memory_order_acquire));
+        }
+        {
+            std::unique_lock<std::mutex> lock(s.mutex);
+            for (; writtenFormats < s.formats.size(); ++writtenFormats)
+            {
+                const FormatInfo &info = s.formats[writtenFormats];
+                ::fputc_unlocked('F', s.fp);
+                writeU32(s.fp, static_cast<uint32_t>(writtenFormats));
+                ::fputc_unlocked(info.level, s.fp);
+                writeU32(s.fp, static_cast<uint32_t>(info.line));
+                writeString(s.fp, info.file);
+                writeString(s.fp, info.fmt);
+                writeString(s.fp, info.types);
+            }
+        }
+
+        bool wrote = false;
+        bool hasExited = false;
+        for (size_t i = 0; i < rings.size(); ++i)
+        {
+            Ring *ring = rings[i].get();
+            const uint64_t begin = ring->readPos.load(std::memory_order_relaxed);
+            const uint64_t end = ends[i];
+            if (end > begin)
+            {
+                const size_t len = end - begin;
+                const size_t index = begin & (kRingSize - 1);
+                const size_t first = std::min(len, kRingSize - index);
+                ::fputc_unlocked('C', s.fp);
+                writeU32(s.fp, static_cast<uint32_t>(ring->tid));
+                writeU32(s.fp, static_cast<uint32_t>(len));
+                writeBytes(s.fp, ring->data.get() + index, first);
+                writeBytes(s.fp, ring->data.get(), len - first);
+                ring->readPos.store(end, std::memory_order_release);
+                wrote = true;
+            }
+            const uint64_t dropped = ring->dropped.load(std::memory_order_relaxed);
+            if (dropped != ring->reportedDropped)
+            {
+                ::fputc_unlocked('D', s.fp);
+                writeU32(s.fp, static_cast<uint32_t>(ring->tid));
+                writeBytes(s.fp, &dropped, sizeof dropped);
+                ring->reportedDropped = dropped;
+            }
+            if (ring->exited && ring->writePos.load(std::memory_order_acquire) == end)
+            {
+                hasExited = true;
+            }
+        }
+        if (hasExited)
+        {
+            std::unique_lock<std::mutex> lock(s.mutex);
+            s.rings.erase(std::remove_if(s.rings.begin(), s.rings.end(),
+                [](const RingPtr &ring)
+                {
+                    return ring->exited && ring->readPos.load(std::memory_order_relaxed) == ring->writePos.load(std::memory_order_acquire);
+                }),
+                s.rings.end());
+        }
+
+        if (stopping)
+        {
+            break;
+        }
+        if (!wrote)
+        {
+            // 没有新记录，不让写日志的线程为了通知后台线程付出任何代价，这里轮询
+            ::fflush(s.fp);
+            ::usleep(1000);
+        }
+    }
+    ::fclose(s.fp);
+    s.fp = nullptr;
+}
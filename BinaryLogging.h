@@ -0,0 +1,216 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Logger.h"
+#include "Thread.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <type_traits>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// 二进制日志，用法和LOG_INFO一样：LOG_FAST(INFO, "fd=%d events=%d", fd, events)
+// 每个调用点的格式串只在第一次执行时登记一次，之后每次只把参数的原始字节拷贝到本线程的环形缓冲区，
+// 不做格式化；后台线程把二进制记录写到文件，用tools/binlog_decode还原成文本
+// 参数只能是整数、浮点数、指针和const char*（和printf一样），没有调用BinaryLogging::start时按普通日志输出
+#define LOG_FAST(level, logmsgFormat, ...) \
+    do \
+    { \
+        if ((level) >= LOG_COMPILE_LEVEL && Logger::enabled(level)) \
+        { \
+            if (BinaryLogging::running()) \
+            { \
+                static const uint32_t fmtId = BinaryLogging::registerFormat(level, __FILE__, __LINE__, logmsgFormat, \
+                    BinaryLogging::argTypes(__VA_ARGS__)); \
+                BinaryLogging::log(fmtId, ##__VA_ARGS__); \
+            } \
+            else \
+            { \
+                Logger::instance().log(level, logmsgFormat, ##__VA_ARGS__); \
+            } \
+        } \
+    } while(0)
+
+/**
+ *  文件格式（小端，也就是写文件的机器的字节序）：
+ *      文件头   kMagic
+ *      'F'     u32 id, u8 level, u32 line, u32 len + 文件名, u32 len + 格式串, u32 len + 参数类型
+ *      'C'     u32 tid, u32 len + 这个线程的一段记录
+ *      'D'     u32 tid, u64 这个线程到目前为止丢掉的记录数
+ *  一条记录：u32 格式串id, u64 纳秒时间戳, 参数（整数/浮点数/指针都是8字节，字符串是u32长度 + 内容）
+ *  参数类型：i 有符号整数  u 无符号整数  f 浮点数  p 指针  s 字符串
+ *  每一轮后台线程先记下各个环形缓冲区的写位置，再写新登记的格式串，再写记录，所以格式串总是出现在用到它的记录前面
+ */
+class BinaryLogging : noncopyable
+{
+public:
+    static const char kMagic[8];
+    static const size_t kRingSize = 1024*1024; // 每个线程的环形缓冲区，必须是2的幂
+
+    // 开始写filename，整个进程只能有一个
+    static void start(const std::string &filename);
+    // 把已经写进环形缓冲区的记录都写到文件里再返回
+    static void stop();
+    static bool running() { return s_running.load(std::memory_order_relaxed); }
+
+    // 环形缓冲区满了丢掉的记录数
+    static uint64_t droppedRecords();
+
+    static uint32_t registerFormat(int level, const char *file, int line, const char *fmt, const std::string &types);
+
+    template <typename... Args>
+    static std::string argTypes(Args... args)
+    {
+        std::string types;
+        int expand[] = { 0, (types += typeCode(args), 0)... };
+        (void)expand;
+        return types;
+    }
+
+    template <typename... Args>
+    static void log(uint32_t fmtId, Args... args)
+    {
+        Ring *ring = threadRing();
+        const size_t len = sizeof(uint32_t) + sizeof(uint64_t) + argsSize(args...);
+        uint64_t pos = 0;
+        if (!ring->reserve(len, &pos))
+        {
+            return;
+        }
+        struct timespec ts;
+        ::clock_gettime(CLOCK_REALTIME, &ts);
+        const uint64_t ns = static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+        ring->put(pos, &fmtId, sizeof fmtId);
+        ring->put(pos, &ns, sizeof ns);
+        putArgs(ring, pos, args...);
+        ring->commit(pos);
+    }
+private:
+    // 单生产者（写日志的线程）单消费者（后台线程）的无锁环形缓冲区，位置单调递增，用的时候对容量取模
+    struct Ring
+    {
+        explicit Ring(int threadId);
+
+        // 空间不够返回false，记一次丢弃
+        bool reserve(size_t len, uint64_t *pos)
+        {
+            const uint64_t write = writePos.load(std::memory_order_relaxed);
+            if (write + len - cachedReadPos > kRingSize)
+            {
+                cachedReadPos = readPos.load(std::memory_order_acquire);
+                if (write + len - cachedReadPos > kRingSize)
+                {
+                    dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    return false;
+                }
+            }
+            *pos = write;
+            return true;
+        }
+        // 写到环形缓冲区的末尾会绕回开头
+        void put(uint64_t &pos, const void *src, size_t len)
+        {
+            const size_t index = pos & (kRingSize - 1);
+            const size_t first = len < kRingSize - index ? len : kRingSize - index;
+            ::memcpy(data.get() + index, src, first);
+            if (first < len)
+            {
+                ::memcpy(data.get(), static_cast<const char*>(src) + first, len - first);
+            }
+            pos += len;
+        }
+        void commit(uint64_t pos) { writePos.store(pos, std::memory_order_release); }
+
+        std::unique_ptr<char[]> data;
+        const int tid;
+        // 生产者修改的
+        uint64_t cachedReadPos; // 生产者看到的readPos，不够用的时候才重新读
+        std::atomic<uint64_t> writePos;
+        std::atomic<uint64_t> dropped;
+        char pad[64]; // writePos和readPos分别被两个线程修改，放在不同的cache line上
+        // 后台线程修改的
+        std::atomic<uint64_t> readPos;
+        uint64_t reportedDropped;
+        std::atomic_bool exited; // 线程已经退出，写完剩下的记录以后删掉
+    };
+    using RingPtr = std::shared_ptr<Ring>;
+
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, char>::type
+    typeCode(T) { return std::is_signed<T>::value || std::is_enum<T>::value ? 'i' : 'u'; }
+    template <typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value, char>::type
+    typeCode(T) { return 'f'; }
+    static char typeCode(const char*) { return 's'; }
+    template <typename T>
+    static char typeCode(const T*) { return 'p'; }
+
+    static size_t argsSize() { return 0; }
+    template <typename T, typename... Rest>
+    static size_t argsSize(T arg, Rest... rest) { return argSize(arg) + argsSize(rest...); }
+    template <typename T>
+    static typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value, size_t>::type
+    argSize(T) { return sizeof(uint64_t); }
+    static size_t argSize(const char *s) { return sizeof(uint32_t) + (s ? ::strlen(s) : 0); }
+    template <typename T>
+    static size_t argSize(const T*) { return sizeof(uint64_t); }
+
+    static void putArgs(Ring*, uint64_t&) {}
+    template <typename T, typename... Rest>
+    static void putArgs(Ring *ring, uint64_t &pos, T arg, Rest... rest)
+    {
+        putArg(ring, pos, arg);
+        putArgs(ring, pos, rest...);
+    }
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+    putArg(Ring *ring, uint64_t &pos, T arg)
+    {
+        // 有符号数符号扩展，无符号数零扩展，解码的时候按类型码解释
+        typename std::conditional<std::is_signed<T>::value || std::is_enum<T>::value, int64_t, uint64_t>::type v = arg;
+        ring->put(pos, &v, sizeof v);
+    }
+    template <typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type
+    putArg(Ring *ring, uint64_t &pos, T arg)
+    {
+        double v = arg;
+        ring->put(pos, &v, sizeof v);
+    }
+    static void putArg(Ring *ring, uint64_t &pos, const char *s)
+    {
+        uint32_t len = s ? static_cast<uint32_t>(::strlen(s)) : 0;
+        ring->put(pos, &len, sizeof len);
+        ring->put(pos, s, len);
+    }
+    template <typename T>
+    static void putArg(Ring *ring, uint64_t &pos, const T *p)
+    {
+        uint64_t v = reinterpret_cast<uintptr_t>(p);
+        ring->put(pos, &v, sizeof v);
+    }
+
+    static Ring* threadRing()
+    {
+        if (__builtin_expect(t_ring == nullptr, 0))
+        {
+            t_ring = newThreadRing();
+        }
+        return t_ring;
+    }
+    static Ring* newThreadRing();
+
+    // 登记的格式串、所有线程的环形缓冲区、后台线程，定义在BinaryLogging.cc中
+    struct State;
+    static State& state();
+    static void writerLoop();
+
+    static std::atomic_bool s_running;
+    static __thread Ring *t_ring;
+};
@@ -2,7 +2,226 @@
 
 #include <errno.h>
 #include <sys/uio.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
 #include <unistd.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MYMUDUO_X86_SIMD 1
+#endif
+
+namespace
+{
+// findAnyOf 超过这么多个字节就不走SIMD了，每多一个字节就要多一次比较，不如查表
+const size_t kMaxSimdAnyOf = 16;
+
+// ---------------- 普通的逐字节查找 ----------------
+const char* findByteScalar(const char *p, const char *end, char c)
+{
+    return static_cast<const char*>(::memchr(p, c, end - p));
+}
+
+const char* findCRLFScalar(const char *p, const char *end)
+{
+    for (; p + 1 < end; ++p)
+    {
+        if (p[0] == '\r' && p[1] == '\n')
+        {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+const char* findAnyOfScalar(const char *p, const char *end, const char *chars, size_t n)
+{
+    bool table[256] = {false};
+    for (size_t i = 0; i < n; ++i)
+    {
+        table[static_cast<unsigned char>(chars[i])] = true;
+    }
+    for (; p < end; ++p)
+    {
+        if (table[static_cast<unsigned char>(*p)])
+        {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+#ifdef MYMUDUO_X86_SIMD
+// ---------------- SSE2 x86_64上一定有 ----------------
+// 每次比较16个字节，movemask把比较结果压成一个16位的掩码，最低位的1就是第一个匹配的位置
+__attribute__((target("sse2")))
+const char* findByteSSE2(const char *p, const char *end, char c)
+{
+    const __m128i needle = _mm_set1_epi8(c);
+    for (; p + 16 <= end; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+        if (mask)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findByteScalar(p, end, c);
+}
+
+// 一次加载p和p+1两个位置，'\r'的掩码和'\n'的掩码相与，就是"\r\n"的起始位置
+__attribute__((target("sse2")))
+const char* findCRLFSSE2(const char *p, const char *end)
+{
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    for (; p + 17 <= end; p += 16)
+    {
+        __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v0, cr))
+                 & _mm_movemask_epi8(_mm_cmpeq_epi8(v1, lf));
+        if (mask)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findCRLFScalar(p, end);
+}
+
+__attribute__((target("sse2")))
+const char* findAnyOfSSE2(const char *p, const char *end, const char *chars, size_t n)
+{
+    __m128i needles[kMaxSimdAnyOf];
+    for (size_t i = 0; i < n; ++i)
+    {
+        needles[i] = _mm_set1_epi8(chars[i]);
+    }
+    for (; p + 16 <= end; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i eq = _mm_setzero_si128();
+        for (size_t i = 0; i < n; ++i)
+        {
+            eq = _mm_or_si128(eq, _mm_cmpeq_epi8(v, needles[i]));
+        }
+        int mask = _mm_movemask_epi8(eq);
+        if (mask)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findAnyOfScalar(p, end, chars, n);
+}
+
+// ---------------- AVX2 运行时检测CPU支持才用 ----------------
+__attribute__((target("avx2")))
+const char* findByteAVX2(const char *p, const char *end, char c)
+{
+    const __m256i needle = _mm256_set1_epi8(c);
+    for (; p + 32 <= end; p += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle)));
+        if (mask)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findByteSSE2(p, end, c);
+}
+
+__attribute__((target("avx2")))
+const char* findCRLFAVX2(const char *p, const char *end)
+{
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    for (; p + 33 <= end; p += 32)
+    {
+        __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v0, cr)))
+                      & static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v1, lf)));
+        if (mask)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findCRLFSSE2(p, end);
+}
+
+__attribute__((target("avx2")))
+const char* findAnyOfAVX2(const char *p, const char *end, const char *chars, size_t n)
+{
+    __m256i needles[kMaxSimdAnyOf];
+    for (size_t i = 0; i < n; ++i)
+    {
+        needles[i] = _mm256_set1_epi8(chars[i]);
+    }
+    for (; p + 32 <= end; p += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i eq = _mm256_setzero_si256();
+        for (size_t i = 0; i < n; ++i)
+        {
+            eq = _mm256_or_si256(eq, _mm256_cmpeq_epi8(v, needles[i]));
+        }
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(eq));
+        if (mask)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findAnyOfSSE2(p, end, chars, n);
+}
+
+bool cpuHasAvx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+// 程序启动的时候检测一次
+const bool kHasAvx2 = cpuHasAvx2();
+#endif // MYMUDUO_X86_SIMD
+} // namespace
+
+const char* Buffer::findCRLF(const char *start) const
+{
+#ifdef MYMUDUO_X86_SIMD
+    return kHasAvx2 ? findCRLFAVX2(start, beginWrite()) : findCRLFSSE2(start, beginWrite());
+#else
+    return findCRLFScalar(start, beginWrite());
+#endif
+}
+
+const char* Buffer::findByte(char c, const char *start) const
+{
+#ifdef MYMUDUO_X86_SIMD
+    return kHasAvx2 ? findByteAVX2(start, beginWrite(), c) : findByteSSE2(start, beginWrite(), c);
+#else
+    return findByteScalar(start, beginWrite(), c);
+#endif
+}
+
+const char* Buffer::findEOL(const char *start) const
+{
+    return findByte('\n', start);
+}
+
+const char* Buffer::findAnyOf(const char *chars, size_t n, const char *start) const
+{
+#ifdef MYMUDUO_X86_SIMD
+    if (n > 0 && n <= kMaxSimdAnyOf)
+    {
+        return kHasAvx2 ? findAnyOfAVX2(start, beginWrite(), chars, n)
+                        : findAnyOfSSE2(start, beginWrite(), chars, n);
+    }
+#endif
+    return findAnyOfScalar(start, beginWrite(), chars, n);
+}
 
 /**
  *  从fd上读取数据,buffer缓冲区是有大小的，但是从fd上读数据的时候，却不知道要读多少数据 就相当于是若读到的数据为a，若现在可写的数据大小b小于65536，则把a的大小分为b+另外一部分
@@ -10,41 +229,82 @@
  *  若可写的数据大于65536，则直接写入可写部分
  *  
  */
-ssize_t Buffer::readFd(int fd, int* saveErrno)
+ssize_t Buffer::readFd(int fd, int* saveErrno, size_t maxBytes, Timestamp *receiveTime)
 {
     char extrabuf[65536] = {0}; // 栈上的内存空间  64K
     
     struct iovec vec[2];
     
 	// 这是buffer可写的数据
-    const size_t writable = writableBytes(); 
+    const size_t writable = std::min(writableBytes(), maxBytes); 
     vec[0].iov_base = begin() + writerIndex_;
     vec[0].iov_len = writable;
 
     vec[1].iov_base = extrabuf;
-    vec[1].iov_len = sizeof extrabuf;
+    vec[1].iov_len = std::min(sizeof extrabuf, maxBytes - writable);
     
-    const int iovcnt = (writable < sizeof extrabuf) ? 2 : 1;
+    const int iovcnt = (writable < sizeof extrabuf && vec[1].iov_len > 0) ? 2 : 1;
 	// 去百度下readv
-    const ssize_t n = ::readv(fd, vec, iovcnt);
+    ssize_t n = 0;
+    if (receiveTime == nullptr)
+    {
+        n = ::readv(fd, vec, iovcnt);
+    }
+    else
+    {
+        n = readWithTimestamp(fd, vec, iovcnt, receiveTime);
+    }
     if (n < 0)
     {
         *saveErrno = errno;
     }
-    else if (n <= writable) // Buffer的可写缓冲区已经够存储读出来的数据了
+    else if (static_cast<size_t>(n) <= writable) // Buffer的可写缓冲区已经够存储读出来的数据了
     {
         writerIndex_ += n;
     }
 	// extrabuf 也写了数据
     else 
     {
-        writerIndex_ = buffer_.size();
+        writerIndex_ += writable;
         append(extrabuf, n - writable);  // writerIndex_开始写 n - writable大小的数据
     }
 
     return n;
 }
 
+// 和readv一样读数据，再从控制消息中取出SO_TIMESTAMPING的软件接收时间戳
+ssize_t Buffer::readWithTimestamp(int fd, struct iovec *vec, int iovcnt, Timestamp *receiveTime)
+{
+    char control[CMSG_SPACE(sizeof(struct scm_timestamping))];
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof msg);
+    msg.msg_iov = vec;
+    msg.msg_iovlen = iovcnt;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+
+    *receiveTime = Timestamp::invalid();
+    const ssize_t n = ::recvmsg(fd, &msg, 0);
+    if (n <= 0)
+    {
+        return n;
+    }
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING)
+        {
+            struct scm_timestamping ts;
+            ::memcpy(&ts, CMSG_DATA(cmsg), sizeof ts);
+            // ts[0]是软件时间戳，TCP的话是这次读到的最后一个包的时间
+            if (ts.ts[0].tv_sec != 0 || ts.ts[0].tv_nsec != 0)
+            {
+                *receiveTime = Timestamp::fromUnixTime(ts.ts[0].tv_sec, static_cast<int>(ts.ts[0].tv_nsec / 1000));
+            }
+        }
+    }
+    return n;
+}
+
 // 通过fd发送数据
 ssize_t Buffer::writeFd(int fd, int* saveErrno)
 {
@@ -3,6 +3,13 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <endian.h>
+#include <sys/uio.h>
+
+#include "StringPiece.h"
+#include "Timestamp.h"
 /**
  *  
  * 
@@ -22,10 +29,12 @@ public:
     static const size_t kCheapPrepend = 8;
     static const size_t kInitialSize = 1024;
 
+    // initialSize为0的时候先不分配内存（连kCheapPrepend也不分配），第一次写入的时候再分配，
+    // take的结果、OutputQueue中不放数据的块都是这样，不用为一个空的Buffer分配一次内存
     explicit Buffer(size_t initialSize = kInitialSize)
-        : buffer_(kCheapPrepend + initialSize)
-        , readerIndex_(kCheapPrepend)
-        , writerIndex_(kCheapPrepend)
+        : buffer_(initialSize == 0 ? 0 : kCheapPrepend + initialSize)
+        , readerIndex_(initialSize == 0 ? 0 : kCheapPrepend)
+        , writerIndex_(readerIndex_)
     {}
 	
     // 可读的数据 就是存放的是即发送的数据
@@ -66,9 +75,72 @@ public:
         }
     }
 
+    // 复位到end为止，end一般是findCRLF之类返回的地址
+    void retrieveUntil(const char *end)
+    {
+        retrieve(end - peek());
+    }
+
     void retrieveAll()
     {
-        readerIndex_ = writerIndex_ = kCheapPrepend;
+        // 还没有分配内存的话，前面也没有kCheapPrepend
+        readerIndex_ = writerIndex_ = buffer_.empty() ? 0 : kCheapPrepend;
+    }
+
+    // 不拷贝，直接把可读数据当作一个StringPiece给用户在原地解析
+    // 返回的StringPiece在下一次retrieve/append之前有效
+    StringPiece toStringPiece() const
+    {
+        return StringPiece(peek(), readableBytes());
+    }
+
+    // 先解析后复位：func(StringPiece)返回它用掉了多少个字节（0表示数据还不够一条消息），
+    // func返回之后才复位，所以func里面拿到的StringPiece一直有效
+    // 用法：buf->consume([](StringPiece data) -> size_t { ...; return used; });
+    template <typename Func>
+    size_t consume(Func func)
+    {
+        size_t used = func(toStringPiece());
+        if (used > 0)
+        {
+            retrieve(used);
+        }
+        return used;
+    }
+
+    // 把前len个可读字节作为一个新的Buffer拿走
+    // 直接把底层的vector交换出去，再把剩下的少的那部分拷回来，所以只会拷贝 min(len, 剩余字节) 个字节，
+    // len == readableBytes() 的时候一个字节都不拷贝
+    Buffer take(size_t len)
+    {
+        if (len > readableBytes())
+        {
+            len = readableBytes();
+        }
+        const size_t rest = readableBytes() - len;
+        Buffer result(0);
+        if (rest <= len)
+        {
+            // 整块拿走，剩下的rest个字节拷回自己
+            swap(result);
+            result.writerIndex_ -= rest;
+            append(result.beginWrite(), rest);
+        }
+        else
+        {
+            result.append(peek(), len);
+            retrieve(len);
+        }
+        return result;
+    }
+
+    Buffer takeAll() { return take(readableBytes()); }
+
+    void swap(Buffer &rhs)
+    {
+        buffer_.swap(rhs.buffer_);
+        std::swap(readerIndex_, rhs.readerIndex_);
+        std::swap(writerIndex_, rhs.writerIndex_);
     }
 
     // 把onMessage函数上报的buffer内容转为string
@@ -85,6 +157,68 @@ public:
         return result;
     }
 
+    // 下面的整数读写都按网络字节序（大端），方便做二进制协议
+    void retrieveInt64() { retrieve(sizeof(int64_t)); }
+    void retrieveInt32() { retrieve(sizeof(int32_t)); }
+    void retrieveInt16() { retrieve(sizeof(int16_t)); }
+    void retrieveInt8() { retrieve(sizeof(int8_t)); }
+
+    // 从可读数据的开头取出一个整数，调用前要保证 readableBytes() >= sizeof 对应类型
+    int64_t peekInt64() const
+    {
+        int64_t be64 = 0;
+        ::memcpy(&be64, peek(), sizeof be64);
+        return static_cast<int64_t>(be64toh(be64));
+    }
+
+    int32_t peekInt32() const
+    {
+        int32_t be32 = 0;
+        ::memcpy(&be32, peek(), sizeof be32);
+        return static_cast<int32_t>(be32toh(be32));
+    }
+
+    int16_t peekInt16() const
+    {
+        int16_t be16 = 0;
+        ::memcpy(&be16, peek(), sizeof be16);
+        return static_cast<int16_t>(be16toh(be16));
+    }
+
+    int8_t peekInt8() const
+    {
+        return *peek();
+    }
+
+    // 读出一个整数，并且把对应的字节从缓冲区中复位
+    int64_t readInt64()
+    {
+        int64_t result = peekInt64();
+        retrieveInt64();
+        return result;
+    }
+
+    int32_t readInt32()
+    {
+        int32_t result = peekInt32();
+        retrieveInt32();
+        return result;
+    }
+
+    int16_t readInt16()
+    {
+        int16_t result = peekInt16();
+        retrieveInt16();
+        return result;
+    }
+
+    int8_t readInt8()
+    {
+        int8_t result = peekInt8();
+        retrieveInt8();
+        return result;
+    }
+
     // 要写len长度的数据
     void ensureWriteableBytes(size_t len)
     {
@@ -102,6 +236,72 @@ public:
         writerIndex_ += len;
     }
 
+    void append(const void *data, size_t len)
+    {
+        append(static_cast<const char*>(data), len);
+    }
+
+    void appendInt64(int64_t x)
+    {
+        int64_t be64 = static_cast<int64_t>(htobe64(x));
+        append(&be64, sizeof be64);
+    }
+
+    void appendInt32(int32_t x)
+    {
+        int32_t be32 = static_cast<int32_t>(htobe32(x));
+        append(&be32, sizeof be32);
+    }
+
+    void appendInt16(int16_t x)
+    {
+        int16_t be16 = static_cast<int16_t>(htobe16(x));
+        append(&be16, sizeof be16);
+    }
+
+    void appendInt8(int8_t x)
+    {
+        append(&x, sizeof x);
+    }
+
+    // 在可读数据的前面插入数据，就是利用前面的kCheapPrepend，比如消息体写好之后，再在前面填上包的长度
+    // 调用前要保证 prependableBytes() >= len
+    void prepend(const void *data, size_t len)
+    {
+        readerIndex_ -= len;
+        const char *d = static_cast<const char*>(data);
+        std::copy(d, d+len, begin() + readerIndex_);
+    }
+
+    void prependInt64(int64_t x)
+    {
+        int64_t be64 = static_cast<int64_t>(htobe64(x));
+        prepend(&be64, sizeof be64);
+    }
+
+    void prependInt32(int32_t x)
+    {
+        int32_t be32 = static_cast<int32_t>(htobe32(x));
+        prepend(&be32, sizeof be32);
+    }
+
+    void prependInt16(int16_t x)
+    {
+        int16_t be16 = static_cast<int16_t>(htobe16(x));
+        prepend(&be16, sizeof be16);
+    }
+
+    void prependInt8(int8_t x)
+    {
+        prepend(&x, sizeof x);
+    }
+
+    // 可读数据的可修改地址，给需要原地改写数据的协议用（比如WebSocket原地去掉掩码）
+    char* mutablePeek()
+    {
+        return begin() + readerIndex_;
+    }
+
     char* beginWrite()
     {
         return begin() + writerIndex_;
@@ -112,25 +312,46 @@ public:
         return begin() + writerIndex_;
     }
 
-    // 从fd上读取数据
-    ssize_t readFd(int fd, int* saveErrno);
+    // 在可读数据中查找分隔符，找到返回其地址，找不到返回nullptr
+    // 带start参数的版本从start开始找，start要在 [peek(), beginWrite()] 之间
+    // 实现在Buffer.cc中，x86上用SSE2/AVX2一次比较16/32个字节，其他平台用普通的逐字节查找
+    const char* findCRLF() const { return findCRLF(peek()); }
+    const char* findCRLF(const char *start) const;
+    const char* findEOL() const { return findEOL(peek()); }
+    const char* findEOL(const char *start) const;
+    const char* findByte(char c) const { return findByte(c, peek()); }
+    const char* findByte(char c, const char *start) const;
+    // 找chars中任意一个字节第一次出现的位置
+    const char* findAnyOf(const char *chars, size_t n) const { return findAnyOf(chars, n, peek()); }
+    const char* findAnyOf(const char *chars, size_t n, const char *start) const;
+
+    // 从fd上读取数据，一次最多读maxBytes个字节
+    // receiveTime不为空时用recvmsg读，取出内核给这次读到的数据打的接收时间戳（需要socket开启SO_TIMESTAMPING），
+    // 没有时间戳的时候*receiveTime是无效的Timestamp
+    ssize_t readFd(int fd, int* saveErrno, size_t maxBytes = SIZE_MAX, Timestamp *receiveTime = nullptr);
     // 通过fd发送数据
     ssize_t writeFd(int fd, int* saveErrno);
 private:
+    static ssize_t readWithTimestamp(int fd, struct iovec *vec, int iovcnt, Timestamp *receiveTime);
 
     // vector数组首元素的地址
     char* begin()
     {
-        // it.operator*()
-        return &*buffer_.begin();  // vector底层数组首元素的地址，也就是数组的起始地址
+        return buffer_.data();  // vector底层数组首元素的地址，也就是数组的起始地址，还没有分配内存的时候是nullptr
     }
     const char* begin() const
     {
-        return &*buffer_.begin();
+        return buffer_.data();
     }
     void makeSpace(size_t len)
     {
-        if (writableBytes() + prependableBytes() < len + kCheapPrepend)
+        if (buffer_.empty())
+        {
+            // 第一次写入，连同kCheapPrepend一起分配
+            buffer_.resize(kCheapPrepend + len);
+            readerIndex_ = writerIndex_ = kCheapPrepend;
+        }
+        else if (writableBytes() + prependableBytes() < len + kCheapPrepend)
         {
             buffer_.resize(writerIndex_ + len);
         }
@@ -2,16 +2,25 @@
 
 #include <memory>
 #include <functional>
+#include <string>
 
 class Buffer;
 class TcpConnection;
 class Timestamp;
 
 using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
+// 不可修改的引用计数消息，广播的时候所有连接共享同一份数据，只增加引用计数不拷贝
+using PayloadPtr = std::shared_ptr<const std::string>;
 using ConnectionCallback = std::function<void (const TcpConnectionPtr&)>;
 using CloseCallback = std::function<void (const TcpConnectionPtr&)>;
 using WriteCompleteCallback = std::function<void (const TcpConnectionPtr&)>;
 using MessageCallback = std::function<void (const TcpConnectionPtr&,
                                         Buffer*,
                                         Timestamp)>;
-using HighWaterMarkCallback = std::function<void (const TcpConnectionPtr&, size_t)>;
\ No newline at end of file
+using HighWaterMarkCallback = std::function<void (const TcpConnectionPtr&, size_t)>;
+using MemoryOverBudgetCallback = std::function<void (const TcpConnectionPtr&)>;
+
+inline PayloadPtr makePayload(std::string &&data)
+{
+    return std::make_shared<const std::string>(std::move(data));
+}
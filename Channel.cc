@@ -1,6 +1,7 @@
 #include "Channel.h"
 #include "EventLoop.h"
 #include "Logger.h"
+#include "BinaryLogging.h"
 
 #include <sys/epoll.h>
 
@@ -65,7 +66,7 @@ void Channel::handleEvent(Timestamp receiveTime)
 // 根据poller通知的channel发生的具体事件，由channel调用具体的回调操作
 void Channel::handleEventWithGuard(Timestamp receiveTime)
 {
-    LOG_INFO("channel handleEvent revents:%d\n", revents_);
+    LOG_FAST(INFO, "channel handleEvent revents:%d\n", revents_);
 
     if ((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN))
     {
@@ -0,0 +1,431 @@
+#include "ConnectionPool.h"
+#include "Connector.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "Logger.h"
+
+#include <sys/socket.h>
+#include <strings.h>
+#include <stdio.h>
+#include <errno.h>
+#include <deque>
+#include <algorithm>
+
+// 一个loop上的连接池，所有成员函数都只在这个loop线程中调用
+struct ConnectionPool::LoopPool : noncopyable
+{
+    struct IdleConnection
+    {
+        TcpConnectionPtr conn;
+        Timestamp since; // 什么时候开始空闲的
+    };
+    // 排队等连接的acquire
+    struct Waiter
+    {
+        uint64_t id;
+        AcquireCallback cb;
+        TimerId deadline;
+    };
+    struct PendingConnect
+    {
+        ConnectorPtr connector;
+        TimerId timeout;
+    };
+    // 到一个后端的连接
+    struct Host
+    {
+        explicit Host(const InetAddress &a) : addr(a), total(0) {}
+
+        InetAddress addr;
+        std::vector<IdleConnection> idle; // 后面的是最近归还的，优先借出去
+        std::deque<Waiter> waiters;
+        std::unordered_map<Connector*, PendingConnect> connecting;
+        int total; // 空闲+借出+正在连接
+    };
+
+    LoopPool(ConnectionPool *ownerArg, EventLoop *loopArg)
+        : owner(ownerArg)
+        , loop(loopArg)
+        , nextConnId(1)
+        , nextWaiterId(1)
+    {
+    }
+
+    Host& host(const InetAddress &addr);
+    void acquire(const InetAddress &addr, const AcquireCallback &cb);
+    void release(const TcpConnectionPtr &conn, bool reusable);
+    void warmUp(const InetAddress &addr, int n);
+    void connect(Host &h);
+    void newConnection(Host *h, Connector *connector, int sockfd);
+    void connectTimeout(Host *h, Connector *connector);
+    void acquireTimeout(Host *h, uint64_t waiterId);
+    // 取出排在最前面的acquire，取消它的超时定时器
+    AcquireCallback takeWaiter(Host &h);
+    // 连接空闲了，或者正在等的acquire直接拿走
+    void putBack(Host &h, const TcpConnectionPtr &conn);
+    void removeConnection(const TcpConnectionPtr &conn);
+    void checkHealth();
+
+    static void idleConnectionCallback(const TcpConnectionPtr&) {}
+    static void idleMessageCallback(const TcpConnectionPtr &conn, Buffer *buf, Timestamp);
+
+    ConnectionPool *owner;
+    EventLoop *loop;
+    // key是ip:port，unordered_map中元素的地址不会变，可以保存Host*
+    std::unordered_map<std::string, Host> hosts;
+    // 池子持有所有的连接（包括借出去的），和TcpServer的connections_一样，value是连接属于哪个后端
+    std::unordered_map<TcpConnectionPtr, Host*> connections;
+    int nextConnId;
+    uint64_t nextWaiterId;
+    TimerId healthTimer;
+};
+
+ConnectionPool::LoopPool::Host& ConnectionPool::LoopPool::host(const InetAddress &addr)
+{
+    std::string key = addr.toIpPort();
+    auto it = hosts.find(key);
+    if (it == hosts.end())
+    {
+        it = hosts.emplace(key, Host(addr)).first;
+    }
+    return it->second;
+}
+
+void ConnectionPool::LoopPool::acquire(const InetAddress &addr, const AcquireCallback &cb)
+{
+    Host &h = host(addr);
+    while (!h.idle.empty())
+    {
+        TcpConnectionPtr conn = std::move(h.idle.back().conn);
+        h.idle.pop_back();
+        // 已经断开的还没来得及执行关闭回调，跳过就行，removeConnection会把它从统计中去掉
+        if (conn->connected())
+        {
+            cb(conn);
+            return;
+        }
+    }
+
+    Waiter waiter{nextWaiterId++, cb, TimerId()};
+    if (owner->acquireTimeout_ > 0)
+    {
+        waiter.deadline = loop->runAfter(owner->acquireTimeout_,
+            std::bind(&LoopPool::acquireTimeout, this, &h, waiter.id));
+    }
+    h.waiters.push_back(std::move(waiter));
+    if (h.total < owner->maxPerHost_)
+    {
+        connect(h);
+    }
+}
+
+void ConnectionPool::LoopPool::release(const TcpConnectionPtr &conn, bool reusable)
+{
+    auto it = connections.find(conn);
+    if (it == connections.end())
+    {
+        LOG_ERROR("ConnectionPool::release [%s] - %s is not from this pool \n",
+            owner->name_.c_str(), conn->name().c_str());
+        return;
+    }
+
+    // 借用的人设置的回调去掉，否则空闲时的事件还会调到它那里
+    conn->setConnectionCallback(idleConnectionCallback);
+    conn->setMessageCallback(idleMessageCallback);
+    conn->setWriteCompleteCallback(WriteCompleteCallback());
+    if (!reusable || !conn->connected())
+    {
+        conn->forceClose();
+        return;
+    }
+    conn->startRead();
+    putBack(*it->second, conn);
+}
+
+void ConnectionPool::LoopPool::putBack(Host &h, const TcpConnectionPtr &conn)
+{
+    if (!h.waiters.empty())
+    {
+        AcquireCallback cb = takeWaiter(h);
+        cb(conn);
+    }
+    else if (static_cast<int>(h.idle.size()) < owner->maxIdle_)
+    {
+        h.idle.push_back(IdleConnection{conn, Timestamp::now()});
+    }
+    else
+    {
+        conn->forceClose();
+    }
+}
+
+void ConnectionPool::LoopPool::warmUp(const InetAddress &addr, int n)
+{
+    Host &h = host(addr);
+    int target = std::min(std::min(n, owner->maxIdle_), owner->maxPerHost_);
+    while (h.total < target)
+    {
+        connect(h);
+    }
+}
+
+void ConnectionPool::LoopPool::connect(Host &h)
+{
+    ++h.total;
+    ConnectorPtr connector(new Connector(loop, h.addr));
+    connector->setNewConnectionCallback(
+        std::bind(&LoopPool::newConnection, this, &h, connector.get(), std::placeholders::_1));
+    PendingConnect &pending = h.connecting[connector.get()];
+    pending.connector = connector;
+    pending.timeout = loop->runAfter(owner->connectTimeout_,
+        std::bind(&LoopPool::connectTimeout, this, &h, connector.get()));
+    connector->start();
+}
+
+void ConnectionPool::LoopPool::newConnection(Host *h, Connector *connector, int sockfd)
+{
+    // 现在还在Connector::handleWrite中，channel的tie保证Connector在回调期间不会析构
+    auto it = h->connecting.find(connector);
+    loop->cancel(it->second.timeout);
+    h->connecting.erase(it);
+
+    sockaddr_in peer, local;
+    ::bzero(&peer, sizeof peer);
+    ::bzero(&local, sizeof local);
+    socklen_t addrlen = sizeof peer;
+    if (::getpeername(sockfd, (sockaddr*)&peer, &addrlen) < 0)
+    {
+        LOG_ERROR("ConnectionPool::newConnection getpeername error:%d \n", errno);
+    }
+    addrlen = sizeof local;
+    if (::getsockname(sockfd, (sockaddr*)&local, &addrlen) < 0)
+    {
+        LOG_ERROR("ConnectionPool::newConnection getsockname error:%d \n", errno);
+    }
+
+    char buf[64] = {0};
+    snprintf(buf, sizeof buf, ":%s#%d", h->addr.toIpPort().c_str(), nextConnId);
+    ++nextConnId;
+    TcpConnectionPtr conn(new TcpConnection(loop, owner->name_ + buf, sockfd,
+                                InetAddress(local), InetAddress(peer)));
+    conn->setConnectionCallback(idleConnectionCallback);
+    conn->setMessageCallback(idleMessageCallback);
+    conn->setCloseCallback(std::bind(&LoopPool::removeConnection, this, std::placeholders::_1));
+    connections[conn] = h;
+    conn->connectEstablished();
+    putBack(*h, conn);
+}
+
+void ConnectionPool::LoopPool::connectTimeout(Host *h, Connector *connector)
+{
+    auto it = h->connecting.find(connector);
+    if (it == h->connecting.end())
+    {
+        return;
+    }
+    LOG_ERROR("ConnectionPool::connectTimeout [%s] - connect to %s timed out \n",
+        owner->name_.c_str(), h->addr.toIpPort().c_str());
+    // stop在loop中排队执行，期间Connector自己持有自己的shared_ptr
+    it->second.connector->stop();
+    h->connecting.erase(it);
+    --h->total;
+
+    // 后端连不上，等着的不要一直等下去
+    if (!h->waiters.empty())
+    {
+        AcquireCallback cb = takeWaiter(*h);
+        cb(TcpConnectionPtr());
+    }
+    // 还有人在等的话这个名额要重新连，否则没有正在连接的Connector，剩下的acquire永远等不到
+    // cb里面可能又acquire了，所以重新检查
+    if (!h->waiters.empty() && h->total < owner->maxPerHost_)
+    {
+        connect(*h);
+    }
+}
+
+void ConnectionPool::LoopPool::acquireTimeout(Host *h, uint64_t waiterId)
+{
+    auto it = std::find_if(h->waiters.begin(), h->waiters.end(),
+        [waiterId](const Waiter &waiter) { return waiter.id == waiterId; });
+    if (it == h->waiters.end())
+    {
+        return;
+    }
+    LOG_ERROR("ConnectionPool::acquireTimeout [%s] - no connection to %s available \n",
+        owner->name_.c_str(), h->addr.toIpPort().c_str());
+    AcquireCallback cb = std::move(it->cb);
+    h->waiters.erase(it);
+    cb(TcpConnectionPtr());
+}
+
+ConnectionPool::AcquireCallback ConnectionPool::LoopPool::takeWaiter(Host &h)
+{
+    Waiter &waiter = h.waiters.front();
+    loop->cancel(waiter.deadline);
+    AcquireCallback cb = std::move(waiter.cb);
+    h.waiters.pop_front();
+    return cb;
+}
+
+void ConnectionPool::LoopPool::removeConnection(const TcpConnectionPtr &conn)
+{
+    auto it = connections.find(conn);
+    if (it != connections.end())
+    {
+        Host &h = *it->second;
+        connections.erase(it);
+        --h.total;
+        auto idleIt = std::find_if(h.idle.begin(), h.idle.end(),
+            [&conn](const IdleConnection &item) { return item.conn == conn; });
+        if (idleIt != h.idle.end())
+        {
+            h.idle.erase(idleIt);
+        }
+        // 有人在等连接数的名额
+        if (!h.waiters.empty() && h.total < owner->maxPerHost_)
+        {
+            connect(h);
+        }
+    }
+    // 现在还在TcpConnection::handleClose里面，connectDestroyed放到后面执行
+    loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+void ConnectionPool::LoopPool::checkHealth()
+{
+    const Timestamp now = Timestamp::now();
+    const int64_t idleTimeout = static_cast<int64_t>(owner->idleTimeout_ * Timestamp::kMicroSecondsPerSecond);
+    for (auto &item : hosts)
+    {
+        Host &h = item.second;
+        // 先取出来，HealthCheck里面即使借还连接也不会影响这里的遍历
+        std::vector<IdleConnection> idle;
+        idle.swap(h.idle);
+        std::vector<IdleConnection> kept;
+        std::vector<TcpConnectionPtr> closing;
+        for (auto &entry : idle)
+        {
+            if ((idleTimeout > 0 && now - entry.since >= idleTimeout)
+                || (owner->healthCheck_ && !owner->healthCheck_(entry.conn)))
+            {
+                closing.push_back(std::move(entry.conn));
+            }
+            else
+            {
+                kept.push_back(std::move(entry));
+            }
+        }
+        // 检查期间归还的放在后面
+        h.idle.insert(h.idle.begin(), kept.begin(), kept.end());
+        for (auto &conn : closing)
+        {
+            conn->forceClose();
+        }
+    }
+}
+
+void ConnectionPool::LoopPool::idleMessageCallback(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    // 没有请求的时候后端发来数据，说明协议状态已经不对了，这个连接不能再用
+    LOG_ERROR("ConnectionPool - unexpected %lu bytes on idle connection %s \n",
+        buf->readableBytes(), conn->name().c_str());
+    buf->retrieveAll();
+    conn->forceClose();
+}
+
+ConnectionPool::ConnectionPool(EventLoopThreadPool *threadPool, const std::string &nameArg)
+    : threadPool_(threadPool)
+    , name_(nameArg)
+    , maxIdle_(8)
+    , maxPerHost_(64)
+    , idleTimeout_(60.0)
+    , connectTimeout_(3.0)
+    , acquireTimeout_(5.0)
+    , healthCheckInterval_(1.0)
+{
+}
+
+ConnectionPool::~ConnectionPool()
+{
+}
+
+void ConnectionPool::start()
+{
+    for (EventLoop *loop : threadPool_->getAllLoops())
+    {
+        LoopPool *pool = new LoopPool(this, loop);
+        pools_[loop].reset(pool);
+        if (healthCheckInterval_ > 0)
+        {
+            double interval = healthCheckInterval_;
+            loop->runInLoop([pool, loop, interval]()
+            {
+                pool->healthTimer = loop->runEvery(interval, std::bind(&LoopPool::checkHealth, pool));
+            });
+        }
+    }
+}
+
+void ConnectionPool::warmUp(const InetAddress &addr, int n)
+{
+    for (auto &item : pools_)
+    {
+        LoopPool *pool = item.second.get();
+        item.first->runInLoop(std::bind(&LoopPool::warmUp, pool, addr, n));
+    }
+}
+
+ConnectionPool::LoopPool* ConnectionPool::poolOf(EventLoop *loop) const
+{
+    auto it = pools_.find(loop);
+    if (it == pools_.end())
+    {
+        LOG_ERROR("ConnectionPool [%s] - loop %p is not in the pool \n", name_.c_str(), loop);
+        return nullptr;
+    }
+    return it->second.get();
+}
+
+void ConnectionPool::acquire(EventLoop *loop, const InetAddress &addr, const AcquireCallback &cb)
+{
+    LoopPool *pool = poolOf(loop);
+    if (pool == nullptr)
+    {
+        cb(TcpConnectionPtr());
+        return;
+    }
+    pool->acquire(addr, cb);
+}
+
+void ConnectionPool::release(const TcpConnectionPtr &conn, bool reusable)
+{
+    LoopPool *pool = poolOf(conn->getLoop());
+    if (pool != nullptr)
+    {
+        pool->release(conn, reusable);
+    }
+}
+
+int ConnectionPool::idleConnections(EventLoop *loop, const InetAddress &addr) const
+{
+    LoopPool *pool = poolOf(loop);
+    if (pool == nullptr)
+    {
+        return 0;
+    }
+    auto it = pool->hosts.find(addr.toIpPort());
+    return it == pool->hosts.end() ? 0 : static_cast<int>(it->second.idle.size());
+}
+
+int ConnectionPool::totalConnections(EventLoop *loop, const InetAddress &addr) const
+{
+    LoopPool *pool = poolOf(loop);
+    if (pool == nullptr)
+    {
+        return 0;
+    }
+    auto it = pool->hosts.find(addr.toIpPort());
+    return it == pool->hosts.end() ? 0 : it->second.total;
+}
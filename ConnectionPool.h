@@ -0,0 +1,92 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "InetAddress.h"
+#include "TimerId.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class EventLoop;
+class EventLoopThreadPool;
+
+/**
+ *  到后端（upstream）的长连接池，给代理这类服务用
+ *
+ *  按EventLoop分区：每个loop有自己的一份池子，只在该loop线程中访问，不加锁
+ *  subloop N上来的请求借的也是subloop N上的upstream连接，转发数据不需要跨线程
+ *
+ *  每个loop上每个后端（ip:port）：
+ *    maxPerHost  最多同时有多少个连接（空闲+借出+正在连接），到了上限的acquire排队等别人归还
+ *    maxIdle     最多保留多少个空闲连接，多出来的归还时直接关闭
+ *    idleTimeout 空闲超过这个时间的连接在健康检查时关闭
+ *  空闲连接一直在poller上，对端关闭马上就能发现；空闲时收到数据说明协议已经乱了，直接关闭
+ *  setHealthCheck可以再加一个自定义的检查，每隔interval秒对空闲连接调用一次
+ */
+class ConnectionPool : noncopyable
+{
+public:
+    // 借到连接的回调，在loop线程中执行，连接失败时参数为空
+    using AcquireCallback = std::function<void(const TcpConnectionPtr&)>;
+    // 返回false的空闲连接会被关闭
+    using HealthCheck = std::function<bool(const TcpConnectionPtr&)>;
+
+    // threadPool要先start，ConnectionPool要在所有loop都退出以后再析构（和TcpServer的连接一样）
+    ConnectionPool(EventLoopThreadPool *threadPool, const std::string &nameArg);
+    ~ConnectionPool();
+
+    // 下面这些在start之前设置
+    void setMaxIdle(int maxIdle) { maxIdle_ = maxIdle; }
+    void setMaxPerHost(int maxPerHost) { maxPerHost_ = maxPerHost; }
+    void setIdleTimeout(double seconds) { idleTimeout_ = seconds; }
+    // 新建连接（包括Connector的退避重试）超过这个时间还没连上，就放弃这个连接，让排在最前面的acquire失败
+    void setConnectTimeout(double seconds) { connectTimeout_ = seconds; }
+    // 每个排队的acquire最多等多久，超时cb收到空的连接，0表示一直等
+    void setAcquireTimeout(double seconds) { acquireTimeout_ = seconds; }
+    void setHealthCheck(double interval, const HealthCheck &check)
+    {
+        healthCheckInterval_ = interval;
+        healthCheck_ = check;
+    }
+
+    // 为threadPool中的每个loop建好池子，开启健康检查的定时器
+    void start();
+
+    // 预热：每个loop上预先建立n个（不超过maxIdle）到addr的空闲连接，线程安全
+    void warmUp(const InetAddress &addr, int n);
+
+    // 在loop线程中调用，借一个loop上到addr的连接，有空闲连接的话cb在acquire返回之前就会被调用
+    // 借到以后可以设置自己的ConnectionCallback、MessageCallback、WriteCompleteCallback，
+    // 不要改CloseCallback，连接池靠它统计连接数
+    void acquire(EventLoop *loop, const InetAddress &addr, const AcquireCallback &cb);
+    // 在连接所在的loop线程中调用，用完归还，回调恢复成连接池自己的
+    // 连接的状态不能再复用（比如响应没有读完）的话传reusable=false，连接会被关闭
+    void release(const TcpConnectionPtr &conn, bool reusable = true);
+
+    // 在loop线程中调用，查看loop上到addr的连接数
+    int idleConnections(EventLoop *loop, const InetAddress &addr) const;
+    int totalConnections(EventLoop *loop, const InetAddress &addr) const;
+
+    const std::string& name() const { return name_; }
+private:
+    struct LoopPool;
+    LoopPool* poolOf(EventLoop *loop) const;
+
+    EventLoopThreadPool *threadPool_;
+    const std::string name_;
+
+    int maxIdle_;
+    int maxPerHost_;
+    double idleTimeout_;
+    double connectTimeout_;
+    double acquireTimeout_;
+    double healthCheckInterval_;
+    HealthCheck healthCheck_;
+
+    // start()的时候建好，之后这个map本身不再改变，所以各个loop线程查找不用加锁
+    std::unordered_map<EventLoop*, std::unique_ptr<LoopPool>> pools_;
+};
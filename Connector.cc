@@ -0,0 +1,252 @@
+#include "Connector.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+
+static int createNonblocking()
+{
+    int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sockfd < 0)
+    {
+        LOG_FATAL("%s:%s:%d connect socket create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    return sockfd;
+}
+
+static int getSocketError(int sockfd)
+{
+    int optval = 0;
+    socklen_t optlen = sizeof optval;
+    if (::getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    {
+        return errno;
+    }
+    return optval;
+}
+
+// 连本机没有监听的端口时，内核可能把临时端口分配成目标端口，自己连上了自己
+static bool isSelfConnect(int sockfd)
+{
+    sockaddr_in local, peer;
+    socklen_t addrlen = sizeof local;
+    ::bzero(&local, sizeof local);
+    ::bzero(&peer, sizeof peer);
+    if (::getsockname(sockfd, (sockaddr*)&local, &addrlen) < 0)
+    {
+        return false;
+    }
+    addrlen = sizeof peer;
+    if (::getpeername(sockfd, (sockaddr*)&peer, &addrlen) < 0)
+    {
+        return false;
+    }
+    return local.sin_port == peer.sin_port && local.sin_addr.s_addr == peer.sin_addr.s_addr;
+}
+
+const int Connector::kMaxRetryDelayMs;
+const int Connector::kInitRetryDelayMs;
+
+Connector::Connector(EventLoop *loop, const InetAddress &serverAddr)
+    : loop_(loop)
+    , serverAddr_(serverAddr)
+    , connect_(false)
+    , state_(kDisconnected)
+    , retryDelayMs_(kInitRetryDelayMs)
+{
+    LOG_DEBUG("Connector ctor[%p] \n", this);
+}
+
+Connector::~Connector()
+{
+    LOG_DEBUG("Connector dtor[%p] \n", this);
+}
+
+void Connector::start()
+{
+    connect_ = true;
+    loop_->runInLoop(std::bind(&Connector::startInLoop, shared_from_this()));
+}
+
+void Connector::startInLoop()
+{
+    if (connect_ && state_ == kDisconnected)
+    {
+        connect();
+    }
+    else
+    {
+        LOG_DEBUG("Connector::startInLoop do not connect \n");
+    }
+}
+
+void Connector::restart()
+{
+    setState(kDisconnected);
+    retryDelayMs_ = kInitRetryDelayMs;
+    connect_ = true;
+    startInLoop();
+}
+
+void Connector::stop()
+{
+    connect_ = false;
+    loop_->queueInLoop(std::bind(&Connector::stopInLoop, shared_from_this()));
+}
+
+void Connector::stopInLoop()
+{
+    // 正在等待重试的话，取消重试的定时器
+    loop_->cancel(retryTimer_);
+    retryTimer_ = TimerId();
+    if (state_ == kConnecting)
+    {
+        setState(kDisconnected);
+        int sockfd = removeAndResetChannel();
+        ::close(sockfd);
+    }
+}
+
+void Connector::connect()
+{
+    int sockfd = createNonblocking();
+    int ret = ::connect(sockfd, (sockaddr*)serverAddr_.getSockAddr(), sizeof(sockaddr_in));
+    int savedErrno = (ret == 0) ? 0 : errno;
+    switch (savedErrno)
+    {
+        case 0:
+        case EINPROGRESS:
+        case EINTR:
+        case EISCONN:
+            connecting(sockfd);
+            break;
+
+        // 暂时的错误，过一会再试
+        case EAGAIN:
+        case EADDRINUSE:
+        case EADDRNOTAVAIL:
+        case ECONNREFUSED:
+        case ENETUNREACH:
+            retry(sockfd);
+            break;
+
+        // 地址或者参数有问题，重试也没用
+        case EACCES:
+        case EPERM:
+        case EAFNOSUPPORT:
+        case EALREADY:
+        case EBADF:
+        case EFAULT:
+        case ENOTSOCK:
+            LOG_ERROR("Connector::connect %s error:%d \n", serverAddr_.toIpPort().c_str(), savedErrno);
+            ::close(sockfd);
+            break;
+
+        default:
+            LOG_ERROR("Connector::connect %s unexpected error:%d \n", serverAddr_.toIpPort().c_str(), savedErrno);
+            ::close(sockfd);
+            break;
+    }
+}
+
+void Connector::connecting(int sockfd)
+{
+    setState(kConnecting);
+    channel_.reset(new Channel(loop_, sockfd));
+    channel_->setWriteCallback(std::bind(&Connector::handleWrite, this));
+    channel_->setErrorCallback(std::bind(&Connector::handleError, this));
+    // 连接失败时epoll可能同时返回EPOLLHUP，交给handleError处理
+    channel_->setCloseCallback(std::bind(&Connector::handleError, this));
+    // 防止回调执行期间Connector被析构
+    channel_->tie(shared_from_this());
+    // 非阻塞connect完成（成功或失败）以后sockfd变为可写
+    channel_->enableWriting();
+}
+
+int Connector::removeAndResetChannel()
+{
+    channel_->disableAll();
+    channel_->remove();
+    int sockfd = channel_->fd();
+    // 现在可能正在Channel::handleEvent里面，不能马上释放channel_
+    loop_->queueInLoop(std::bind(&Connector::resetChannel, shared_from_this()));
+    return sockfd;
+}
+
+void Connector::resetChannel()
+{
+    channel_.reset();
+}
+
+void Connector::handleWrite()
+{
+    if (state_ != kConnecting)
+    {
+        return;
+    }
+
+    int sockfd = removeAndResetChannel();
+    int err = getSocketError(sockfd);
+    if (err)
+    {
+        LOG_ERROR("Connector::handleWrite %s SO_ERROR:%d \n", serverAddr_.toIpPort().c_str(), err);
+        retry(sockfd);
+    }
+    else if (isSelfConnect(sockfd))
+    {
+        LOG_ERROR("Connector::handleWrite %s self connect \n", serverAddr_.toIpPort().c_str());
+        retry(sockfd);
+    }
+    else
+    {
+        setState(kConnected);
+        if (connect_ && newConnectionCallback_)
+        {
+            newConnectionCallback_(sockfd);
+        }
+        else
+        {
+            ::close(sockfd);
+        }
+    }
+}
+
+void Connector::handleError()
+{
+    if (state_ == kConnecting)
+    {
+        int sockfd = removeAndResetChannel();
+        int err = getSocketError(sockfd);
+        LOG_ERROR("Connector::handleError %s SO_ERROR:%d \n", serverAddr_.toIpPort().c_str(), err);
+        retry(sockfd);
+    }
+}
+
+void Connector::retry(int sockfd)
+{
+    ::close(sockfd);
+    setState(kDisconnected);
+    if (connect_)
+    {
+        LOG_INFO("Connector::retry connecting to %s in %d milliseconds \n",
+            serverAddr_.toIpPort().c_str(), retryDelayMs_);
+        // 用weak_ptr，Connector已经析构了就不再重连
+        std::weak_ptr<Connector> weak(shared_from_this());
+        retryTimer_ = loop_->runAfter(retryDelayMs_ / 1000.0, [weak]()
+        {
+            ConnectorPtr connector = weak.lock();
+            if (connector)
+            {
+                connector->retryTimer_ = TimerId();
+                connector->startInLoop();
+            }
+        });
+        retryDelayMs_ = std::min(retryDelayMs_ * 2, kMaxRetryDelayMs);
+    }
+}
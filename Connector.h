@@ -0,0 +1,62 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "TimerId.h"
+
+#include <functional>
+#include <memory>
+#include <atomic>
+
+class Channel;
+class EventLoop;
+
+/**
+ *  主动发起连接，TcpClient使用
+ *  非阻塞connect，把sockfd打包成channel等可写事件，可写以后用SO_ERROR判断是否连接成功
+ *  连接失败以后关掉sockfd，按指数退避（0.5s、1s、2s...最长30s）用定时器重新连接
+ *  连接成功以后把sockfd交给newConnectionCallback，Connector就不再管这个sockfd了
+ */
+class Connector : noncopyable, public std::enable_shared_from_this<Connector>
+{
+public:
+    using NewConnectionCallback = std::function<void(int sockfd)>;
+
+    Connector(EventLoop *loop, const InetAddress &serverAddr);
+    ~Connector();
+
+    void setNewConnectionCallback(const NewConnectionCallback &cb) { newConnectionCallback_ = cb; }
+
+    const InetAddress& serverAddress() const { return serverAddr_; }
+
+    void start();   // 任何线程都可以调用
+    void restart(); // 只能在loop线程中调用，重置重试间隔后重新连接
+    void stop();    // 任何线程都可以调用
+
+    static const int kMaxRetryDelayMs = 30 * 1000;
+    static const int kInitRetryDelayMs = 500;
+private:
+    enum States { kDisconnected, kConnecting, kConnected };
+
+    void setState(States s) { state_ = s; }
+    void startInLoop();
+    void stopInLoop();
+    void connect();
+    void connecting(int sockfd);
+    void handleWrite();
+    void handleError();
+    void retry(int sockfd);
+    int removeAndResetChannel();
+    void resetChannel();
+
+    EventLoop *loop_;
+    InetAddress serverAddr_;
+    std::atomic_bool connect_;
+    std::atomic_int state_;
+    std::unique_ptr<Channel> channel_;
+    NewConnectionCallback newConnectionCallback_;
+    int retryDelayMs_;
+    TimerId retryTimer_;
+};
+
+using ConnectorPtr = std::shared_ptr<Connector>;
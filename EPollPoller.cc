@@ -1,5 +1,6 @@
 #include "EPollPoller.h"
 #include "Logger.h"
+#include "BinaryLogging.h"
 #include "Channel.h"
 
 #include <errno.h>
@@ -40,7 +41,7 @@ EPollPoller::~EPollPoller()
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 {
     // 实际上应该用LOG_DEBUG更为合理
-    LOG_INFO("func=%s => fd total count:%lu \n", __FUNCTION__, channels_.size());
+    LOG_FAST(INFO, "func=%s => fd total count:%lu \n", __FUNCTION__, channels_.size());
 	
     // &(*events_.begin()) 就是event_这个vector首个元素的地址,
     // counts = epoll_wait(epfd,events,20,500); 一般我们这样使用，其中events是一个数组，数组名就是数组的首地址
@@ -54,7 +55,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
    // 有发生事件
     if (numEvents > 0)
     {
-        LOG_INFO("%d events happened \n", numEvents);
+        LOG_FAST(INFO, "%d events happened \n", numEvents);
         fillActiveChannels(numEvents, activeChannels);
 		// 扩容
         if (numEvents == events_.size())
@@ -83,7 +84,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 void EPollPoller::updateChannel(Channel *channel)
 {
     const int index = channel->index();
-    LOG_INFO("func=%s => fd=%d events=%d index=%d \n", __FUNCTION__, channel->fd(), channel->events(), index);
+    LOG_FAST(INFO, "func=%s => fd=%d events=%d index=%d \n", __FUNCTION__, channel->fd(), channel->events(), index);
 
     if (index == kNew || index == kDeleted)
     {
@@ -93,6 +94,13 @@ void EPollPoller::updateChannel(Channel *channel)
 			// 出现错误
             channels_[fd] = channel;
         }
+        // 已经从epoll中删掉的channel再disableAll一次（比如先停了读再关闭连接）不能再加回去，
+        // 事件为空也会收到EPOLLHUP，关闭回调就会被调用两次
+        if (channel->isNoneEvent())
+        {
+            channel->set_index(kDeleted);
+            return;
+        }
 
         channel->set_index(kAdded);
         update(EPOLL_CTL_ADD, channel);
@@ -120,7 +128,7 @@ void EPollPoller::removeChannel(Channel *channel)
     int fd = channel->fd();
     channels_.erase(fd);
 
-    LOG_INFO("func=%s => fd=%d\n", __FUNCTION__, fd);
+    LOG_FAST(INFO, "func=%s => fd=%d\n", __FUNCTION__, fd);
     // 还要看是否添加了，若添加了，则还要再epollfd_中去除
     int index = channel->index();
     if (index == kAdded)
@@ -2,12 +2,15 @@
 #include "Logger.h"
 #include "Poller.h"
 #include "Channel.h"
+#include "MemoryBudget.h"
+#include "TimerQueue.h"
 
 #include <sys/eventfd.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <memory>
+#include <algorithm>
 
 // __thread
 // 防止一个线程创建多个EventLoop
@@ -36,6 +39,17 @@ EventLoop::EventLoop()
     , poller_(Poller::newDefaultPoller(this))
     , wakeupFd_(createEventfd())
     , wakeupChannel_(new Channel(this, wakeupFd_))
+    , timerQueue_(new TimerQueue(this))
+    , budgetBytes_(0)
+    , budgetOps_(0)
+    , iterationBytes_(0)
+    , iterationOps_(0)
+    , iteration_(0)
+    , bufferBytes_(0)
+    , unflushedBufferBytes_(0)
+    , delayCount_(0)
+    , delayTotalMicros_(0)
+    , delayMaxMicros_(0)
 {
     LOG_DEBUG("EventLoop created %p in thread %d \n", this, threadId_);
     if (t_loopInThisThread)
@@ -74,11 +88,26 @@ void EventLoop::loop()
         activeChannels_.clear();
         // 监听两类fd   一种是client的fd，一种wakeupfd
         pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        iterationBytes_ = 0;
+        iterationOps_ = 0;
+        // epoll每次返回就绪fd的顺序基本不变，预算用完时被跳过的总是排在后面的那些，所以每一轮轮换一下起点
+        if ((budgetBytes_ > 0 || budgetOps_ > 0) && activeChannels_.size() > 1)
+        {
+            size_t start = iteration_++ % activeChannels_.size();
+            std::rotate(activeChannels_.begin(), activeChannels_.begin() + start, activeChannels_.end());
+        }
         for (Channel *channel : activeChannels_)
         {
             // poller监听哪些channel发生事件了，上报给eventloop，eventloop就通知channel处理相应的事件
             channel->handleEvent(pollReturnTime_);
         }
+        // 这一轮连接缓冲区的变化一次性加到全局预算上，放在doPendingFunctors前面，
+        // 这样预算降下来以后投递给本loop的恢复读回调这一轮就能执行
+        if (unflushedBufferBytes_ != 0)
+        {
+            MemoryBudget::instance().add(unflushedBufferBytes_);
+            unflushedBufferBytes_ = 0;
+        }
         // 执行当前eventloop事件循环需要处理的回调操作
         /**
          * IO线程 mainloop（mainReactor）接受新的fd，然后打包成channel分发给subloop（subReactor）
@@ -116,7 +145,7 @@ void EventLoop::runInLoop(Functor cb)
 	// 需要先唤醒该线程中的loop，再执行，不是想象的去别人线程执行该cb
     else 
     {
-        queueInLoop(cb);
+        queueInLoop(std::move(cb));
     }
 }
 // 把cb放入队列中，唤醒loop所在的线程，执行cb
@@ -125,7 +154,7 @@ void EventLoop::queueInLoop(Functor cb)
 	// 加个锁
     {
         std::unique_lock<std::mutex> lock(mutex_);
-        pendingFunctors_.emplace_back(cb);
+        pendingFunctors_.emplace_back(std::move(cb)); // 移动进去，cb里面绑定的数据不会被拷贝
     }
 
     // 唤醒需要执行上述的cb的线程
@@ -156,6 +185,49 @@ void EventLoop::wakeup()
     }
 }
 
+TimerId EventLoop::runAt(Timestamp time, Functor cb)
+{
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, Functor cb)
+{
+    return runAt(addTime(Timestamp::now(), delay), std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, Functor cb)
+{
+    return timerQueue_->addTimer(std::move(cb), addTime(Timestamp::now(), interval), interval);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
+void EventLoop::setIterationBudget(size_t maxBytes, int maxOps)
+{
+    budgetBytes_ = maxBytes;
+    budgetOps_ = maxOps;
+}
+
+size_t EventLoop::ioBudget(size_t want) const
+{
+    if (budgetOps_ > 0 && iterationOps_ >= budgetOps_)
+    {
+        return 0;
+    }
+    if (budgetBytes_ > 0)
+    {
+        if (iterationBytes_ >= budgetBytes_)
+        {
+            return 0;
+        }
+        return std::min(want, budgetBytes_ - iterationBytes_);
+    }
+    return want;
+}
+
 // EventLoop中使用Channel的方法
 void EventLoop::updateChannel(Channel *channel)
 {
@@ -5,13 +5,16 @@
 #include <atomic>
 #include <memory>
 #include <mutex>
+#include <stdint.h>
 
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "TimerId.h"
 
 class Channel;
 class Poller;
+class TimerQueue;
 
 // 把这个类想成，既可以作为mainReactor，又可以作为subReactor
 
@@ -43,11 +46,72 @@ public:
     // 用来唤醒loop所在的线程的
     void wakeup();
 
+    // 定时器，都是线程安全的，回调在loop线程中执行
+    // 在time时刻执行cb
+    TimerId runAt(Timestamp time, Functor cb);
+    // delay秒以后执行cb
+    TimerId runAfter(double delay, Functor cb);
+    // 每隔interval秒执行一次cb
+    TimerId runEvery(double interval, Functor cb);
+    // 取消定时器，已经执行过的一次性定时器取消了也没关系
+    void cancel(TimerId timerId);
+
     // EventLoop中使用Channel的方法
     void updateChannel(Channel *channel);
     void removeChannel(Channel *channel);
     bool hasChannel(Channel *channel);
 
+    // 每一轮循环中所有连接一共最多读写maxBytes个字节、maxOps次，0表示不限制
+    // 超过预算的连接这一轮就不读写了，水平触发的epoll下一轮还会返回它，这样大流量的连接不会让同一个loop上的其他连接一直等
+    // 要在loop线程中调用，比如在ThreadInitCallback中
+    void setIterationBudget(size_t maxBytes, int maxOps);
+    // 连接读写之前调用，返回这一次最多能读写多少字节，返回0说明这一轮的预算用完了
+    size_t ioBudget(size_t want) const;
+    // 连接读写之后调用，扣掉这一轮的预算
+    void chargeIo(size_t bytes)
+    {
+        iterationBytes_ += bytes;
+        ++iterationOps_;
+    }
+
+    // 本loop上所有连接的输入/输出缓冲区的字节数变化，只能在loop线程中调用
+    // 每一轮循环结束时把这一轮的变化量一次性加到MemoryBudget上
+    void addBufferBytes(int64_t delta)
+    {
+        bufferBytes_ += delta;
+        unflushedBufferBytes_ += delta;
+    }
+    int64_t bufferBytes() const { return bufferBytes_; }
+    int64_t unflushedBufferBytes() const { return unflushedBufferBytes_; }
+
+    // 数据被内核收到以后过了多久loop才开始处理，只统计开启了TcpConnection::setRxTimestamping的连接
+    struct QueueingDelay
+    {
+        int64_t count;
+        int64_t totalMicros;
+        int64_t maxMicros;
+    };
+    // 在loop线程中调用
+    void recordQueueingDelay(int64_t micros)
+    {
+        // 只有loop线程写，不需要原子的读改写
+        delayCount_.store(delayCount_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        delayTotalMicros_.store(delayTotalMicros_.load(std::memory_order_relaxed) + micros, std::memory_order_relaxed);
+        if (micros > delayMaxMicros_.load(std::memory_order_relaxed))
+        {
+            delayMaxMicros_.store(micros, std::memory_order_relaxed);
+        }
+    }
+    // 任何线程都可以调用，从loop开始到现在的累计值，平均值是totalMicros / count
+    QueueingDelay queueingDelay() const
+    {
+        QueueingDelay delay;
+        delay.count = delayCount_.load(std::memory_order_relaxed);
+        delay.totalMicros = delayTotalMicros_.load(std::memory_order_relaxed);
+        delay.maxMicros = delayMaxMicros_.load(std::memory_order_relaxed);
+        return delay;
+    }
+
     // 若返回真，则说明该EventLoop在创建这个EventLoop线程中，若为假，则执行queueInLoop
     bool isInLoopThread() const { return threadId_ ==  CurrentThread::tid(); }
 private:
@@ -77,9 +141,24 @@ private:
     // 是mainReactor和subReactor通信的一个fd，然后该channel的事件是mainReactor有请求到来，需要分发到subReactor
     // 这个channel就只负责mainReactor和subReactor直接的通信
     std::unique_ptr<Channel> wakeupChannel_;
+    std::unique_ptr<TimerQueue> timerQueue_;
 
     ChannelList activeChannels_;
 
+    // 每一轮的读写预算，0表示不限制
+    size_t budgetBytes_;
+    int budgetOps_;
+    size_t iterationBytes_;
+    int iterationOps_;
+    size_t iteration_; // 开启预算后，每一轮从activeChannels_的不同位置开始处理
+
+    int64_t bufferBytes_; // 本loop上所有连接缓冲区的字节数
+    int64_t unflushedBufferBytes_; // 还没有加到MemoryBudget上的变化量
+
+    std::atomic<int64_t> delayCount_;
+    std::atomic<int64_t> delayTotalMicros_;
+    std::atomic<int64_t> delayMaxMicros_;
+
     std::atomic_bool callingPendingFunctors_; // 标识当前loop是否有需要执行的回调操作
     std::vector<Functor> pendingFunctors_; // 存储loop需要执行的所有的回调操作
     std::mutex mutex_; // 互斥锁，用来保护上面vector容器的线程安全操作
@@ -60,6 +60,6 @@ std::vector<EventLoop*> EventLoopThreadPool::getAllLoops()
     }
     else
     {
-        loops_;
+        return loops_;
     }
 }
\ No newline at end of file
@@ -0,0 +1,436 @@
+#include "HttpParser.h"
+#include "Buffer.h"
+
+#include <algorithm>
+#include <strings.h>
+
+namespace
+{
+
+bool equalsIgnoreCase(const StringPiece &a, const char *b)
+{
+    const size_t len = ::strlen(b);
+    return a.size() == len && ::strncasecmp(a.data(), b, len) == 0;
+}
+
+// 逗号分隔的列表中是否有token，比如 Connection: keep-alive, Upgrade
+bool containsToken(const StringPiece &list, const char *token)
+{
+    const size_t len = ::strlen(token);
+    size_t start = 0;
+    while (start < list.size())
+    {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos)
+        {
+            comma = list.size();
+        }
+        StringPiece item = list.substr(start, comma - start);
+        while (!item.empty() && (item[0] == ' ' || item[0] == '\t'))
+        {
+            item.remove_prefix(1);
+        }
+        while (!item.empty() && (item[item.size() - 1] == ' ' || item[item.size() - 1] == '\t'))
+        {
+            item.remove_suffix(1);
+        }
+        if (item.size() == len && ::strncasecmp(item.data(), token, len) == 0)
+        {
+            return true;
+        }
+        start = comma + 1;
+    }
+    return false;
+}
+
+HttpRequest::Method toMethod(const StringPiece &m)
+{
+    switch (m.size())
+    {
+    case 3:
+        if (m == "GET") return HttpRequest::kGet;
+        if (m == "PUT") return HttpRequest::kPut;
+        break;
+    case 4:
+        if (m == "POST") return HttpRequest::kPost;
+        if (m == "HEAD") return HttpRequest::kHead;
+        break;
+    case 5:
+        if (m == "PATCH") return HttpRequest::kPatch;
+        break;
+    case 6:
+        if (m == "DELETE") return HttpRequest::kDelete;
+        break;
+    case 7:
+        if (m == "OPTIONS") return HttpRequest::kOptions;
+        break;
+    }
+    return HttpRequest::kInvalid;
+}
+
+} // namespace
+
+HttpParser::HttpParser(size_t maxBodySize)
+    : maxBodySize_(maxBodySize)
+{
+    reset();
+}
+
+void HttpParser::reset()
+{
+    state_ = kRequestLine;
+    pos_ = 0;
+    scanned_ = 0;
+    errorStatus_ = 0;
+    method_ = path_ = query_ = Range{0, 0};
+    version_ = HttpRequest::kUnknown;
+    headers_.clear();
+    bodyOffset_ = 0;
+    contentLength_ = 0;
+    chunked_ = false;
+    chunkRemaining_ = 0;
+    trailerOffset_ = 0;
+    chunkedBody_.clear();
+    request_.headers_.clear();
+}
+
+HttpParser::Result HttpParser::parse(const Buffer *buf, Timestamp receiveTime)
+{
+    if (errorStatus_ != 0)
+    {
+        return kError;
+    }
+    const char *base = buf->peek();
+    const char *end = buf->beginWrite();
+
+    while (true)
+    {
+        switch (state_)
+        {
+        case kBody:
+            if (static_cast<size_t>(end - base) < bodyOffset_ + contentLength_)
+            {
+                return kNeedMore;
+            }
+            pos_ = bodyOffset_ + contentLength_;
+            state_ = kDone;
+            break;
+
+        case kChunkData:
+        {
+            const size_t n = std::min(static_cast<size_t>(end - base) - pos_, chunkRemaining_);
+            chunkedBody_.append(base + pos_, n);
+            pos_ += n;
+            chunkRemaining_ -= n;
+            if (chunkRemaining_ > 0)
+            {
+                return kNeedMore;
+            }
+            state_ = kChunkDataEnd;
+            break;
+        }
+
+        case kDone:
+            finish(base, receiveTime);
+            return kComplete;
+
+        default:
+        {
+            // 剩下的状态都是按行解析的，行尾是CRLF，也接受只有LF的
+            const char *lineBegin = base + pos_;
+            // 这一行已经找过的部分不再找一遍
+            const char *eol = buf->findEOL(base + std::max(pos_, scanned_));
+            // 头部从请求的开头算起，trailer从trailer部分的开头算起，前面的chunked body不算
+            const bool headerLine = state_ == kRequestLine || state_ == kHeaders || state_ == kTrailers;
+            const size_t headerStart = state_ == kTrailers ? trailerOffset_ : 0;
+            if (eol == nullptr)
+            {
+                if (headerLine && static_cast<size_t>(end - base) - headerStart > kMaxHeaderBytes)
+                {
+                    return fail(431);
+                }
+                if (state_ == kChunkSize && end - lineBegin > 1024)
+                {
+                    return fail(400);
+                }
+                // 块数据后面只能是CRLF，两个字节还没有LF就是格式错误
+                if (state_ == kChunkDataEnd && end - lineBegin >= 2)
+                {
+                    return fail(400);
+                }
+                scanned_ = end - base;
+                return kNeedMore;
+            }
+            const char *lineEnd = eol;
+            if (lineEnd > lineBegin && lineEnd[-1] == '\r')
+            {
+                --lineEnd;
+            }
+            pos_ = eol + 1 - base;
+            // 一次读进来很多完整的头部行时上面的检查不会触发，每解析一行都要检查
+            if (headerLine && pos_ - headerStart > kMaxHeaderBytes)
+            {
+                return fail(431);
+            }
+
+            if (state_ == kRequestLine)
+            {
+                // 请求之前的空行忽略掉（RFC 7230 3.5）
+                if (lineBegin == lineEnd)
+                {
+                    continue;
+                }
+                if (!parseRequestLine(base, lineBegin, lineEnd))
+                {
+                    return fail(400);
+                }
+                state_ = kHeaders;
+            }
+            else if (state_ == kHeaders)
+            {
+                if (lineBegin == lineEnd)
+                {
+                    int status = headersComplete(base);
+                    if (status != 0)
+                    {
+                        return fail(status);
+                    }
+                }
+                else if (!parseHeader(base, lineBegin, lineEnd))
+                {
+                    return fail(400);
+                }
+            }
+            else if (state_ == kChunkSize)
+            {
+                // 块大小是十六进制，后面可能跟着;扩展，忽略扩展
+                size_t size = 0;
+                const char *p = lineBegin;
+                for (; p < lineEnd; ++p)
+                {
+                    int digit;
+                    if (*p >= '0' && *p <= '9') digit = *p - '0';
+                    else if (*p >= 'a' && *p <= 'f') digit = *p - 'a' + 10;
+                    else if (*p >= 'A' && *p <= 'F') digit = *p - 'A' + 10;
+                    else break;
+                    if (size > (maxBodySize_ >> 4))
+                    {
+                        return fail(413);
+                    }
+                    size = size * 16 + digit;
+                }
+                if (p == lineBegin || (p < lineEnd && *p != ';' && *p != ' ' && *p != '\t'))
+                {
+                    return fail(400);
+                }
+                if (chunkedBody_.size() + size > maxBodySize_)
+                {
+                    return fail(413);
+                }
+                if (size == 0)
+                {
+                    state_ = kTrailers;
+                    trailerOffset_ = pos_;
+                }
+                else
+                {
+                    chunkRemaining_ = size;
+                    state_ = kChunkData;
+                }
+            }
+            else if (state_ == kChunkDataEnd)
+            {
+                if (lineBegin != lineEnd)
+                {
+                    return fail(400);
+                }
+                state_ = kChunkSize;
+            }
+            else // kTrailers
+            {
+                // trailer头部不使用，读到空行为止
+                if (lineBegin == lineEnd)
+                {
+                    state_ = kDone;
+                }
+            }
+            break;
+        }
+        }
+    }
+}
+
+// METHOD SP request-target SP HTTP-version
+bool HttpParser::parseRequestLine(const char *base, const char *begin, const char *end)
+{
+    const char *space = static_cast<const char*>(::memchr(begin, ' ', end - begin));
+    if (space == nullptr || space == begin)
+    {
+        return false;
+    }
+    method_ = range(base, begin, space);
+
+    const char *target = space + 1;
+    space = static_cast<const char*>(::memchr(target, ' ', end - target));
+    if (space == nullptr || space == target)
+    {
+        return false;
+    }
+    const char *question = static_cast<const char*>(::memchr(target, '?', space - target));
+    if (question != nullptr)
+    {
+        path_ = range(base, target, question);
+        query_ = range(base, question + 1, space);
+    }
+    else
+    {
+        path_ = range(base, target, space);
+        query_ = Range{0, 0};
+    }
+
+    StringPiece version(space + 1, end - space - 1);
+    if (version == "HTTP/1.1")
+    {
+        version_ = HttpRequest::kHttp11;
+    }
+    else if (version == "HTTP/1.0")
+    {
+        version_ = HttpRequest::kHttp10;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+// name: OWS value OWS
+bool HttpParser::parseHeader(const char *base, const char *begin, const char *end)
+{
+    // 以空白开头的是已经废弃的折行写法，不支持
+    if (*begin == ' ' || *begin == '\t')
+    {
+        return false;
+    }
+    const char *colon = static_cast<const char*>(::memchr(begin, ':', end - begin));
+    if (colon == nullptr || colon == begin)
+    {
+        return false;
+    }
+    // 名字和冒号之间不能有空白
+    if (colon[-1] == ' ' || colon[-1] == '\t')
+    {
+        return false;
+    }
+    const char *value = colon + 1;
+    while (value < end && (*value == ' ' || *value == '\t'))
+    {
+        ++value;
+    }
+    const char *valueEnd = end;
+    while (valueEnd > value && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t'))
+    {
+        --valueEnd;
+    }
+    headers_.emplace_back(range(base, begin, colon), range(base, value, valueEnd));
+    return true;
+}
+
+int HttpParser::headersComplete(const char *base)
+{
+    bool hasLength = false;
+    for (const auto &h : headers_)
+    {
+        StringPiece name = piece(base, h.first);
+        if (equalsIgnoreCase(name, "Transfer-Encoding"))
+        {
+            if (!containsToken(piece(base, h.second), "chunked"))
+            {
+                return 501;
+            }
+            chunked_ = true;
+        }
+        else if (equalsIgnoreCase(name, "Content-Length"))
+        {
+            StringPiece value = piece(base, h.second);
+            if (value.empty())
+            {
+                return 400;
+            }
+            size_t length = 0;
+            for (size_t i = 0; i < value.size(); ++i)
+            {
+                if (value[i] < '0' || value[i] > '9')
+                {
+                    return 400;
+                }
+                length = length * 10 + (value[i] - '0');
+                if (length > maxBodySize_)
+                {
+                    return 413;
+                }
+            }
+            // 多个不一致的Content-Length可能是请求走私
+            if (hasLength && length != contentLength_)
+            {
+                return 400;
+            }
+            hasLength = true;
+            contentLength_ = length;
+        }
+    }
+
+    if (chunked_)
+    {
+        // 同时有两个的请求不可信（RFC 7230 3.3.3）
+        if (hasLength)
+        {
+            return 400;
+        }
+        state_ = kChunkSize;
+    }
+    else if (contentLength_ > 0)
+    {
+        bodyOffset_ = pos_;
+        state_ = kBody;
+    }
+    else
+    {
+        state_ = kDone;
+    }
+    return 0;
+}
+
+void HttpParser::finish(const char *base, Timestamp receiveTime)
+{
+    HttpRequest &req = request_;
+    req.methodString_ = piece(base, method_);
+    req.method_ = toMethod(req.methodString_);
+    req.version_ = version_;
+    req.path_ = piece(base, path_);
+    req.query_ = piece(base, query_);
+    req.headers_.clear();
+    for (const auto &h : headers_)
+    {
+        req.headers_.push_back(HttpRequest::Header{piece(base, h.first), piece(base, h.second)});
+    }
+    if (chunked_)
+    {
+        req.body_ = StringPiece(chunkedBody_);
+    }
+    else
+    {
+        req.body_ = StringPiece(base + bodyOffset_, contentLength_);
+    }
+    req.receiveTime_ = receiveTime;
+
+    StringPiece connection = req.header("Connection");
+    if (version_ == HttpRequest::kHttp11)
+    {
+        req.keepAlive_ = !containsToken(connection, "close");
+    }
+    else
+    {
+        req.keepAlive_ = containsToken(connection, "keep-alive");
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "HttpRequest.h"
+#include "Timestamp.h"
+
+#include <string>
+#include <vector>
+
+class Buffer;
+
+/**
+ *  可以接着上次继续解析的HTTP/1.1请求解析器，每个连接一个
+ *
+ *  直接在输入Buffer上解析，数据不够一个完整请求的时候返回kNeedMore，记住已经解析到的位置，
+ *  下一次有新数据到来时从这个位置接着解析，已经解析过的字节不会再扫描一遍
+ *  解析过程中只记录各个字段相对于peek()的偏移，所以Buffer扩容、移动数据都没关系，
+ *  要求是请求完整之前不能retrieve，返回kComplete时才把偏移转换成指向Buffer的StringPiece
+ *
+ *  支持Content-Length和chunked的body，chunked的数据块要去掉分块的格式，所以拷贝到一个string中
+ *
+ *  用法：
+ *      while (parser.parse(buf, receiveTime) == HttpParser::kComplete)
+ *      {
+ *          handle(parser.request());
+ *          buf->retrieve(parser.requestBytes());
+ *          parser.reset();
+ *      }
+ */
+class HttpParser : noncopyable
+{
+public:
+    enum Result
+    {
+        kNeedMore,  // 数据还不够一个完整的请求
+        kComplete,  // request()可以用了
+        kError,     // 请求格式错误，errorStatus()是应该回复的状态码
+    };
+
+    // 请求行+所有头部最多这么多字节，chunked的trailer部分单独算，也是这么多
+    static const size_t kMaxHeaderBytes = 64*1024;
+    static const size_t kDefaultMaxBodySize = 8*1024*1024;
+
+    explicit HttpParser(size_t maxBodySize = kDefaultMaxBodySize);
+
+    Result parse(const Buffer *buf, Timestamp receiveTime = Timestamp());
+
+    const HttpRequest& request() const { return request_; }
+    // 当前这个请求在buf中一共占了多少字节，kComplete之后用来retrieve
+    size_t requestBytes() const { return pos_; }
+    int errorStatus() const { return errorStatus_; }
+
+    // 开始解析下一个请求，已经分配的内存留着复用
+    void reset();
+private:
+    enum State
+    {
+        kRequestLine,
+        kHeaders,
+        kBody,          // Content-Length的body
+        kChunkSize,     // 块大小那一行
+        kChunkData,
+        kChunkDataEnd,  // 块数据后面的CRLF
+        kTrailers,
+        kDone,
+    };
+    // 相对于peek()的偏移
+    struct Range
+    {
+        size_t offset;
+        size_t length;
+    };
+
+    Result fail(int status)
+    {
+        errorStatus_ = status;
+        return kError;
+    }
+    bool parseRequestLine(const char *base, const char *begin, const char *end);
+    bool parseHeader(const char *base, const char *begin, const char *end);
+    // 头部都收齐了，根据Transfer-Encoding和Content-Length决定怎么读body，返回0表示没有错误
+    int headersComplete(const char *base);
+    // 把记录的偏移转换成StringPiece
+    void finish(const char *base, Timestamp receiveTime);
+
+    static StringPiece piece(const char *base, const Range &r)
+    {
+        return StringPiece(base + r.offset, r.length);
+    }
+    static Range range(const char *base, const char *begin, const char *end)
+    {
+        return Range{static_cast<size_t>(begin - base), static_cast<size_t>(end - begin)};
+    }
+
+    const size_t maxBodySize_;
+    State state_;
+    size_t pos_;        // 已经解析到的位置
+    size_t scanned_;    // 当前这一行已经找过LF的位置，没找到行尾的时候记下来
+    int errorStatus_;
+
+    Range method_;
+    Range path_;
+    Range query_;
+    HttpRequest::Version version_;
+    std::vector<std::pair<Range, Range>> headers_;
+    size_t bodyOffset_;
+    size_t contentLength_;
+    bool chunked_;
+    size_t chunkRemaining_;
+    size_t trailerOffset_; // trailer部分从哪里开始
+    std::string chunkedBody_;
+
+    HttpRequest request_;
+};
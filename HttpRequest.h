@@ -0,0 +1,75 @@
+#pragma once
+
+#include "StringPiece.h"
+#include "Timestamp.h"
+
+#include <vector>
+#include <strings.h>
+
+/**
+ *  解析好的HTTP请求，由HttpParser填好
+ *  除了chunked的body以外，所有字段都是直接指向输入Buffer的StringPiece，没有拷贝，
+ *  所以只在HttpCallback执行期间有效，需要保存的话自己as_string()
+ */
+class HttpRequest
+{
+public:
+    enum Method
+    {
+        kInvalid, kGet, kPost, kHead, kPut, kDelete, kOptions, kPatch
+    };
+    enum Version
+    {
+        kUnknown, kHttp10, kHttp11
+    };
+    struct Header
+    {
+        StringPiece name;
+        StringPiece value;
+    };
+
+    HttpRequest()
+        : method_(kInvalid)
+        , version_(kUnknown)
+        , keepAlive_(false)
+    {}
+
+    Method method() const { return method_; }
+    StringPiece methodString() const { return methodString_; }
+    Version version() const { return version_; }
+    // 请求目标中?之前的部分
+    StringPiece path() const { return path_; }
+    // ?之后的部分，不包括?
+    StringPiece query() const { return query_; }
+    const std::vector<Header>& headers() const { return headers_; }
+    StringPiece body() const { return body_; }
+    Timestamp receiveTime() const { return receiveTime_; }
+    // HTTP/1.1默认长连接，除非Connection: close；HTTP/1.0要有Connection: keep-alive
+    bool keepAlive() const { return keepAlive_; }
+
+    // 头部名字不区分大小写，没有的话返回空的StringPiece，同名的多个头部返回第一个
+    StringPiece header(const StringPiece &name) const
+    {
+        for (const Header &h : headers_)
+        {
+            if (h.name.size() == name.size()
+                && ::strncasecmp(h.name.data(), name.data(), name.size()) == 0)
+            {
+                return h.value;
+            }
+        }
+        return StringPiece();
+    }
+private:
+    friend class HttpParser;
+
+    Method method_;
+    StringPiece methodString_;
+    Version version_;
+    StringPiece path_;
+    StringPiece query_;
+    std::vector<Header> headers_;
+    StringPiece body_;
+    Timestamp receiveTime_;
+    bool keepAlive_;
+};
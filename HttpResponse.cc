@@ -0,0 +1,111 @@
+#include "HttpResponse.h"
+#include "Buffer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+const char* HttpResponse::reasonPhrase(int code)
+{
+    switch (code)
+    {
+    case 100: return "Continue";
+    case 200: return "OK";
+    case 201: return "Created";
+    case 204: return "No Content";
+    case 206: return "Partial Content";
+    case 301: return "Moved Permanently";
+    case 302: return "Found";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 408: return "Request Timeout";
+    case 413: return "Payload Too Large";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 502: return "Bad Gateway";
+    case 503: return "Service Unavailable";
+    case 505: return "HTTP Version Not Supported";
+    default: return "Unknown";
+    }
+}
+
+static void appendChunkTo(Buffer *output, const std::string &data)
+{
+    if (data.empty())
+    {
+        // 长度为0的块表示结束，不能发
+        return;
+    }
+    char buf[32];
+    int n = snprintf(buf, sizeof buf, "%zx\r\n", data.size());
+    output->append(buf, n);
+    output->append(data.data(), data.size());
+    output->append("\r\n", 2);
+}
+
+void HttpResponse::appendToBuffer(Buffer *output, bool includeBody) const
+{
+    char buf[64];
+    int n = snprintf(buf, sizeof buf, "HTTP/1.1 %d ", statusCode_);
+    output->append(buf, n);
+    if (!statusMessage_.empty())
+    {
+        output->append(statusMessage_.data(), statusMessage_.size());
+    }
+    else
+    {
+        const char *reason = reasonPhrase(statusCode_);
+        output->append(reason, ::strlen(reason));
+    }
+    output->append("\r\n", 2);
+
+    if (chunked_)
+    {
+        output->append("Transfer-Encoding: chunked\r\n", 28);
+    }
+    else
+    {
+        n = snprintf(buf, sizeof buf, "Content-Length: %zu\r\n", body_.size());
+        output->append(buf, n);
+    }
+    if (closeConnection_)
+    {
+        output->append("Connection: close\r\n", 19);
+    }
+    else
+    {
+        // HTTP/1.0的客户端要看到这个才会复用连接，HTTP/1.1的忽略它
+        output->append("Connection: Keep-Alive\r\n", 24);
+    }
+
+    for (const auto &header : headers_)
+    {
+        output->append(header.first.data(), header.first.size());
+        output->append(": ", 2);
+        output->append(header.second.data(), header.second.size());
+        output->append("\r\n", 2);
+    }
+    output->append("\r\n", 2);
+
+    if (!includeBody)
+    {
+        return;
+    }
+    if (chunked_)
+    {
+        appendChunkTo(output, body_);
+        for (const std::string &chunk : chunks_)
+        {
+            appendChunkTo(output, chunk);
+        }
+        output->append("0\r\n\r\n", 5);
+    }
+    else
+    {
+        output->append(body_.data(), body_.size());
+    }
+}
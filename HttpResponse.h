@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+class Buffer;
+
+// HttpCallback填好的响应，HttpServer把它编码到输出Buffer中
+class HttpResponse
+{
+public:
+    enum StatusCode
+    {
+        kUnknown,
+        k200Ok = 200,
+        k204NoContent = 204,
+        k301MovedPermanently = 301,
+        k400BadRequest = 400,
+        k404NotFound = 404,
+        k413PayloadTooLarge = 413,
+        k431HeaderFieldsTooLarge = 431,
+        k500InternalServerError = 500,
+        k501NotImplemented = 501,
+    };
+
+    explicit HttpResponse(bool close)
+        : statusCode_(kUnknown)
+        , closeConnection_(close)
+        , chunked_(false)
+    {}
+
+    // 没有设置statusMessage的话用标准的原因短语
+    void setStatusCode(int code) { statusCode_ = code; }
+    int statusCode() const { return statusCode_; }
+    void setStatusMessage(const std::string &message) { statusMessage_ = message; }
+
+    void setCloseConnection(bool on) { closeConnection_ = on; }
+    bool closeConnection() const { return closeConnection_; }
+
+    void setContentType(const std::string &contentType) { addHeader("Content-Type", contentType); }
+    void addHeader(const std::string &key, const std::string &value) { headers_.emplace_back(key, value); }
+
+    void setBody(const std::string &body) { body_ = body; }
+    void setBody(std::string &&body) { body_ = std::move(body); }
+    const std::string& body() const { return body_; }
+
+    // 用Transfer-Encoding: chunked发送，每次appendChunk的数据编码成一块，
+    // 适合转发上游的分块数据，body_作为第一块
+    void setChunked(bool on) { chunked_ = on; }
+    void appendChunk(const std::string &data) { chunks_.push_back(data); }
+    void appendChunk(std::string &&data) { chunks_.push_back(std::move(data)); }
+
+    // includeBody为false用于HEAD请求：头部照常（包括Content-Length），不发body
+    void appendToBuffer(Buffer *output, bool includeBody = true) const;
+
+    static const char* reasonPhrase(int code);
+private:
+    int statusCode_;
+    std::string statusMessage_;
+    bool closeConnection_;
+    bool chunked_;
+    std::vector<std::pair<std::string, std::string>> headers_;
+    std::string body_;
+    std::vector<std::string> chunks_;
+};
@@ -0,0 +1,97 @@
+#include "HttpServer.h"
+#include "HttpParser.h"
+#include "Logger.h"
+
+// 没有设置HttpCallback的时候都回复404
+static void defaultHttpCallback(const HttpRequest&, HttpResponse *resp)
+{
+    resp->setStatusCode(HttpResponse::k404NotFound);
+    resp->setCloseConnection(true);
+}
+
+HttpServer::HttpServer(EventLoop *loop,
+                const InetAddress &listenAddr,
+                const std::string &name,
+                TcpServer::Option option)
+    : server_(loop, listenAddr, name, option)
+    , httpCallback_(defaultHttpCallback)
+    , maxBodySize_(HttpParser::kDefaultMaxBodySize)
+{
+    server_.setConnectionCallback(
+        std::bind(&HttpServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(
+        std::bind(&HttpServer::onMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+void HttpServer::start()
+{
+    server_.start();
+}
+
+void HttpServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setContext(std::make_shared<HttpParser>(maxBodySize_));
+    }
+}
+
+void HttpServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    // 已经决定关闭的连接（比如Connection: close之后又发来的pipeline请求）不再处理
+    if (!conn->connected())
+    {
+        buf->retrieveAll();
+        return;
+    }
+
+    HttpParser *parser = static_cast<HttpParser*>(conn->getContext().get());
+    Buffer output;
+    bool close = false;
+    while (!close)
+    {
+        HttpParser::Result result = parser->parse(buf, receiveTime);
+        if (result == HttpParser::kNeedMore)
+        {
+            break;
+        }
+        if (result == HttpParser::kError)
+        {
+            LOG_ERROR("HttpServer::onMessage [%s] bad request, status %d \n",
+                conn->name().c_str(), parser->errorStatus());
+            HttpResponse response(true);
+            response.setStatusCode(parser->errorStatus());
+            response.appendToBuffer(&output);
+            buf->retrieveAll();
+            close = true;
+            break;
+        }
+
+        const HttpRequest &request = parser->request();
+        HttpResponse response(!request.keepAlive());
+        if (request.method() == HttpRequest::kInvalid)
+        {
+            response.setStatusCode(HttpResponse::k501NotImplemented);
+        }
+        else
+        {
+            httpCallback_(request, &response);
+        }
+        response.appendToBuffer(&output, request.method() != HttpRequest::kHead);
+        close = response.closeConnection();
+
+        // 请求的StringPiece指向buf，处理完才能复位
+        buf->retrieve(parser->requestBytes());
+        parser->reset();
+    }
+
+    if (output.readableBytes() > 0)
+    {
+        conn->send(&output);
+    }
+    if (close)
+    {
+        buf->retrieveAll();
+        conn->shutdown();
+    }
+}
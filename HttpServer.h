@@ -0,0 +1,43 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpServer.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+
+#include <functional>
+#include <string>
+
+/**
+ *  基于TcpServer的HTTP/1.1服务器
+ *
+ *  每个连接一个HttpParser，直接在inputBuffer_上解析，请求的各个字段都是指向inputBuffer_的StringPiece
+ *  支持长连接和pipeline：一次读到的多个请求按顺序调用HttpCallback，响应按请求的顺序攒在一个Buffer中，
+ *  最后一次send出去，所以一批pipeline请求的响应通常只需要一次write
+ *  HttpCallback是同步的，在连接所在的loop线程中执行
+ */
+class HttpServer : noncopyable
+{
+public:
+    using HttpCallback = std::function<void (const HttpRequest&, HttpResponse*)>;
+
+    HttpServer(EventLoop *loop,
+                const InetAddress &listenAddr,
+                const std::string &name,
+                TcpServer::Option option = TcpServer::kNoReusePort);
+
+    void setHttpCallback(const HttpCallback &cb) { httpCallback_ = cb; }
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    void setThreadInitCallback(const TcpServer::ThreadInitCallback &cb) { server_.setThreadInitcallback(cb); }
+    // 超过的请求回复413并关闭连接，在start之前设置
+    void setMaxBodySize(size_t maxBodySize) { maxBodySize_ = maxBodySize; }
+
+    void start();
+private:
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+
+    TcpServer server_;
+    HttpCallback httpCallback_;
+    size_t maxBodySize_;
+};
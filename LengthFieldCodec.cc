@@ -0,0 +1,109 @@
+#include "LengthFieldCodec.h"
+#include "Buffer.h"
+#include "TcpConnection.h"
+#include "Logger.h"
+
+#include <algorithm>
+
+LengthFieldCodec::LengthFieldCodec(const FrameCallback &cb,
+                                int lengthFieldLength,
+                                size_t maxFrameLength)
+    : frameCallback_(cb)
+    , lengthFieldLength_(lengthFieldLength)
+    , maxFrameLength_(maxFrameLength)
+{
+    if (lengthFieldLength_ != 1 && lengthFieldLength_ != 2
+        && lengthFieldLength_ != 4 && lengthFieldLength_ != 8)
+    {
+        LOG_FATAL("%s:%s:%d invalid lengthFieldLength:%d \n", __FILE__, __FUNCTION__, __LINE__, lengthFieldLength_);
+    }
+}
+
+size_t LengthFieldCodec::peekLength(const Buffer *buf) const
+{
+    switch (lengthFieldLength_)
+    {
+    case 1:
+        return static_cast<uint8_t>(buf->peekInt8());
+    case 2:
+        return static_cast<uint16_t>(buf->peekInt16());
+    case 4:
+        return static_cast<uint32_t>(buf->peekInt32());
+    default:
+        return static_cast<uint64_t>(buf->peekInt64());
+    }
+}
+
+// 一次可能读到多个帧，也可能只读到半个帧，半个帧就留在buffer里面等下一次数据到来
+void LengthFieldCodec::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    const size_t headerLen = static_cast<size_t>(lengthFieldLength_);
+    while (buf->readableBytes() >= headerLen)
+    {
+        const size_t len = peekLength(buf);
+        if (len > maxFrameLength_)
+        {
+            LOG_ERROR("LengthFieldCodec::onMessage [%s] invalid frame length:%lu \n", conn->name().c_str(), len);
+            // 后面的数据已经没法分帧了，丢掉并且直接关闭，不然每次读到数据都会再走到这里
+            buf->retrieveAll();
+            conn->forceClose();
+            break;
+        }
+        if (buf->readableBytes() < headerLen + len)
+        {
+            break;
+        }
+
+        buf->retrieve(headerLen);
+        // 帧直接指向buffer内部，回调返回以后才复位
+        frameCallback_(conn, buf->peek(), len, receiveTime);
+        buf->retrieve(len);
+    }
+}
+
+size_t LengthFieldCodec::maxEncodableLength() const
+{
+    size_t maxLength = maxFrameLength_;
+    if (lengthFieldLength_ < 8)
+    {
+        maxLength = std::min(maxLength, (static_cast<size_t>(1) << (8 * lengthFieldLength_)) - 1);
+    }
+    return maxLength;
+}
+
+bool LengthFieldCodec::prependLength(Buffer *buf) const
+{
+    const size_t len = buf->readableBytes();
+    // 长度字段放不下的话对端会按截断的长度分帧，整个流就乱了
+    if (len > maxEncodableLength())
+    {
+        LOG_ERROR("LengthFieldCodec::prependLength frame length:%lu exceeds max:%lu \n", len, maxEncodableLength());
+        return false;
+    }
+    switch (lengthFieldLength_)
+    {
+    case 1:
+        buf->prependInt8(static_cast<int8_t>(len));
+        break;
+    case 2:
+        buf->prependInt16(static_cast<int16_t>(len));
+        break;
+    case 4:
+        buf->prependInt32(static_cast<int32_t>(len));
+        break;
+    default:
+        buf->prependInt64(static_cast<int64_t>(len));
+        break;
+    }
+    return true;
+}
+
+void LengthFieldCodec::send(const TcpConnectionPtr &conn, const void *data, size_t len) const
+{
+    Buffer buf(len);
+    buf.append(data, len);
+    if (prependLength(&buf))
+    {
+        conn->send(&buf);
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Timestamp.h"
+
+#include <functional>
+#include <string>
+
+class Buffer;
+
+/**
+ *  长度字段分包：每一帧都是 [长度字段][消息体]，长度字段是网络字节序，只表示消息体的长度
+ *
+ *  用法：
+ *      LengthFieldCodec codec(std::bind(&EchoServer::onFrame, this, _1, _2, _3, _4));
+ *      server.setMessageCallback(std::bind(&LengthFieldCodec::onMessage, &codec, _1, _2, _3));
+ *
+ *  onMessage 从inputBuffer_中切出完整的帧，直接把帧在Buffer里面的地址和长度交给FrameCallback，
+ *  不会拷贝到std::string，所以data只在回调期间有效，需要保存的话用户自己拷贝
+ */
+class LengthFieldCodec : noncopyable
+{
+public:
+    using FrameCallback = std::function<void (const TcpConnectionPtr&,
+                                            const char* data,
+                                            size_t len,
+                                            Timestamp)>;
+
+    static const size_t kDefaultMaxFrameLength = 64*1024*1024; // 64M
+
+    // lengthFieldLength 只能是1 2 4 8 字节
+    explicit LengthFieldCodec(const FrameCallback &cb,
+                            int lengthFieldLength = 4,
+                            size_t maxFrameLength = kDefaultMaxFrameLength);
+
+    // 设置给TcpServer的MessageCallback
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+
+    // 给data加上长度字段发送出去，超过maxEncodableLength()的不发送
+    void send(const TcpConnectionPtr &conn, const void *data, size_t len) const;
+    void send(const TcpConnectionPtr &conn, const std::string &message) const
+    {
+        send(conn, message.data(), message.size());
+    }
+
+    // 在buf的可读数据前面填上长度字段，buf的prependableBytes()要足够，Buffer默认预留的8个字节就够了
+    // 长度超过maxEncodableLength()时不修改buf，返回false
+    bool prependLength(Buffer *buf) const;
+    // 长度字段能表示并且不超过maxFrameLength的最大消息体长度
+    size_t maxEncodableLength() const;
+
+    int lengthFieldLength() const { return lengthFieldLength_; }
+    size_t maxFrameLength() const { return maxFrameLength_; }
+private:
+    // 读出长度字段，但不从buf中取走
+    size_t peekLength(const Buffer *buf) const;
+
+    FrameCallback frameCallback_;
+    const int lengthFieldLength_;
+    const size_t maxFrameLength_;
+};
@@ -0,0 +1,119 @@
+#include "LogFile.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+LogFile::LogFile(const std::string &basename, off_t rollSize, int rollInterval)
+    : basename_(basename)
+    , rollSize_(rollSize)
+    , rollInterval_(rollInterval > 0 ? rollInterval : 24*60*60)
+    , fp_(nullptr)
+    , writtenBytes_(0)
+    , startOfPeriod_(0)
+    , lastRoll_(0)
+{
+    rollFile();
+}
+
+LogFile::~LogFile()
+{
+    if (fp_)
+    {
+        ::fclose(fp_);
+    }
+}
+
+void LogFile::append(const char *data, size_t len)
+{
+    time_t now = ::time(NULL);
+    if (writtenBytes_ > rollSize_ || now / rollInterval_ * rollInterval_ != startOfPeriod_)
+    {
+        rollFile();
+    }
+    if (fp_ == nullptr)
+    {
+        return;
+    }
+
+    size_t written = 0;
+    while (written < len)
+    {
+        // 只有后台线程写这个文件，不需要stdio内部的锁
+        size_t n = ::fwrite_unlocked(data + written, 1, len - written, fp_);
+        if (n == 0)
+        {
+            int err = ::ferror(fp_);
+            if (err)
+            {
+                ::fprintf(stderr, "LogFile::append() failed %s\n", ::strerror(errno));
+                ::clearerr(fp_);
+            }
+            break;
+        }
+        written += n;
+    }
+    writtenBytes_ += written;
+}
+
+void LogFile::flush()
+{
+    if (fp_)
+    {
+        ::fflush(fp_);
+    }
+}
+
+bool LogFile::rollFile()
+{
+    time_t now = ::time(NULL);
+    if (now <= lastRoll_)
+    {
+        return false;
+    }
+
+    std::string filename = getLogFileName(basename_, now);
+    FILE *fp = ::fopen(filename.c_str(), "ae"); // e: O_CLOEXEC
+    if (fp == nullptr)
+    {
+        ::fprintf(stderr, "LogFile::rollFile() open %s failed %s\n", filename.c_str(), ::strerror(errno));
+        return false;
+    }
+    if (fp_)
+    {
+        ::fclose(fp_);
+    }
+    fp_ = fp;
+    ::setbuffer(fp_, buffer_, sizeof buffer_);
+    writtenBytes_ = 0;
+    lastRoll_ = now;
+    startOfPeriod_ = now / rollInterval_ * rollInterval_;
+    return true;
+}
+
+std::string LogFile::getLogFileName(const std::string &basename, time_t now)
+{
+    std::string filename(basename);
+
+    char timebuf[32] = {0};
+    struct tm tm;
+    ::gmtime_r(&now, &tm);
+    ::strftime(timebuf, sizeof timebuf, ".%Y%m%d-%H%M%S.", &tm);
+    filename += timebuf;
+
+    char hostname[256] = {0};
+    if (::gethostname(hostname, sizeof hostname) == 0)
+    {
+        hostname[sizeof(hostname) - 1] = '\0';
+        filename += hostname;
+    }
+    else
+    {
+        filename += "unknownhost";
+    }
+
+    char pidbuf[32] = {0};
+    snprintf(pidbuf, sizeof pidbuf, ".%d.log", ::getpid());
+    filename += pidbuf;
+    return filename;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <string>
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+
+/**
+ *  按大小和时间滚动的日志文件，只给AsyncLogging的后台线程使用，不是线程安全的
+ *  文件名：basename.20261019-160700.hostname.pid.log
+ *  写满rollSize字节，或者跨过一个rollInterval周期（默认一天，按整点对齐）就换一个新文件
+ */
+class LogFile : noncopyable
+{
+public:
+    LogFile(const std::string &basename, off_t rollSize, int rollInterval = 24*60*60);
+    ~LogFile();
+
+    void append(const char *data, size_t len);
+    void flush();
+    // 换一个新文件，同一秒内不会重复滚动
+    bool rollFile();
+
+    off_t writtenBytes() const { return writtenBytes_; }
+private:
+    static std::string getLogFileName(const std::string &basename, time_t now);
+
+    const std::string basename_;
+    const off_t rollSize_;
+    const int rollInterval_;
+
+    FILE *fp_;
+    off_t writtenBytes_; // 当前文件已经写了多少字节
+    time_t startOfPeriod_; // 当前文件所在周期的开始时间
+    time_t lastRoll_;
+    char buffer_[64*1024]; // stdio的缓冲区
+};
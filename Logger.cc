@@ -2,6 +2,10 @@
 #include "Timestamp.h"
 
 #include <iostream>
+#include <stdarg.h>
+#include <stdio.h>
+
+std::atomic<int> Logger::s_minLevel(DEBUG);
 
 // 获取日志唯一的实例对象
 Logger& Logger::instance()
@@ -10,33 +14,62 @@ Logger& Logger::instance()
     return logger;
 }
 
-// 设置日志级别
-void Logger::setLogLevel(int level)
+void Logger::log(int level, const char *fmt, ...)
 {
-    logLevel_ = level;
+    // 不需要清零，vsnprintf会写结尾的'\0'
+    char buf[1024];
+    va_list args;
+    va_start(args, fmt);
+    int n = ::vsnprintf(buf, sizeof buf, fmt, args);
+    va_end(args);
+    if (n < 0)
+    {
+        n = 0;
+    }
+    write(level, buf, n < static_cast<int>(sizeof buf) ? n : sizeof(buf) - 1);
 }
 
 // 写日志  [级别信息] time : msg
-void Logger::log(std::string msg)
+void Logger::write(int level, const char *msg, size_t len)
 {
-    switch (logLevel_)
+    std::string line;
+    line.reserve(len + 48);
+    switch (level)
     {
     case INFO:
-        std::cout << "[INFO]";
+        line += "[INFO]";
         break;
     case ERROR:
-        std::cout << "[ERROR]";
+        line += "[ERROR]";
         break;
     case FATAL:
-        std::cout << "[FATAL]";
+        line += "[FATAL]";
         break;
     case DEBUG:
-        std::cout << "[DEBUG]";
+        line += "[DEBUG]";
         break;
     default:
         break;
     }
 
     // 打印时间和msg
-    std::cout << Timestamp::now().toString() << " : " << msg << std::endl;
-}
\ No newline at end of file
+    char timebuf[32];
+    line.append(timebuf, Timestamp::now().format(timebuf, sizeof timebuf));
+    line += " : ";
+    line.append(msg, len);
+    line += '\n';
+
+    if (output_)
+    {
+        output_(line.data(), line.size());
+        // 后面马上就exit了，异步日志要先写到文件里
+        if (level == FATAL && flush_)
+        {
+            flush_();
+        }
+    }
+    else
+    {
+        std::cout << line << std::flush;
+    }
+}
@@ -1,75 +1,84 @@
 #pragma once
 
 #include <string>
+#include <functional>
+#include <atomic>
+#include <stdlib.h>
 
 #include "noncopyable.h"
 
+// 定义日志的级别，按严重程度从低到高排列  DEBUG  INFO  ERROR  FATAL
+enum LogLevel
+{
+    DEBUG, // 调试信息
+    INFO,  // 普通信息
+    ERROR, // 错误信息
+    FATAL, // core信息
+};
+
+// 编译期的最低级别，低于它的日志语句整个被编译器删掉，比如-DLOG_COMPILE_LEVEL=2只保留ERROR和FATAL
+// 默认和以前一样：定义了MUDEBUG才编译LOG_DEBUG
+#ifndef LOG_COMPILE_LEVEL
+#ifdef MUDEBUG
+#define LOG_COMPILE_LEVEL 0
+#else
+#define LOG_COMPILE_LEVEL 1
+#endif
+#endif
+
 // 使用格式：LOG_INFO("%s %d",arg1,arg2)
 // 定义宏函数，每一行后面都有'\' ,且后面不能有空格
-#define LOG_INFO(logmsgFormat, ...) \
+// 先判断级别再格式化：第一个条件是编译期常量，被关掉的级别什么代码都不生成；
+// 第二个条件是运行时的最低级别，关掉的日志只有一次原子读和一次比较
+#define LOG_WITH_LEVEL(level, logmsgFormat, ...) \
     do \
     { \
-        Logger &logger = Logger::instance(); \
-        logger.setLogLevel(INFO); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
-    } while(0) 
+        if ((level) >= LOG_COMPILE_LEVEL && Logger::enabled(level)) \
+        { \
+            Logger::instance().log(level, logmsgFormat, ##__VA_ARGS__); \
+        } \
+    } while(0)
 
-#define LOG_ERROR(logmsgFormat, ...) \
-    do \
-    { \
-        Logger &logger = Logger::instance(); \
-        logger.setLogLevel(ERROR); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
-    } while(0) 
+#define LOG_DEBUG(logmsgFormat, ...) LOG_WITH_LEVEL(DEBUG, logmsgFormat, ##__VA_ARGS__)
+#define LOG_INFO(logmsgFormat, ...) LOG_WITH_LEVEL(INFO, logmsgFormat, ##__VA_ARGS__)
+#define LOG_ERROR(logmsgFormat, ...) LOG_WITH_LEVEL(ERROR, logmsgFormat, ##__VA_ARGS__)
 
+// FATAL不受级别限制，写完就退出
 #define LOG_FATAL(logmsgFormat, ...) \
     do \
     { \
-        Logger &logger = Logger::instance(); \
-        logger.setLogLevel(FATAL); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
+        Logger::instance().log(FATAL, logmsgFormat, ##__VA_ARGS__); \
         exit(-1); \
-    } while(0) 
-// 只有编译的时候加这个宏才会开启这个宏函数
-#ifdef MUDEBUG
-#define LOG_DEBUG(logmsgFormat, ...) \
-    do \
-    { \
-        Logger &logger = Logger::instance(); \
-        logger.setLogLevel(DEBUG); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
-    } while(0) 
-#else
-    #define LOG_DEBUG(logmsgFormat, ...)
-#endif
-
-// 定义日志的级别  INFO  ERROR  FATAL  DEBUG 
-enum LogLevel
-{
-    INFO,  // 普通信息
-    ERROR, // 错误信息
-    FATAL, // core信息
-    DEBUG, // 调试信息
-};
+    } while(0)
 
 // 输出一个日志类
 class Logger : noncopyable
 {
 public:
+    // 默认写到标准输出，可以换成AsyncLogging::append
+    using OutputFunc = std::function<void(const char *msg, size_t len)>;
+    using FlushFunc = std::function<void()>;
+
     // 获取日志唯一的实例对象
     static Logger& instance();
-    // 设置日志级别
-    void setLogLevel(int level);
-    // 写日志
-    void log(std::string msg);
+
+    // 运行时的最低级别，线程安全，默认DEBUG（也就是只受编译期级别的限制）
+    static void setMinLevel(int level) { s_minLevel.store(level, std::memory_order_relaxed); }
+    static int minLevel() { return s_minLevel.load(std::memory_order_relaxed); }
+    static bool enabled(int level) { return level >= minLevel(); }
+
+    // 写日志，每条日志自己带着级别，不再修改共享的状态
+    void log(int level, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+    // 写一条已经格式化好的日志
+    void write(int level, const char *msg, size_t len);
+
+    // 在程序启动、还没有其他线程写日志的时候设置
+    void setOutput(OutputFunc out) { output_ = std::move(out); }
+    // FATAL日志写完以后、退出之前调用
+    void setFlush(FlushFunc flush) { flush_ = std::move(flush); }
 private:
-    int logLevel_;
-};
\ No newline at end of file
+    static std::atomic<int> s_minLevel;
+
+    OutputFunc output_;
+    FlushFunc flush_;
+};
@@ -0,0 +1,65 @@
+#include "MemoryBudget.h"
+#include "EventLoop.h"
+
+MemoryBudget& MemoryBudget::instance()
+{
+    static MemoryBudget budget;
+    return budget;
+}
+
+MemoryBudget::MemoryBudget()
+    : usage_(0)
+    , limit_(0)
+    , policies_(0)
+    , hasWaiters_(false)
+{
+}
+
+void MemoryBudget::setLimit(size_t limit, int policies)
+{
+    policies_.store(policies, std::memory_order_relaxed);
+    limit_.store(limit, std::memory_order_relaxed);
+    if (hasWaiters_)
+    {
+        wakeWaiters();
+    }
+}
+
+void MemoryBudget::add(int64_t delta)
+{
+    usage_.fetch_add(delta, std::memory_order_relaxed);
+    if (delta < 0 && hasWaiters_)
+    {
+        wakeWaiters();
+    }
+}
+
+void MemoryBudget::waitForMemory(EventLoop *loop, Functor cb)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        waiters_.emplace_back(loop, std::move(cb));
+        hasWaiters_ = true;
+    }
+    // 登记之前用量可能已经降下来了
+    wakeWaiters();
+}
+
+void MemoryBudget::wakeWaiters()
+{
+    // 降到limit的3/4以下，恢复所有因为内存暂停读的连接
+    const size_t limit = this->limit();
+    if (limit == 0 || usage() <= static_cast<int64_t>(limit - limit / 4))
+    {
+        std::vector<std::pair<EventLoop*, Functor>> waiters;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            waiters.swap(waiters_);
+            hasWaiters_ = false;
+        }
+        for (auto &item : waiters)
+        {
+            item.first->queueInLoop(std::move(item.second));
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <stdint.h>
+#include <stddef.h>
+
+class EventLoop;
+
+/**
+ *  整个进程所有连接的输入/输出缓冲区的内存预算
+ *
+ *  统计：TcpConnection把自己缓冲区大小的变化记到所在EventLoop的计数器上（只在loop线程中修改，不用原子操作），
+ *  每一轮循环结束的时候EventLoop再把这一轮的变化量一次性加到这里的全局计数器上，所以usage()是一个很便宜的近似值
+ *
+ *  超过预算时的策略（可以组合）：
+ *  - kStopReading          连接读完这一次就暂停读，用量降到limit的3/4以下时恢复
+ *  - kRejectConnections    TcpServer直接关闭新连接
+ *  - kCloseLargest         关闭所在loop中缓冲区占用最大的连接
+ */
+class MemoryBudget : noncopyable
+{
+public:
+    using Functor = std::function<void()>;
+
+    enum Policy
+    {
+        kStopReading = 1,
+        kRejectConnections = 2,
+        kCloseLargest = 4,
+    };
+
+    static MemoryBudget& instance();
+
+    // limit为0表示不限制，线程安全，运行中也可以调整，调大以后因为内存暂停的连接会恢复读
+    void setLimit(size_t limit, int policies);
+    size_t limit() const { return limit_.load(std::memory_order_relaxed); }
+
+    // 当前所有连接缓冲区的字节数，可以作为监控指标
+    int64_t usage() const { return usage_.load(std::memory_order_relaxed); }
+
+    // 是否超过预算并且开启了policy，pending是调用者所在loop还没有加上来的变化量
+    bool exceeded(Policy policy, int64_t pending = 0) const
+    {
+        const size_t limit = this->limit();
+        return (policies_.load(std::memory_order_relaxed) & policy) && limit > 0
+            && usage() + pending > static_cast<int64_t>(limit);
+    }
+
+    // EventLoop每一轮循环结束时调用
+    void add(int64_t delta);
+
+    // 因为kStopReading暂停的连接登记在这里，用量降下来以后在loop中执行cb恢复读
+    void waitForMemory(EventLoop *loop, Functor cb);
+private:
+    MemoryBudget();
+
+    void wakeWaiters();
+
+    std::atomic<int64_t> usage_;
+    // 每次连接读完数据都要检查，只用relaxed读，setLimit时两个值不是一起更新的，短暂不一致也没关系
+    std::atomic<size_t> limit_;
+    std::atomic_int policies_;
+
+    std::atomic_bool hasWaiters_;
+    std::mutex mutex_; // 保护waiters_
+    std::vector<std::pair<EventLoop*, Functor>> waiters_;
+};
@@ -0,0 +1,339 @@
+#include "OutputQueue.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <algorithm>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <string.h>
+
+// 老的头文件里面可能没有这些定义
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+OutputQueue::OutputQueue()
+    : bytes_(0)
+    , fileBytes_(0)
+    , zeroCopy_(false)
+    , zeroCopyThreshold_(kDefaultZeroCopyThreshold)
+    , nextZeroCopySeq_(0)
+    , zeroCopyCopied_(0)
+{
+}
+
+OutputQueue::~OutputQueue()
+{
+    while (!chunks_.empty())
+    {
+        popFront();
+    }
+}
+
+void OutputQueue::popFront()
+{
+    Chunk &chunk = chunks_.front();
+    if (chunk.kind == Chunk::kFile)
+    {
+        ::close(chunk.fd);
+    }
+    else if (chunk.zeroCopied)
+    {
+        // 内核可能还在引用这块内存，等reapZeroCopy收到完成通知再释放
+        pinned_.push_back(std::move(chunk));
+    }
+    chunks_.pop_front();
+}
+
+// 队尾是Buffer就接着往里面拷贝，否则新开一个Buffer块
+void OutputQueue::append(const char *data, size_t len)
+{
+    if (chunks_.empty() || chunks_.back().kind != Chunk::kBuffer || chunks_.back().zeroCopied)
+    {
+        chunks_.emplace_back();
+    }
+    chunks_.back().buffer.append(data, len);
+    bytes_ += len;
+}
+
+void OutputQueue::append(Buffer &&buf)
+{
+    const size_t len = buf.readableBytes();
+    if (len < kMinChunkSize)
+    {
+        append(buf.peek(), len);
+        buf.retrieveAll();
+        return;
+    }
+    chunks_.emplace_back(std::move(buf));
+    bytes_ += len;
+}
+
+void OutputQueue::append(std::string &&str)
+{
+    const size_t len = str.size();
+    if (len < kMinChunkSize)
+    {
+        append(str.data(), len);
+        return;
+    }
+    chunks_.emplace_back(std::move(str));
+    bytes_ += len;
+}
+
+// 引用计数保证在发送完（zero copy的话是内核通知完成）之前数据一直有效
+void OutputQueue::append(const PayloadPtr &payload)
+{
+    const size_t len = payload->size();
+    if (len < kMinChunkSize)
+    {
+        append(payload->data(), len);
+        return;
+    }
+    chunks_.emplace_back(payload);
+    bytes_ += len;
+}
+
+void OutputQueue::appendFile(int fd, off_t offset, size_t len)
+{
+    if (len == 0)
+    {
+        ::close(fd);
+        return;
+    }
+    chunks_.emplace_back(fd, offset, len);
+    bytes_ += len;
+    fileBytes_ += len;
+}
+
+void OutputQueue::appendPipe(const PipePtr &pipe, size_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+    if (!chunks_.empty() && chunks_.back().kind == Chunk::kPipe && chunks_.back().pipe == pipe)
+    {
+        chunks_.back().fileRemaining += len;
+    }
+    else
+    {
+        chunks_.emplace_back(pipe, len);
+    }
+    bytes_ += len;
+    fileBytes_ += len;
+}
+
+void OutputQueue::retrieve(size_t len)
+{
+    while (len > 0 && !chunks_.empty())
+    {
+        Chunk &chunk = chunks_.front();
+        const size_t n = chunk.size();
+        if (len < n)
+        {
+            chunk.retrieve(len);
+            bytes_ -= len;
+            if (!chunk.inMemory()) fileBytes_ -= len;
+            break;
+        }
+
+        len -= n;
+        bytes_ -= n;
+        if (!chunk.inMemory()) fileBytes_ -= n;
+        // 最后一个Buffer块留着不释放，下次append可以接着用它的内存
+        if (chunks_.size() == 1 && chunk.kind == Chunk::kBuffer && !chunk.zeroCopied)
+        {
+            chunk.buffer.retrieveAll();
+            break;
+        }
+        popFront();
+    }
+}
+
+void OutputQueue::retrieveAll()
+{
+    retrieve(bytes_);
+}
+
+// 把队列前面最多kMaxIovecs块内存数据用一次writev发出去，队首是文件块的话就用sendfile，管道块用splice
+ssize_t OutputQueue::writeFd(int fd, int *saveErrno, size_t maxBytes)
+{
+    // 队首可能是留着复用的空Buffer块，后面还有数据的话就不要它了
+    while (chunks_.size() > 1 && chunks_.front().size() == 0)
+    {
+        popFront();
+    }
+    if (!chunks_.empty() && chunks_.front().kind == Chunk::kPipe)
+    {
+        return writePipeFd(fd, saveErrno, maxBytes);
+    }
+    if (!chunks_.empty() && !chunks_.front().inMemory())
+    {
+        return writeFileFd(fd, saveErrno, maxBytes);
+    }
+    if (zeroCopy_ && !chunks_.empty() && chunks_.front().size() >= zeroCopyThreshold_)
+    {
+        ssize_t n = writeZeroCopyFd(fd, saveErrno, maxBytes);
+        // ENOBUFS表示超过了能pin住的内存上限，这一次退回普通的拷贝发送
+        if (n >= 0 || *saveErrno != ENOBUFS)
+        {
+            return n;
+        }
+    }
+
+    struct iovec vec[kMaxIovecs];
+    int iovcnt = 0;
+    for (const Chunk &chunk : chunks_)
+    {
+        // 遇到文件块就停下，等前面的内存数据发完再sendfile
+        if (iovcnt == kMaxIovecs || !chunk.inMemory() || maxBytes == 0)
+        {
+            break;
+        }
+        if (chunk.size() == 0)
+        {
+            continue;
+        }
+        vec[iovcnt].iov_base = const_cast<char*>(chunk.data());
+        vec[iovcnt].iov_len = std::min(chunk.size(), maxBytes);
+        maxBytes -= vec[iovcnt].iov_len;
+        ++iovcnt;
+    }
+
+    ssize_t n = ::writev(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *saveErrno = errno;
+    }
+    return n;
+}
+
+// sendfile直接在内核中把文件数据拷贝到socket，不经过用户空间
+ssize_t OutputQueue::writeFileFd(int fd, int *saveErrno, size_t maxBytes)
+{
+    Chunk &chunk = chunks_.front();
+    off_t offset = chunk.fileOffset;
+    ssize_t n = ::sendfile(fd, chunk.fd, &offset, std::min(chunk.fileRemaining, maxBytes));
+    if (n < 0)
+    {
+        *saveErrno = errno;
+    }
+    else if (n == 0 && maxBytes > 0)
+    {
+        // 文件比调用者说的短（比如被截断了），剩下的字节发不出去了，直接丢掉这一块
+        LOG_ERROR("OutputQueue::writeFileFd file fd=%d truncated, drop %lu bytes \n", chunk.fd, chunk.fileRemaining);
+        bytes_ -= chunk.fileRemaining;
+        fileBytes_ -= chunk.fileRemaining;
+        popFront();
+    }
+    return n;
+}
+
+// splice把管道中的数据直接移动到socket，不经过用户空间
+ssize_t OutputQueue::writePipeFd(int fd, int *saveErrno, size_t maxBytes)
+{
+    Chunk &chunk = chunks_.front();
+    ssize_t n = ::splice(chunk.pipe->readFd(), nullptr, fd, nullptr,
+                    std::min(chunk.fileRemaining, maxBytes), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (n < 0)
+    {
+        *saveErrno = errno;
+    }
+    else if (n == 0 && maxBytes > 0)
+    {
+        // 管道中的数据比记录的少，不应该发生，丢掉这一块，免得一直写不出去
+        LOG_ERROR("OutputQueue::writePipeFd pipe fd=%d is empty, drop %lu bytes \n", chunk.pipe->readFd(), chunk.fileRemaining);
+        bytes_ -= chunk.fileRemaining;
+        fileBytes_ -= chunk.fileRemaining;
+        popFront();
+    }
+    return n;
+}
+
+// 队首这一块用MSG_ZEROCOPY单独发送
+ssize_t OutputQueue::writeZeroCopyFd(int fd, int *saveErrno, size_t maxBytes)
+{
+    Chunk &chunk = chunks_.front();
+    struct iovec vec;
+    vec.iov_base = const_cast<char*>(chunk.data());
+    vec.iov_len = std::min(chunk.size(), maxBytes);
+
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof msg);
+    msg.msg_iov = &vec;
+    msg.msg_iovlen = 1;
+
+    ssize_t n = ::sendmsg(fd, &msg, MSG_ZEROCOPY);
+    if (n < 0)
+    {
+        *saveErrno = errno;
+    }
+    else if (n > 0)
+    {
+        // 发送成功才会占用一个通知序号
+        chunk.zeroCopied = true;
+        chunk.zeroCopySeq = nextZeroCopySeq_++;
+    }
+    return n;
+}
+
+// 每个通知表示序号[lo, hi]的发送都完成了，pinned_是按序号排好的，从头释放到hi为止
+int OutputQueue::reapZeroCopy(int fd)
+{
+    int count = 0;
+    while (true)
+    {
+        char control[128];
+        struct msghdr msg;
+        ::memset(&msg, 0, sizeof msg);
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof control;
+
+        if (::recvmsg(fd, &msg, MSG_ERRQUEUE) < 0)
+        {
+            // EAGAIN 错误队列已经读空了
+            break;
+        }
+
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+                || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+            {
+                continue;
+            }
+            struct sock_extended_err serr;
+            ::memcpy(&serr, CMSG_DATA(cm), sizeof serr);
+            if (serr.ee_errno != 0 || serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+            {
+                continue;
+            }
+
+            ++count;
+            const uint32_t hi = serr.ee_data;
+            const uint32_t lo = serr.ee_info;
+            if (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+            {
+                zeroCopyCopied_ += hi - lo + 1;
+            }
+            // 序号是32位会回绕的，用差值判断先后
+            while (!pinned_.empty()
+                && static_cast<int32_t>(pinned_.front().zeroCopySeq - hi) <= 0)
+            {
+                pinned_.pop_front();
+            }
+        }
+    }
+    return count;
+}
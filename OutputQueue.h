@@ -0,0 +1,153 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Buffer.h"
+#include "Callbacks.h"
+#include "Pipe.h"
+
+#include <deque>
+#include <string>
+#include <stdint.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ *  TcpConnection的发送缓冲区
+ *
+ *  和Buffer不同，这里是一个按顺序排列的数据块队列：
+ *  - append(data, len)  拷贝到队尾的Buffer中，连续的小数据会合并在一起
+ *  - append(Buffer&&) / append(std::string&&)  整块放进队列，不拷贝
+ *  - append(PayloadPtr)  只增加引用计数，多个连接共享同一份数据
+ *  - appendFile(fd, offset, len)  文件的一段，用sendfile发送，数据不经过用户空间
+ *  - appendPipe(pipe, len)  已经在内核管道中的数据（relay从另一个socket splice进来的），用splice发送
+ *  writeFd用writev一次把队列前面的若干块发出去，所以 头部+消息体 这种数据不需要先拼接成一个string，
+ *  遇到文件块就单独用sendfile发送，管道块就单独用splice发送
+ *
+ *  开启zero copy以后（setZeroCopy），队首大于阈值的内存块用 sendmsg(MSG_ZEROCOPY) 发送，内核直接引用这块内存，
+ *  所以这一块发送完以后不能马上释放，先挂在pinned队列上，等内核在socket的错误队列中通知发送完成（reapZeroCopy）才释放
+ */
+class OutputQueue : noncopyable
+{
+public:
+    // 小于这个大小的整块数据还是直接拷贝到队尾，避免队列里面全是碎块
+    static const size_t kMinChunkSize = 512;
+    // 一次writev最多发送多少块
+    static const int kMaxIovecs = 64;
+    // 默认大于这个大小的块才用MSG_ZEROCOPY，小块的话pin内存和回收通知的开销比拷贝还大
+    static const size_t kDefaultZeroCopyThreshold = 64*1024;
+
+    OutputQueue();
+    ~OutputQueue();
+
+    // 待发送的数据总长度
+    size_t readableBytes() const { return bytes_; }
+    // 其中占用内存的部分，不包括文件块和管道块
+    size_t memoryBytes() const { return bytes_ - fileBytes_; }
+    size_t numChunks() const { return chunks_.size(); }
+
+    void append(const char *data, size_t len);
+    void append(Buffer &&buf);
+    void append(std::string &&str);
+    void append(const PayloadPtr &payload);
+    // fd的所有权交给OutputQueue，发送完或者丢弃的时候close
+    void appendFile(int fd, off_t offset, size_t len);
+    // pipe中接下来的len个字节，和队尾同一个管道的块合并
+    void appendPipe(const PipePtr &pipe, size_t len);
+
+    // 发送了len个字节之后，把它们从队列中去掉
+    void retrieve(size_t len);
+    void retrieveAll();
+
+    // 通过fd发送数据，一次最多发送maxBytes个字节
+    ssize_t writeFd(int fd, int *saveErrno, size_t maxBytes = SIZE_MAX);
+
+    // fd要先开启SO_ZEROCOPY
+    void setZeroCopy(bool on, size_t threshold = kDefaultZeroCopyThreshold)
+    {
+        zeroCopy_ = on;
+        zeroCopyThreshold_ = threshold;
+    }
+    bool zeroCopy() const { return zeroCopy_; }
+    // 还在等内核完成通知的块数
+    size_t pinnedChunks() const { return pinned_.size(); }
+    // 内核实际上退化成拷贝发送的次数，一直增长说明这个连接（比如loopback）用zero copy没有意义
+    uint64_t zeroCopyCopied() const { return zeroCopyCopied_; }
+    // 从fd的错误队列中读出所有zero copy完成通知，释放对应的块，返回读到的通知个数
+    int reapZeroCopy(int fd);
+private:
+    // 弹出队首的块，文件块要close掉fd，zero copy发送过的块挂到pinned_上
+    void popFront();
+    ssize_t writeFileFd(int fd, int *saveErrno, size_t maxBytes);
+    ssize_t writePipeFd(int fd, int *saveErrno, size_t maxBytes);
+    ssize_t writeZeroCopyFd(int fd, int *saveErrno, size_t maxBytes);
+
+    struct Chunk
+    {
+        enum Kind
+        {
+            kBuffer, // 数据在buffer中
+            kString, // 数据在用户移动进来的str中，offset之前的已经发送了
+            kFile,   // 文件fd从fileOffset开始的fileRemaining个字节
+            kShared, // 数据在共享的payload中，offset之前的已经发送了
+            kPipe,   // 数据在内核管道pipe中，还有fileRemaining个字节
+        };
+
+        Chunk() {}
+        explicit Chunk(Buffer &&buf)
+            : buffer(std::move(buf)) {}
+        explicit Chunk(std::string &&s)
+            : kind(kString), buffer(0), str(std::move(s)) {}
+        explicit Chunk(const PayloadPtr &p)
+            : kind(kShared), buffer(0), payload(p) {}
+        Chunk(int fileFd, off_t off, size_t len)
+            : kind(kFile), buffer(0), fd(fileFd), fileOffset(off), fileRemaining(len) {}
+        Chunk(const PipePtr &p, size_t len)
+            : kind(kPipe), buffer(0), pipe(p), fileRemaining(len) {}
+
+        // 文件块和管道块的数据不在用户空间的内存中，data()返回nullptr
+        bool inMemory() const { return kind != kFile && kind != kPipe; }
+        const char* data() const
+        {
+            if (kind == kBuffer) return buffer.peek();
+            if (kind == kString) return str.data() + offset;
+            if (kind == kShared) return payload->data() + offset;
+            return nullptr;
+        }
+        size_t size() const
+        {
+            if (kind == kBuffer) return buffer.readableBytes();
+            if (kind == kString) return str.size() - offset;
+            if (kind == kShared) return payload->size() - offset;
+            return fileRemaining;
+        }
+        void retrieve(size_t len)
+        {
+            if (kind == kBuffer) buffer.retrieve(len);
+            else if (kind == kString || kind == kShared) offset += len;
+            else { fileOffset += len; fileRemaining -= len; }
+        }
+
+        Kind kind = kBuffer;
+        Buffer buffer;
+        std::string str;
+        PayloadPtr payload;
+        PipePtr pipe;
+        size_t offset = 0;
+        int fd = -1;
+        off_t fileOffset = 0;
+        size_t fileRemaining = 0;
+        // 用MSG_ZEROCOPY发送过，内存被内核引用，不能再往里面append，也不能马上释放
+        bool zeroCopied = false;
+        uint32_t zeroCopySeq = 0; // 最后一次发送对应的通知序号
+    };
+
+    std::deque<Chunk> chunks_;
+    size_t bytes_;
+    size_t fileBytes_; // 文件块和管道块的字节数
+
+    bool zeroCopy_;
+    size_t zeroCopyThreshold_;
+    uint32_t nextZeroCopySeq_; // 内核给每次成功的MSG_ZEROCOPY发送从0开始编号
+    uint64_t zeroCopyCopied_;
+    std::deque<Chunk> pinned_; // 按zeroCopySeq递增排列
+};
@@ -0,0 +1,46 @@
+#include "Pipe.h"
+#include "Logger.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+
+Pipe::Pipe()
+{
+    if (::pipe2(fds_, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+        LOG_ERROR("Pipe::Pipe pipe2 error:%d \n", errno);
+        fds_[0] = fds_[1] = -1;
+    }
+}
+
+Pipe::~Pipe()
+{
+    if (valid())
+    {
+        ::close(fds_[0]);
+        ::close(fds_[1]);
+    }
+}
+
+bool Pipe::setCapacity(size_t bytes)
+{
+    return ::fcntl(fds_[1], F_SETPIPE_SZ, static_cast<int>(bytes)) >= 0;
+}
+
+size_t Pipe::capacity() const
+{
+    int n = ::fcntl(fds_[1], F_GETPIPE_SZ);
+    return n > 0 ? static_cast<size_t>(n) : 0;
+}
+
+size_t Pipe::readableBytes() const
+{
+    int n = 0;
+    if (::ioctl(fds_[0], FIONREAD, &n) < 0)
+    {
+        return 0;
+    }
+    return static_cast<size_t>(n);
+}
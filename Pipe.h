@@ -0,0 +1,33 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <memory>
+#include <stddef.h>
+
+/**
+ *  封装一对非阻塞的管道fd，给splice用
+ *  TcpConnection::relayTo把socket的数据splice进管道，再从管道splice到peer的socket，数据不进入用户空间
+ *  管道中还没发出去的数据挂在peer的OutputQueue上，所以用shared_ptr，两边都不用了才close
+ */
+class Pipe : noncopyable
+{
+public:
+    Pipe();
+    ~Pipe();
+
+    // pipe2失败（比如fd用完了）返回false
+    bool valid() const { return fds_[0] >= 0; }
+    int readFd() const { return fds_[0]; }
+    int writeFd() const { return fds_[1]; }
+
+    // 调整管道的容量，超过/proc/sys/fs/pipe-max-size的话内核会拒绝，保持原来的大小
+    bool setCapacity(size_t bytes);
+    size_t capacity() const;
+    // 管道中还没有被读走的字节数
+    size_t readableBytes() const;
+private:
+    int fds_[2];
+};
+
+using PipePtr = std::shared_ptr<Pipe>;
@@ -0,0 +1,412 @@
+#include "RespCodec.h"
+#include "Buffer.h"
+
+#include <string.h>
+
+namespace
+{
+
+bool isTypePrefix(char c)
+{
+    return ::strchr("+-:$*_#,(!=%~|>", c) != nullptr && c != '\0';
+}
+
+// 严格的十进制整数，不允许空白和前导'+'
+bool parseInt64(const char *p, const char *end, int64_t *value)
+{
+    bool negative = false;
+    if (p < end && *p == '-')
+    {
+        negative = true;
+        ++p;
+    }
+    if (p == end || end - p > 19)
+    {
+        return false;
+    }
+    uint64_t v = 0;
+    for (; p < end; ++p)
+    {
+        if (*p < '0' || *p > '9')
+        {
+            return false;
+        }
+        v = v * 10 + static_cast<uint64_t>(*p - '0');
+    }
+    if (v > static_cast<uint64_t>(INT64_MAX) + (negative ? 1 : 0))
+    {
+        return false;
+    }
+    *value = negative ? static_cast<int64_t>(0 - v) : static_cast<int64_t>(v);
+    return true;
+}
+
+// 返回写了多少个字节，buf至少21字节
+size_t formatInt64(char *buf, int64_t value)
+{
+    char tmp[24];
+    char *p = tmp + sizeof tmp;
+    uint64_t v = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    do
+    {
+        *--p = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    if (value < 0)
+    {
+        *--p = '-';
+    }
+    size_t len = tmp + sizeof tmp - p;
+    ::memcpy(buf, p, len);
+    return len;
+}
+
+} // namespace
+
+const size_t RespParser::kMaxLineLength;
+const int64_t RespParser::kMaxBulkLength;
+const int64_t RespParser::kMaxAggregateLength;
+
+RespParser::RespParser()
+    : pos_(0)
+    , needBytes_(0)
+    , todo_(1)
+    , error_(nullptr)
+{
+}
+
+void RespParser::reset()
+{
+    pos_ = 0;
+    needBytes_ = 0;
+    todo_ = 1;
+    error_ = nullptr;
+    values_.clear();
+    spans_.clear();
+}
+
+RespParser::Result RespParser::parse(const Buffer *buf)
+{
+    if (error_ != nullptr)
+    {
+        return kError;
+    }
+    const size_t readable = buf->readableBytes();
+    if (readable < needBytes_ || readable == 0)
+    {
+        return kNeedMore;
+    }
+    const char *base = buf->peek();
+    if (pos_ == 0 && !isTypePrefix(base[0]))
+    {
+        return parseInline(buf);
+    }
+
+    while (todo_ > 0)
+    {
+        if (pos_ >= readable)
+        {
+            needBytes_ = pos_ + 1;
+            return kNeedMore;
+        }
+        const char *line = base + pos_;
+        const char *eol = buf->findEOL(line);
+        if (eol == nullptr)
+        {
+            if (readable - pos_ > kMaxLineLength)
+            {
+                return fail("line too long");
+            }
+            needBytes_ = readable + 1;
+            return kNeedMore;
+        }
+        if (eol - line < 2 || eol[-1] != '\r')
+        {
+            return fail("expected CRLF");
+        }
+
+        const char *content = line + 1;
+        const char *contentEnd = eol - 1;
+        size_t next = eol + 1 - base;
+        RespValue value;
+        value.type = line[0];
+        value.integer = 0;
+        std::pair<size_t, size_t> span(0, 0);
+
+        switch (value.type)
+        {
+        case RespValue::kSimpleString:
+        case RespValue::kError:
+        case RespValue::kDouble:
+        case RespValue::kBigNumber:
+            span = std::make_pair(static_cast<size_t>(content - base), static_cast<size_t>(contentEnd - content));
+            value.integer = contentEnd - content;
+            break;
+
+        case RespValue::kInteger:
+            if (!parseInt64(content, contentEnd, &value.integer))
+            {
+                return fail("invalid integer");
+            }
+            break;
+
+        case RespValue::kBoolean:
+            if (contentEnd - content != 1 || (*content != 't' && *content != 'f'))
+            {
+                return fail("invalid boolean");
+            }
+            value.integer = *content == 't';
+            break;
+
+        case RespValue::kNull:
+            if (content != contentEnd)
+            {
+                return fail("invalid null");
+            }
+            break;
+
+        case RespValue::kBulkString:
+        case RespValue::kBulkError:
+        case RespValue::kVerbatimString:
+        {
+            int64_t len = 0;
+            if (!parseInt64(content, contentEnd, &len))
+            {
+                return fail("invalid bulk length");
+            }
+            value.integer = len;
+            if (len == -1 && value.type == RespValue::kBulkString)
+            {
+                break;
+            }
+            if (len < 0 || len > kMaxBulkLength)
+            {
+                return fail("invalid bulk length");
+            }
+            // 数据没到齐之前不再解析
+            const size_t end = next + static_cast<size_t>(len) + 2;
+            if (readable < end)
+            {
+                needBytes_ = end;
+                return kNeedMore;
+            }
+            if (base[end - 2] != '\r' || base[end - 1] != '\n')
+            {
+                return fail("expected CRLF after bulk data");
+            }
+            span = std::make_pair(next, static_cast<size_t>(len));
+            if (value.type == RespValue::kVerbatimString)
+            {
+                if (len < 4 || base[next + 3] != ':')
+                {
+                    return fail("invalid verbatim string");
+                }
+                span.first += 4;
+                span.second -= 4;
+            }
+            next = end;
+            break;
+        }
+
+        case RespValue::kArray:
+        case RespValue::kSet:
+        case RespValue::kPush:
+        case RespValue::kMap:
+        case RespValue::kAttribute:
+        {
+            int64_t count = 0;
+            if (!parseInt64(content, contentEnd, &count))
+            {
+                return fail("invalid aggregate length");
+            }
+            value.integer = count;
+            if (count == -1 && value.type == RespValue::kArray)
+            {
+                break;
+            }
+            if (count < 0 || count > kMaxAggregateLength)
+            {
+                return fail("invalid aggregate length");
+            }
+            const bool pairs = value.type == RespValue::kMap || value.type == RespValue::kAttribute;
+            todo_ += pairs ? 2 * count : count;
+            // 属性不算一个值，后面还跟着它修饰的那个值
+            if (value.type == RespValue::kAttribute)
+            {
+                ++todo_;
+            }
+            break;
+        }
+
+        default:
+            return fail("unknown type prefix");
+        }
+
+        values_.push_back(value);
+        spans_.push_back(span);
+        pos_ = next;
+        --todo_;
+    }
+
+    for (size_t i = 0; i < values_.size(); ++i)
+    {
+        values_[i].str = StringPiece(base + spans_[i].first, spans_[i].second);
+    }
+    needBytes_ = 0;
+    return kComplete;
+}
+
+// 内联命令：一行按空格和制表符分割，不支持引号
+RespParser::Result RespParser::parseInline(const Buffer *buf)
+{
+    const char *base = buf->peek();
+    const char *eol = buf->findEOL();
+    if (eol == nullptr)
+    {
+        if (buf->readableBytes() > kMaxLineLength)
+        {
+            return fail("inline command too long");
+        }
+        needBytes_ = buf->readableBytes() + 1;
+        return kNeedMore;
+    }
+    const char *end = (eol > base && eol[-1] == '\r') ? eol - 1 : eol;
+
+    RespValue array;
+    array.type = RespValue::kArray;
+    array.integer = 0;
+    values_.push_back(array);
+    spans_.push_back(std::make_pair(0, 0));
+    const char *p = base;
+    while (p < end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t'))
+        {
+            ++p;
+        }
+        const char *start = p;
+        while (p < end && *p != ' ' && *p != '\t')
+        {
+            ++p;
+        }
+        if (p > start)
+        {
+            RespValue arg;
+            arg.type = RespValue::kBulkString;
+            arg.integer = p - start;
+            arg.str = StringPiece(start, p - start);
+            values_.push_back(arg);
+            ++values_[0].integer;
+        }
+    }
+    pos_ = eol + 1 - base;
+    todo_ = 0;
+    needBytes_ = 0;
+    return kComplete;
+}
+
+bool RespParser::command(std::vector<StringPiece> *args) const
+{
+    args->clear();
+    if (values_.empty() || values_[0].type != RespValue::kArray || values_[0].integer < 0
+        || static_cast<size_t>(values_[0].integer) + 1 != values_.size())
+    {
+        return false;
+    }
+    for (size_t i = 1; i < values_.size(); ++i)
+    {
+        const RespValue &value = values_[i];
+        if (value.type != RespValue::kBulkString && value.type != RespValue::kSimpleString)
+        {
+            return false;
+        }
+        args->push_back(value.str);
+    }
+    return true;
+}
+
+void RespWriter::appendHeader(Buffer *buf, char type, int64_t value)
+{
+    char header[32];
+    header[0] = type;
+    size_t len = 1 + formatInt64(header + 1, value);
+    header[len++] = '\r';
+    header[len++] = '\n';
+    buf->append(header, len);
+}
+
+void RespWriter::appendSimpleString(Buffer *buf, const StringPiece &str)
+{
+    buf->append("+", 1);
+    buf->append(str.data(), str.size());
+    buf->append("\r\n", 2);
+}
+
+void RespWriter::appendError(Buffer *buf, const StringPiece &message)
+{
+    buf->append("-", 1);
+    buf->append(message.data(), message.size());
+    buf->append("\r\n", 2);
+}
+
+void RespWriter::appendInteger(Buffer *buf, int64_t value)
+{
+    appendHeader(buf, RespValue::kInteger, value);
+}
+
+void RespWriter::appendBulkString(Buffer *buf, const StringPiece &str)
+{
+    appendHeader(buf, RespValue::kBulkString, static_cast<int64_t>(str.size()));
+    buf->append(str.data(), str.size());
+    buf->append("\r\n", 2);
+}
+
+void RespWriter::appendArrayHeader(Buffer *buf, int64_t count)
+{
+    appendHeader(buf, RespValue::kArray, count);
+}
+
+void RespWriter::appendNull(Buffer *buf, bool resp3)
+{
+    if (resp3)
+    {
+        buf->append("_\r\n", 3);
+    }
+    else
+    {
+        buf->append("$-1\r\n", 5);
+    }
+}
+
+void RespWriter::appendBoolean(Buffer *buf, bool value, bool resp3)
+{
+    if (resp3)
+    {
+        buf->append(value ? "#t\r\n" : "#f\r\n", 4);
+    }
+    else
+    {
+        buf->append(value ? ":1\r\n" : ":0\r\n", 4);
+    }
+}
+
+void RespWriter::appendMapHeader(Buffer *buf, int64_t count, bool resp3)
+{
+    if (resp3)
+    {
+        appendHeader(buf, RespValue::kMap, count);
+    }
+    else
+    {
+        appendHeader(buf, RespValue::kArray, 2 * count);
+    }
+}
+
+void RespWriter::appendCommand(Buffer *buf, const std::vector<StringPiece> &args)
+{
+    appendArrayHeader(buf, static_cast<int64_t>(args.size()));
+    for (const StringPiece &arg : args)
+    {
+        appendBulkString(buf, arg);
+    }
+}
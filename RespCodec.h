@@ -0,0 +1,131 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "StringPiece.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <utility>
+
+class Buffer;
+
+// RESP2/RESP3的一个值，类型就是协议中的前缀字符
+struct RespValue
+{
+    enum Type
+    {
+        kSimpleString = '+',
+        kError = '-',
+        kInteger = ':',
+        kBulkString = '$',
+        kArray = '*',
+        // 下面是RESP3新增的
+        kNull = '_',
+        kBoolean = '#',
+        kDouble = ',',
+        kBigNumber = '(',
+        kBulkError = '!',
+        kVerbatimString = '=',  // str已经去掉了"txt:"这样的格式前缀
+        kMap = '%',
+        kSet = '~',
+        kAttribute = '|',       // 后面紧跟着它所修饰的值
+        kPush = '>',
+    };
+
+    char type;
+    // 字符串类型的内容，数字类型的原始文本（kDouble kBigNumber）
+    StringPiece str;
+    // kInteger kBoolean的值；字符串类型的长度；聚合类型的元素个数（kMap kAttribute是键值对的个数）
+    // RESP2的null（$-1 *-1）是-1
+    int64_t integer;
+
+    bool isNull() const { return type == kNull || ((type == kBulkString || type == kArray) && integer < 0); }
+    bool isAggregate() const
+    { return type == kArray || type == kMap || type == kSet || type == kAttribute || type == kPush; }
+};
+
+/**
+ *  RESP2/RESP3解析器，每个连接一个，直接在输入Buffer上解析，不拷贝
+ *
+ *  一个完整的消息（可以是任意嵌套的聚合类型）按先序展开成一个RespValue数组，values()[0]是最外层的值，
+ *  聚合类型后面紧跟着它的元素；不是以类型前缀开头的一行按内联命令解析（redis-cli telnet那种），
+ *  按空白分割成一个字符串数组
+ *
+ *  可以接着上次继续解析：已经解析完的元素只记录相对于peek()的偏移，数据不够的时候返回kNeedMore，
+ *  下一次从没有解析完的那个元素接着解析；卡在一个大的bulk string上的时候记住需要的总字节数，
+ *  数据没到齐之前直接返回，不会重复扫描；用法和HttpParser一样：
+ *      while (parser.parse(buf) == RespParser::kComplete)
+ *      {
+ *          handle(parser.values());
+ *          buf->retrieve(parser.messageBytes());
+ *          parser.reset();
+ *      }
+ */
+class RespParser : noncopyable
+{
+public:
+    enum Result
+    {
+        kNeedMore,
+        kComplete,
+        kError,     // 协议错误，error()是原因，连接应该关掉
+    };
+
+    static const size_t kMaxLineLength = 64*1024;           // 一行（包括内联命令）最长多少字节
+    static const int64_t kMaxBulkLength = 512*1024*1024;    // 和redis的proto-max-bulk-len一样
+    static const int64_t kMaxAggregateLength = 1024*1024;   // 一个聚合类型最多多少个元素
+
+    RespParser();
+
+    Result parse(const Buffer *buf);
+
+    // kComplete之后有效，StringPiece指向buf，retrieve之前有效
+    const std::vector<RespValue>& values() const { return values_; }
+    // 当前这个消息在buf中一共占了多少字节
+    size_t messageBytes() const { return pos_; }
+    const char* error() const { return error_; }
+
+    // 把请求转换成命令参数，请求必须是一个元素都是字符串的数组，内联命令也是这样
+    bool command(std::vector<StringPiece> *args) const;
+
+    // 开始解析下一个消息，已经分配的内存留着复用
+    void reset();
+private:
+    Result parseInline(const Buffer *buf);
+    Result fail(const char *error)
+    {
+        error_ = error;
+        return kError;
+    }
+
+    size_t pos_;        // 已经解析完的字节数
+    size_t needBytes_;  // 可读数据至少要有这么多才值得再解析
+    int64_t todo_;      // 还有多少个值没有解析
+    const char *error_;
+    std::vector<RespValue> values_;
+    // values_中字符串相对于peek()的偏移和长度，kComplete的时候才转换成指针
+    std::vector<std::pair<size_t, size_t>> spans_;
+};
+
+// 把回复或者命令按RESP编码追加到Buffer中
+class RespWriter
+{
+public:
+    static void appendSimpleString(Buffer *buf, const StringPiece &str);
+    // message是包括错误前缀的完整错误信息，比如 "ERR unknown command"
+    static void appendError(Buffer *buf, const StringPiece &message);
+    static void appendInteger(Buffer *buf, int64_t value);
+    static void appendBulkString(Buffer *buf, const StringPiece &str);
+    static void appendArrayHeader(Buffer *buf, int64_t count);
+
+    // 下面这些RESP2没有对应的类型，resp3为false的时候按redis的惯例降级
+    static void appendNull(Buffer *buf, bool resp3);                  // $-1
+    static void appendBoolean(Buffer *buf, bool value, bool resp3);   // :1 :0
+    static void appendMapHeader(Buffer *buf, int64_t count, bool resp3); // 2*count个元素的数组
+
+    // 客户端发的命令，所有参数都编码成bulk string
+    static void appendCommand(Buffer *buf, const std::vector<StringPiece> &args);
+private:
+    static void appendHeader(Buffer *buf, char type, int64_t value);
+};
@@ -0,0 +1,147 @@
+#include "RpcClient.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <math.h>
+
+RpcClient::RpcClient(EventLoop *loop,
+                const InetAddress &serverAddr,
+                const std::string &name)
+    : loop_(loop)
+    , client_(loop, serverAddr, name)
+    , maxMessageLength_(RpcCodec::kDefaultMaxMessageLength)
+    , nextCallId_(1)
+{
+    client_.setConnectionCallback(
+        std::bind(&RpcClient::onConnection, this, std::placeholders::_1));
+    client_.setMessageCallback(
+        std::bind(&RpcClient::onMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+RpcClient::~RpcClient()
+{
+    // 定时器回调会用到this
+    for (auto &item : pending_)
+    {
+        loop_->cancel(item.second.timer);
+    }
+    // client_析构的时候会关闭连接，连接关闭时的回调不能再调到this
+    if (connection_)
+    {
+        connection_->setConnectionCallback([](const TcpConnectionPtr&) {});
+        connection_->setMessageCallback([](const TcpConnectionPtr&, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+    }
+}
+
+void RpcClient::call(uint32_t methodId, const StringPiece &request, const RpcCallback &cb, double timeout)
+{
+    const uint64_t callId = nextCallId_++;
+    if (loop_->isInLoopThread())
+    {
+        callInLoop(callId, methodId, request, cb, timeout);
+    }
+    else
+    {
+        // request是调用者的内存，跨线程要拷贝一份
+        loop_->runInLoop(std::bind(&RpcClient::callInLoop, this, callId, methodId,
+                                std::string(request.data(), request.size()), cb, timeout));
+    }
+}
+
+void RpcClient::callInLoop(uint64_t callId, uint32_t methodId, const StringPiece &request,
+                        const RpcCallback &cb, double timeout)
+{
+    if (!connection_ || !connection_->connected())
+    {
+        cb(RpcCodec::kConnectionClosed, StringPiece());
+        return;
+    }
+
+    PendingCall &pending = pending_[callId];
+    pending.callback = cb;
+    RpcCodec::Header header;
+    header.callId = callId;
+    header.methodId = methodId;
+    header.aux = 0;
+    if (timeout > 0)
+    {
+        pending.timer = loop_->runAfter(timeout, std::bind(&RpcClient::onTimeout, this, callId));
+        header.aux = static_cast<uint32_t>(::ceil(timeout * 1000));
+    }
+    RpcCodec::send(connection_, header, request.data(), request.size());
+}
+
+void RpcClient::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        // 同一轮事件循环中发起的调用合并成一次writev
+        conn->setCork(true);
+        connection_ = conn;
+    }
+    else
+    {
+        connection_.reset();
+        failAll(RpcCodec::kConnectionClosed);
+    }
+    if (connectionCallback_)
+    {
+        connectionCallback_(conn);
+    }
+}
+
+void RpcClient::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    RpcCodec::Header header;
+    size_t bodyLength = 0;
+    int result = 0;
+    while ((result = RpcCodec::peekFrame(buf, maxMessageLength_, &header, &bodyLength)) > 0)
+    {
+        auto it = pending_.find(header.callId);
+        // 找不到的是已经超时的调用，回复丢掉
+        if (it != pending_.end())
+        {
+            PendingCall pending(std::move(it->second));
+            pending_.erase(it);
+            if (pending.timer.valid())
+            {
+                loop_->cancel(pending.timer);
+            }
+            pending.callback(static_cast<int>(header.aux),
+                            StringPiece(buf->peek() + RpcCodec::kHeaderLength, bodyLength));
+        }
+        buf->retrieve(RpcCodec::kHeaderLength + bodyLength);
+    }
+    if (result < 0)
+    {
+        LOG_ERROR("RpcClient::onMessage [%s] invalid frame length \n", conn->name().c_str());
+        buf->retrieveAll();
+        conn->shutdown();
+    }
+}
+
+void RpcClient::onTimeout(uint64_t callId)
+{
+    auto it = pending_.find(callId);
+    if (it != pending_.end())
+    {
+        RpcCallback callback(std::move(it->second.callback));
+        pending_.erase(it);
+        callback(RpcCodec::kDeadlineExceeded, StringPiece());
+    }
+}
+
+void RpcClient::failAll(int status)
+{
+    // 回调中可能会再发起调用，先换出来
+    std::unordered_map<uint64_t, PendingCall> pending;
+    pending.swap(pending_);
+    for (auto &item : pending)
+    {
+        if (item.second.timer.valid())
+        {
+            loop_->cancel(item.second.timer);
+        }
+        item.second.callback(status, StringPiece());
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpClient.h"
+#include "RpcCodec.h"
+#include "StringPiece.h"
+#include "TimerId.h"
+
+#include <functional>
+#include <unordered_map>
+#include <string>
+#include <atomic>
+
+/**
+ *  多路复用的RPC客户端，一个连接上可以同时有任意多个调用，不用等上一个调用回复就可以发下一个
+ *  回复按callId对应到调用，可以乱序到达
+ *  - 每个调用可以有自己的超时时间，到时间还没有回复就以kDeadlineExceeded结束，之后到达的回复丢掉；
+ *    超时时间也会发给服务端，服务端不再执行已经过期的请求
+ *  - 连接断开的时候所有还没有回复的调用以kConnectionClosed结束
+ *  RpcClient要在loop线程中析构，析构的时候还没有结束的调用不再回调
+ */
+class RpcClient : noncopyable
+{
+public:
+    // 在loop线程中调用，response只在回调期间有效，status不是kOk的时候response是服务端给的错误信息或者空
+    using RpcCallback = std::function<void (int status, const StringPiece &response)>;
+
+    RpcClient(EventLoop *loop,
+            const InetAddress &serverAddr,
+            const std::string &name);
+    ~RpcClient();
+
+    void connect() { client_.connect(); }
+    void disconnect() { client_.disconnect(); }
+    void enableRetry() { client_.enableRetry(); }
+    // 在connect之前设置
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMaxMessageLength(size_t maxLength) { maxMessageLength_ = maxLength; }
+
+    // 发起一次调用，线程安全；timeout是秒，0表示不限
+    // 还没有连上的时候立刻以kConnectionClosed回调
+    void call(uint32_t methodId, const StringPiece &request, const RpcCallback &cb, double timeout = 0);
+
+    // 还在等回复的调用数，在loop线程中调用
+    size_t pendingCalls() const { return pending_.size(); }
+    EventLoop* getLoop() const { return loop_; }
+private:
+    struct PendingCall
+    {
+        RpcCallback callback;
+        TimerId timer;
+    };
+
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+    void callInLoop(uint64_t callId, uint32_t methodId, const StringPiece &request,
+                const RpcCallback &cb, double timeout);
+    void onTimeout(uint64_t callId);
+    void failAll(int status);
+
+    EventLoop *loop_;
+    TcpClient client_;
+    ConnectionCallback connectionCallback_;
+    size_t maxMessageLength_;
+    std::atomic<uint64_t> nextCallId_;
+    // 下面的成员只在loop线程中使用
+    TcpConnectionPtr connection_;
+    std::unordered_map<uint64_t, PendingCall> pending_;
+};
@@ -0,0 +1,82 @@
+#include "RpcCodec.h"
+#include "Buffer.h"
+#include "TcpConnection.h"
+
+#include <endian.h>
+#include <string.h>
+#include <sys/uio.h>
+
+int RpcCodec::peekFrame(const Buffer *buf, size_t maxBodyLength, Header *header, size_t *bodyLength)
+{
+    if (buf->readableBytes() < kHeaderLength)
+    {
+        return 0;
+    }
+    const size_t length = static_cast<uint32_t>(buf->peekInt32());
+    if (length < kHeaderLength - sizeof(uint32_t) || length - (kHeaderLength - sizeof(uint32_t)) > maxBodyLength)
+    {
+        return -1;
+    }
+    if (buf->readableBytes() < sizeof(uint32_t) + length)
+    {
+        return 0;
+    }
+
+    const char *p = buf->peek() + sizeof(uint32_t);
+    uint64_t callId = 0;
+    uint32_t methodId = 0;
+    uint32_t aux = 0;
+    ::memcpy(&callId, p, sizeof callId);
+    ::memcpy(&methodId, p + 8, sizeof methodId);
+    ::memcpy(&aux, p + 12, sizeof aux);
+    header->callId = be64toh(callId);
+    header->methodId = be32toh(methodId);
+    header->aux = be32toh(aux);
+    *bodyLength = length - (kHeaderLength - sizeof(uint32_t));
+    return 1;
+}
+
+void RpcCodec::encodeHeader(char *buf, const Header &header, size_t bodyLength)
+{
+    uint32_t length = htobe32(static_cast<uint32_t>(bodyLength + kHeaderLength - sizeof(uint32_t)));
+    uint64_t callId = htobe64(header.callId);
+    uint32_t methodId = htobe32(header.methodId);
+    uint32_t aux = htobe32(header.aux);
+    ::memcpy(buf, &length, sizeof length);
+    ::memcpy(buf + 4, &callId, sizeof callId);
+    ::memcpy(buf + 12, &methodId, sizeof methodId);
+    ::memcpy(buf + 16, &aux, sizeof aux);
+}
+
+void RpcCodec::send(const TcpConnectionPtr &conn, const Header &header, const void *body, size_t len)
+{
+    char head[kHeaderLength];
+    encodeHeader(head, header, len);
+    struct iovec iov[2];
+    iov[0].iov_base = head;
+    iov[0].iov_len = sizeof head;
+    iov[1].iov_base = const_cast<void*>(body);
+    iov[1].iov_len = len;
+    conn->sendv(iov, len > 0 ? 2 : 1);
+}
+
+const char* RpcCodec::statusString(int status)
+{
+    switch (status)
+    {
+    case kOk:
+        return "ok";
+    case kNoSuchMethod:
+        return "no such method";
+    case kDeadlineExceeded:
+        return "deadline exceeded";
+    case kConnectionClosed:
+        return "connection closed";
+    case kBadRequest:
+        return "bad request";
+    case kInternalError:
+        return "internal error";
+    default:
+        return "unknown status";
+    }
+}
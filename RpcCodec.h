@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Callbacks.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+class Buffer;
+
+/**
+ *  RPC的帧格式，所有整数都是网络字节序：
+ *
+ *      [length:4][callId:8][methodId:4][aux:4][body]
+ *
+ *  length是后面所有字节（不含length自己）的长度；callId由客户端分配，回复带回同一个callId，
+ *  所以一个连接上可以同时有很多个调用，回复可以乱序；aux在请求中是调用方剩余的超时时间（毫秒，
+ *  0表示不限），服务端用来丢掉已经过期的请求，在回复中是状态码
+ */
+class RpcCodec
+{
+public:
+    enum Status
+    {
+        kOk = 0,
+        kNoSuchMethod = 1,      // 服务端没有注册这个methodId
+        kDeadlineExceeded = 2,  // 客户端超时，或者请求在服务端排队的时候已经过期
+        kConnectionClosed = 3,  // 连接断开，回复不会再来了
+        kBadRequest = 4,        // 由handler返回，请求内容不对
+        kInternalError = 5,     // 由handler返回
+    };
+
+    struct Header
+    {
+        uint64_t callId;
+        uint32_t methodId;
+        uint32_t aux;
+    };
+
+    static const size_t kHeaderLength = 20; // 包括length字段
+    static const size_t kDefaultMaxMessageLength = 64*1024*1024;
+
+    // buf中有完整的一帧时返回1，填好header和body长度；不够一帧返回0；长度超过maxBodyLength返回-1
+    static int peekFrame(const Buffer *buf, size_t maxBodyLength, Header *header, size_t *bodyLength);
+
+    // 头部和body用一次writev发出去，线程安全
+    static void send(const TcpConnectionPtr &conn, const Header &header, const void *body, size_t len);
+
+    static const char* statusString(int status);
+private:
+    static void encodeHeader(char *buf, const Header &header, size_t bodyLength);
+};
@@ -0,0 +1,116 @@
+#include "RpcServer.h"
+#include "TcpConnection.h"
+#include "Logger.h"
+
+RpcServer::RpcServer(EventLoop *loop,
+                const InetAddress &listenAddr,
+                const std::string &name,
+                TcpServer::Option option)
+    : server_(loop, listenAddr, name, option)
+    , workers_(name + "Worker")
+    , numWorkerThreads_(0)
+    , maxMessageLength_(RpcCodec::kDefaultMaxMessageLength)
+{
+    server_.setConnectionCallback(
+        std::bind(&RpcServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(
+        std::bind(&RpcServer::onMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+RpcServer::~RpcServer()
+{
+    // 先等工作线程把手上的请求做完，它们会用到methods_
+    workers_.stop();
+}
+
+void RpcServer::registerMethod(uint32_t methodId, const MethodHandler &handler, Dispatch dispatch)
+{
+    Method &method = methods_[methodId];
+    method.handler = handler;
+    method.dispatch = dispatch;
+}
+
+void RpcServer::start()
+{
+    workers_.start(numWorkerThreads_);
+    server_.start();
+}
+
+void RpcServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setCork(true);
+    }
+    if (connectionCallback_)
+    {
+        connectionCallback_(conn);
+    }
+}
+
+void RpcServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    RpcCodec::Header header;
+    size_t bodyLength = 0;
+    int result = 0;
+    while (conn->connected()
+        && (result = RpcCodec::peekFrame(buf, maxMessageLength_, &header, &bodyLength)) > 0)
+    {
+        // body直接指向inputBuffer_，handler返回以后才复位
+        dispatch(conn, header, buf->peek() + RpcCodec::kHeaderLength, bodyLength, receiveTime);
+        buf->retrieve(RpcCodec::kHeaderLength + bodyLength);
+    }
+    if (result < 0)
+    {
+        LOG_ERROR("RpcServer::onMessage [%s] invalid frame length \n", conn->name().c_str());
+        buf->retrieveAll();
+        conn->shutdown();
+    }
+}
+
+void RpcServer::dispatch(const TcpConnectionPtr &conn, const RpcCodec::Header &header,
+                    const char *body, size_t len, Timestamp receiveTime)
+{
+    RpcCall call;
+    call.conn = conn;
+    call.callId = header.callId;
+    call.methodId = header.methodId;
+    // 超时从收到请求的时候开始算，不含网络上的时间
+    call.deadline = header.aux > 0 ? receiveTime + static_cast<int64_t>(header.aux) * 1000 : Timestamp::invalid();
+
+    auto it = methods_.find(header.methodId);
+    if (it == methods_.end())
+    {
+        replyError(call, RpcCodec::kNoSuchMethod);
+        return;
+    }
+    const Method &method = it->second;
+    if (method.dispatch == kInline || numWorkerThreads_ == 0)
+    {
+        method.handler(call, StringPiece(body, len));
+    }
+    else
+    {
+        workers_.run(std::bind(&RpcServer::runInWorker, &method, call, std::string(body, len)));
+    }
+}
+
+void RpcServer::runInWorker(const Method *method, const RpcCall &call, const std::string &request)
+{
+    // 在队列里排队的时候调用方已经放弃了，不用再做
+    if (call.expired())
+    {
+        replyError(call, RpcCodec::kDeadlineExceeded);
+        return;
+    }
+    method->handler(call, request);
+}
+
+void RpcServer::reply(const RpcCall &call, const StringPiece &response, int status)
+{
+    RpcCodec::Header header;
+    header.callId = call.callId;
+    header.methodId = call.methodId;
+    header.aux = static_cast<uint32_t>(status);
+    RpcCodec::send(call.conn, header, response.data(), response.size());
+}
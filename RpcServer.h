@@ -0,0 +1,87 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpServer.h"
+#include "ThreadPool.h"
+#include "RpcCodec.h"
+#include "StringPiece.h"
+#include "Timestamp.h"
+
+#include <functional>
+#include <unordered_map>
+#include <string>
+
+// 一次调用的上下文，handler可以拷贝保存下来，之后在任意线程中用RpcServer::reply回复
+struct RpcCall
+{
+    TcpConnectionPtr conn;
+    uint64_t callId;
+    uint32_t methodId;
+    Timestamp deadline;     // 调用方的超时时间，invalid表示不限
+
+    bool expired(Timestamp now = Timestamp::now()) const { return deadline.valid() && deadline < now; }
+};
+
+/**
+ *  多路复用的RPC服务端，帧格式见RpcCodec
+ *
+ *  一个连接上的请求按到达的顺序分发，handler不需要马上回复，可以把RpcCall存起来异步回复，
+ *  所以回复的顺序和请求的顺序无关，客户端按callId对应
+ *  - kInline：handler直接在IO线程中执行，request指向inputBuffer_，不拷贝，适合很快的调用
+ *  - kWorker：request拷贝一份交给工作线程池执行，适合计算量大或者会阻塞的调用；
+ *            开始执行之前已经超过调用方deadline的请求直接回复kDeadlineExceeded，不再执行
+ *  连接开启了cork，同一轮事件循环中产生的回复合并成一次writev
+ */
+class RpcServer : noncopyable
+{
+public:
+    enum Dispatch
+    {
+        kInline,
+        kWorker,
+    };
+
+    // request只在handler执行期间有效
+    using MethodHandler = std::function<void (const RpcCall &call, const StringPiece &request)>;
+
+    RpcServer(EventLoop *loop,
+            const InetAddress &listenAddr,
+            const std::string &name,
+            TcpServer::Option option = TcpServer::kNoReusePort);
+    ~RpcServer();
+
+    // 下面的设置都要在start之前
+    void registerMethod(uint32_t methodId, const MethodHandler &handler, Dispatch dispatch = kInline);
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    // 工作线程的数量，0表示kWorker的方法也在IO线程中执行
+    void setWorkerThreadNum(int numThreads) { numWorkerThreads_ = numThreads; }
+    // 工作线程池的队列长度，满了以后IO线程会阻塞，0表示不限
+    void setMaxWorkerQueueSize(size_t maxSize) { workers_.setMaxQueueSize(maxSize); }
+    void setMaxMessageLength(size_t maxLength) { maxMessageLength_ = maxLength; }
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+
+    void start();
+
+    // 回复一次调用，线程安全，连接已经断开的话什么都不做
+    static void reply(const RpcCall &call, const StringPiece &response, int status = RpcCodec::kOk);
+    static void replyError(const RpcCall &call, int status) { reply(call, StringPiece(), status); }
+private:
+    struct Method
+    {
+        MethodHandler handler;
+        Dispatch dispatch;
+    };
+
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+    void dispatch(const TcpConnectionPtr &conn, const RpcCodec::Header &header,
+                const char *body, size_t len, Timestamp receiveTime);
+    static void runInWorker(const Method *method, const RpcCall &call, const std::string &request);
+
+    TcpServer server_;
+    ThreadPool workers_;
+    int numWorkerThreads_;
+    size_t maxMessageLength_;
+    ConnectionCallback connectionCallback_;
+    std::unordered_map<uint32_t, Method> methods_; // start以后只读，不需要加锁
+};
@@ -8,6 +8,12 @@
 #include <strings.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <errno.h>
+#include <linux/net_tstamp.h>
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
 
 Socket::~Socket()
 {
@@ -74,4 +80,26 @@ void Socket::setKeepAlive(bool on)
 {
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof optval);
-}
\ No newline at end of file
+}
+// 需要linux 4.14以上
+bool Socket::setZeroCopy(bool on)
+{
+    int optval = on ? 1 : 0;
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof optval) < 0)
+    {
+        LOG_ERROR("setZeroCopy sockfd:%d err:%d \n", sockfd_, errno);
+        return false;
+    }
+    return true;
+}
+
+bool Socket::setRxTimestamping(bool on)
+{
+    int flags = on ? (SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE) : 0;
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof flags) < 0)
+    {
+        LOG_ERROR("setRxTimestamping sockfd:%d err:%d \n", sockfd_, errno);
+        return false;
+    }
+    return true;
+}
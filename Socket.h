@@ -25,6 +25,10 @@ public:
     void setReuseAddr(bool on);
     void setReusePort(bool on);
     void setKeepAlive(bool on);
+    // 开启SO_ZEROCOPY，内核不支持返回false
+    bool setZeroCopy(bool on);
+    // 开启SO_TIMESTAMPING的软件接收时间戳，recvmsg的时候可以拿到内核收到数据的时间
+    bool setRxTimestamping(bool on);
 private:
     const int sockfd_;
 };
\ No newline at end of file
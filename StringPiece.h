@@ -0,0 +1,99 @@
+#pragma once
+
+#include <string>
+#include <string.h>
+
+/**
+ *  不持有内存的字符串视图，就是一个 指针+长度，相当于C++17的std::string_view
+ *  项目用的是C++11，所以自己写一个（muduo里面也叫StringPiece）
+ *
+ *  注意：StringPiece不管理data指向的内存，指向Buffer的时候，Buffer一旦retrieve/append就可能失效
+ */
+class StringPiece
+{
+public:
+    StringPiece()
+        : ptr_(nullptr), length_(0) {}
+    StringPiece(const char *str)
+        : ptr_(str), length_(str == nullptr ? 0 : ::strlen(str)) {}
+    StringPiece(const std::string &str)
+        : ptr_(str.data()), length_(str.size()) {}
+    StringPiece(const char *offset, size_t len)
+        : ptr_(offset), length_(len) {}
+
+    const char* data() const { return ptr_; }
+    size_t size() const { return length_; }
+    bool empty() const { return length_ == 0; }
+    const char* begin() const { return ptr_; }
+    const char* end() const { return ptr_ + length_; }
+
+    char operator[](size_t i) const { return ptr_[i]; }
+
+    void clear() { ptr_ = nullptr; length_ = 0; }
+    void set(const char *data, size_t len) { ptr_ = data; length_ = len; }
+
+    void remove_prefix(size_t n)
+    {
+        ptr_ += n;
+        length_ -= n;
+    }
+
+    void remove_suffix(size_t n)
+    {
+        length_ -= n;
+    }
+
+    StringPiece substr(size_t pos, size_t n = std::string::npos) const
+    {
+        if (pos > length_)
+        {
+            pos = length_;
+        }
+        if (n > length_ - pos)
+        {
+            n = length_ - pos;
+        }
+        return StringPiece(ptr_ + pos, n);
+    }
+
+    bool starts_with(const StringPiece &x) const
+    {
+        return length_ >= x.length_ && ::memcmp(ptr_, x.ptr_, x.length_) == 0;
+    }
+
+    // 找不到返回std::string::npos
+    size_t find(char c, size_t pos = 0) const
+    {
+        if (pos >= length_)
+        {
+            return std::string::npos;
+        }
+        const void *p = ::memchr(ptr_ + pos, c, length_ - pos);
+        return p == nullptr ? std::string::npos : static_cast<const char*>(p) - ptr_;
+    }
+
+    int compare(const StringPiece &x) const
+    {
+        size_t len = length_ < x.length_ ? length_ : x.length_;
+        int r = len == 0 ? 0 : ::memcmp(ptr_, x.ptr_, len);
+        if (r == 0)
+        {
+            if (length_ < x.length_) r = -1;
+            else if (length_ > x.length_) r = +1;
+        }
+        return r;
+    }
+
+    bool operator==(const StringPiece &x) const
+    {
+        return length_ == x.length_ && (length_ == 0 || ::memcmp(ptr_, x.ptr_, length_) == 0);
+    }
+    bool operator!=(const StringPiece &x) const { return !(*this == x); }
+    bool operator<(const StringPiece &x) const { return compare(x) < 0; }
+
+    // 需要持有数据的时候才拷贝出来
+    std::string as_string() const { return std::string(ptr_, length_); }
+private:
+    const char *ptr_;
+    size_t length_;
+};
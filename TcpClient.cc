@@ -0,0 +1,151 @@
+#include "TcpClient.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <sys/socket.h>
+#include <strings.h>
+#include <stdio.h>
+#include <errno.h>
+
+// 用户没有设置回调时的默认行为
+static void defaultConnectionCallback(const TcpConnectionPtr &conn)
+{
+    LOG_INFO("%s -> %s is %s \n", conn->localAddress().toIpPort().c_str(),
+        conn->peerAddress().toIpPort().c_str(), conn->connected() ? "UP" : "DOWN");
+}
+
+static void defaultMessageCallback(const TcpConnectionPtr&, Buffer *buf, Timestamp)
+{
+    buf->retrieveAll();
+}
+
+// TcpClient析构以后连接才断开时用这个关闭回调，不能再访问TcpClient了
+static void removeConnectionAfterClient(EventLoop *loop, const TcpConnectionPtr &conn)
+{
+    loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+TcpClient::TcpClient(EventLoop *loop,
+                const InetAddress &serverAddr,
+                const std::string &nameArg)
+    : loop_(loop)
+    , connector_(new Connector(loop, serverAddr))
+    , name_(nameArg)
+    , connectionCallback_(defaultConnectionCallback)
+    , messageCallback_(defaultMessageCallback)
+    , retry_(false)
+    , connect_(false)
+    , nextConnId_(1)
+{
+    connector_->setNewConnectionCallback(
+        std::bind(&TcpClient::newConnection, this, std::placeholders::_1));
+    LOG_INFO("TcpClient::TcpClient[%s] - connector %p \n", name_.c_str(), connector_.get());
+}
+
+TcpClient::~TcpClient()
+{
+    LOG_INFO("TcpClient::~TcpClient[%s] - connector %p \n", name_.c_str(), connector_.get());
+    TcpConnectionPtr conn;
+    bool unique = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        unique = connection_.use_count() == 1;
+        conn = connection_;
+    }
+    if (conn)
+    {
+        // 连接还在，关闭回调不能再指向this
+        CloseCallback cb = std::bind(&removeConnectionAfterClient, loop_, std::placeholders::_1);
+        loop_->runInLoop(std::bind(&TcpConnection::setCloseCallback, conn, cb));
+        if (unique)
+        {
+            conn->forceClose();
+        }
+    }
+    else
+    {
+        // 还没有连上，Connector的回调和重试定时器都持有它自己的shared_ptr，stop以后自己释放
+        connector_->stop();
+    }
+}
+
+void TcpClient::connect()
+{
+    LOG_INFO("TcpClient::connect[%s] - connecting to %s \n",
+        name_.c_str(), connector_->serverAddress().toIpPort().c_str());
+    connect_ = true;
+    connector_->start();
+}
+
+void TcpClient::disconnect()
+{
+    connect_ = false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (connection_)
+    {
+        connection_->shutdown();
+    }
+}
+
+void TcpClient::stop()
+{
+    connect_ = false;
+    connector_->stop();
+}
+
+void TcpClient::newConnection(int sockfd)
+{
+    sockaddr_in peer, local;
+    ::bzero(&peer, sizeof peer);
+    ::bzero(&local, sizeof local);
+    socklen_t addrlen = sizeof peer;
+    if (::getpeername(sockfd, (sockaddr*)&peer, &addrlen) < 0)
+    {
+        LOG_ERROR("TcpClient::newConnection getpeername error:%d \n", errno);
+    }
+    addrlen = sizeof local;
+    if (::getsockname(sockfd, (sockaddr*)&local, &addrlen) < 0)
+    {
+        LOG_ERROR("TcpClient::newConnection getsockname error:%d \n", errno);
+    }
+    InetAddress peerAddr(peer);
+    InetAddress localAddr(local);
+
+    char buf[64] = {0};
+    snprintf(buf, sizeof buf, ":%s#%d", peerAddr.toIpPort().c_str(), nextConnId_);
+    ++nextConnId_;
+    std::string connName = name_ + buf;
+
+    TcpConnectionPtr conn(new TcpConnection(loop_, connName, sockfd, localAddr, peerAddr));
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setCloseCallback(
+        std::bind(&TcpClient::removeConnection, this, std::placeholders::_1)
+    );
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection_ = conn;
+    }
+    conn->connectEstablished();
+}
+
+void TcpClient::removeConnection(const TcpConnectionPtr &conn)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (connection_ == conn)
+        {
+            connection_.reset();
+        }
+    }
+
+    // 现在还在TcpConnection::handleClose里面，connectDestroyed放到后面执行
+    loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+    if (retry_ && connect_)
+    {
+        LOG_INFO("TcpClient::removeConnection[%s] - reconnecting to %s \n",
+            name_.c_str(), connector_->serverAddress().toIpPort().c_str());
+        connector_->restart();
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Connector.h"
+#include "TcpConnection.h"
+
+#include <string>
+#include <mutex>
+#include <atomic>
+
+class EventLoop;
+
+/**
+ *  客户端，用Connector主动发起连接，连上以后和TcpServer一样创建TcpConnection
+ *  回调的用法和TcpServer相同，TcpClient只管理一个连接
+ *  enableRetry以后连接断开会重新连接，连接失败总是按指数退避重试
+ */
+class TcpClient : noncopyable
+{
+public:
+    TcpClient(EventLoop *loop,
+                const InetAddress &serverAddr,
+                const std::string &nameArg);
+    ~TcpClient();
+
+    void connect();     // 线程安全
+    void disconnect();  // 线程安全，shutdown当前连接，不再重连
+    void stop();        // 线程安全，停止还没有成功的连接
+
+    // 线程安全，还没有连上或者已经断开返回空
+    TcpConnectionPtr connection() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return connection_;
+    }
+
+    EventLoop* getLoop() const { return loop_; }
+    bool retry() const { return retry_; }
+    // 连接断开以后自动重连
+    void enableRetry() { retry_ = true; }
+
+    const std::string& name() const { return name_; }
+
+    // 不是线程安全的，在connect之前设置
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+private:
+    // 在loop线程中调用
+    void newConnection(int sockfd);
+    void removeConnection(const TcpConnectionPtr &conn);
+
+    EventLoop *loop_;
+    ConnectorPtr connector_;
+    const std::string name_;
+
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    WriteCompleteCallback writeCompleteCallback_;
+
+    std::atomic_bool retry_;
+    std::atomic_bool connect_;
+    int nextConnId_; // 只在loop线程中使用
+    mutable std::mutex mutex_;
+    TcpConnectionPtr connection_; // 由mutex_保护
+};
@@ -3,6 +3,7 @@
 #include "Socket.h"
 #include "Channel.h"
 #include "EventLoop.h"
+#include "MemoryBudget.h"
 
 #include <functional>
 #include <errno.h>
@@ -12,6 +13,11 @@
 #include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <string>
+#include <sys/uio.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <algorithm>
 
 static EventLoop* CheckLoopNotNull(EventLoop *loop)
 {
@@ -31,11 +37,24 @@ TcpConnection::TcpConnection(EventLoop *loop,
     , name_(nameArg)
     , state_(kConnecting)
     , reading_(true)
+    , flowPaused_(false)
+    , memoryPaused_(false)
+    , rxTimestamping_(false)
+    , cork_(false)
+    , flushPending_(false)
     , socket_(new Socket(sockfd))
     , channel_(new Channel(loop, sockfd))
     , localAddr_(localAddr)
     , peerAddr_(peerAddr)
     , highWaterMark_(64*1024*1024) // 64M
+    , flowControlHigh_(0)
+    , flowControlLow_(0)
+    , peerPaused_(false)
+    , maxReadBytes_(0)
+    , maxWriteBytes_(0)
+    , accountedBytes_(0)
+    , relaying_(false)
+    , relayReadDone_(false)
 {
     // 下面给channel设置相应的回调，poller给channel通知感兴趣的事件发生了，channel就会去执行相应的回调
     channel_->setReadCallback(
@@ -72,16 +91,443 @@ void TcpConnection::send(const std::string &buf)
         }
         else
         {
+            // 不能只把buf.c_str()传过去，等loop_执行的时候调用者的buf可能已经析构了，所以拷贝一份
+            send(std::string(buf));
+        }
+    }
+}
+
+void TcpConnection::send(std::string &&buf)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendStringInLoop(buf);
+        }
+        else
+        {
+            // string被移动到回调里面，由loop_所在的线程持有
             loop_->runInLoop(std::bind(
-                &TcpConnection::sendInLoop,
-                this,
-                buf.c_str(),
-                buf.size()
+                &TcpConnection::sendStringInLoop,
+                shared_from_this(),
+                std::move(buf)
             ));
         }
     }
 }
 
+void TcpConnection::send(const void *data, size_t len)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(data, len);
+        }
+        else
+        {
+            send(std::string(static_cast<const char*>(data), len));
+        }
+    }
+}
+
+void TcpConnection::send(Buffer *buf)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendBufferInLoop(*buf);
+        }
+        else
+        {
+            // takeAll直接把buf底层的内存拿走，不拷贝
+            loop_->runInLoop(std::bind(
+                &TcpConnection::sendBufferInLoop,
+                shared_from_this(),
+                buf->takeAll()
+            ));
+        }
+    }
+}
+
+void TcpConnection::send(const PayloadPtr &payload)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendPayloadInLoop(payload);
+        }
+        else
+        {
+            loop_->runInLoop(std::bind(
+                &TcpConnection::sendPayloadInLoop,
+                shared_from_this(),
+                payload
+            ));
+        }
+    }
+}
+
+void TcpConnection::sendv(const struct iovec *iov, int iovcnt)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendvInLoop(iov, iovcnt);
+        }
+        else
+        {
+            // iov指向的是调用者的内存，只能拷贝一次再交给loop_
+            Buffer buf;
+            for (int i = 0; i < iovcnt; ++i)
+            {
+                buf.append(iov[i].iov_base, iov[i].iov_len);
+            }
+            send(&buf);
+        }
+    }
+}
+
+void TcpConnection::sendv(std::vector<std::string> &&pieces)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendPiecesInLoop(pieces);
+        }
+        else
+        {
+            loop_->runInLoop(std::bind(
+                &TcpConnection::sendPiecesInLoop,
+                shared_from_this(),
+                std::move(pieces)
+            ));
+        }
+    }
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t length)
+{
+    if (state_ == kConnected)
+    {
+        int fileFd = ::dup(fd);
+        if (fileFd < 0)
+        {
+            LOG_ERROR("TcpConnection::sendFile dup fd=%d err:%d \n", fd, errno);
+            return;
+        }
+        loop_->runInLoop(std::bind(
+            &TcpConnection::sendFileInLoop,
+            shared_from_this(),
+            fileFd,
+            offset,
+            length
+        ));
+    }
+}
+
+bool TcpConnection::setZeroCopy(bool on, size_t threshold)
+{
+    if (!socket_->setZeroCopy(on))
+    {
+        return false;
+    }
+    outputBuffer_.setZeroCopy(on, threshold);
+    return true;
+}
+
+bool TcpConnection::setRxTimestamping(bool on)
+{
+    if (!socket_->setRxTimestamping(on))
+    {
+        return false;
+    }
+    rxTimestamping_ = on;
+    return true;
+}
+
+void TcpConnection::sendStringInLoop(std::string &message)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
+    size_t oldLen = outputBuffer_.readableBytes();
+    outputBuffer_.append(std::move(message));
+    writeQueuedInLoop(oldLen);
+}
+
+void TcpConnection::sendBufferInLoop(Buffer &buf)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
+    size_t oldLen = outputBuffer_.readableBytes();
+    outputBuffer_.append(buf.takeAll());
+    writeQueuedInLoop(oldLen);
+}
+
+void TcpConnection::sendPayloadInLoop(const PayloadPtr &payload)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
+    size_t oldLen = outputBuffer_.readableBytes();
+    outputBuffer_.append(payload);
+    writeQueuedInLoop(oldLen);
+}
+
+void TcpConnection::sendPiecesInLoop(std::vector<std::string> &pieces)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
+    size_t oldLen = outputBuffer_.readableBytes();
+    for (std::string &piece : pieces)
+    {
+        outputBuffer_.append(std::move(piece));
+    }
+    writeQueuedInLoop(oldLen);
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t length)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!");
+        ::close(fd);
+        return;
+    }
+    size_t oldLen = outputBuffer_.readableBytes();
+    outputBuffer_.appendFile(fd, offset, length);
+    writeQueuedInLoop(oldLen);
+}
+
+void TcpConnection::sendPipeInLoop(const PipePtr &pipe, size_t length)
+{
+    if (state_ == kDisconnected)
+    {
+        // relay的源连接下一次读的时候发现peer断开了，会关闭自己
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
+    size_t oldLen = outputBuffer_.readableBytes();
+    outputBuffer_.appendPipe(pipe, length);
+    writeQueuedInLoop(oldLen);
+}
+
+// 和sendInLoop一样的逻辑，只是第一次用writev直接发送iov，没发完的部分拷贝到outputBuffer_中
+void TcpConnection::sendvInLoop(const struct iovec *iov, int iovcnt)
+{
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; ++i)
+    {
+        len += iov[i].iov_len;
+    }
+    ssize_t nwrote = 0;
+    size_t remaining = len;
+    bool faultError = false;
+
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
+
+    if (!cork_ && !channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    {
+        // writev一次最多IOV_MAX块，多出来的就放进缓冲区
+        nwrote = ::writev(channel_->fd(), iov, iovcnt < IOV_MAX ? iovcnt : IOV_MAX);
+        if (nwrote >= 0)
+        {
+            remaining = len - nwrote;
+            if (remaining == 0 && writeCompleteCallback_)
+            {
+                loop_->queueInLoop(
+                    std::bind(writeCompleteCallback_, shared_from_this())
+                );
+            }
+        }
+        else // nwrote < 0
+        {
+            nwrote = 0;
+            if (errno != EWOULDBLOCK)
+            {
+                LOG_ERROR("TcpConnection::sendvInLoop");
+                if (errno == EPIPE || errno == ECONNRESET) // SIGPIPE  RESET
+                {
+                    faultError = true;
+                }
+            }
+        }
+    }
+
+    if (!faultError && remaining > 0)
+    {
+        size_t oldLen = outputBuffer_.readableBytes();
+        if (oldLen + remaining >= highWaterMark_
+            && oldLen < highWaterMark_
+            && highWaterMarkCallback_)
+        {
+            loop_->queueInLoop(
+                std::bind(highWaterMarkCallback_, shared_from_this(), oldLen+remaining)
+            );
+        }
+        // 跳过已经发送的nwrote个字节，剩下的按顺序放入缓冲区
+        size_t skip = nwrote;
+        for (int i = 0; i < iovcnt; ++i)
+        {
+            const char *base = static_cast<const char*>(iov[i].iov_base);
+            size_t n = iov[i].iov_len;
+            if (skip >= n)
+            {
+                skip -= n;
+                continue;
+            }
+            outputBuffer_.append(base + skip, n - skip);
+            skip = 0;
+        }
+        outputSizeChangedInLoop();
+        if (cork_)
+        {
+            scheduleFlushInLoop();
+        }
+        else if (!channel_->isWriting())
+        {
+            channel_->enableWriting();
+        }
+    }
+}
+
+void TcpConnection::writeQueuedInLoop(size_t oldLen)
+{
+    if (cork_)
+    {
+        // 本轮循环先不写，等事件处理完统一flush
+        scheduleFlushInLoop();
+    }
+    else if (!channel_->isWriting() && oldLen == 0)
+    {
+        if (writeOutputInLoop())
+        {
+            return;
+        }
+    }
+
+    size_t remaining = outputBuffer_.readableBytes();
+    if (remaining >= highWaterMark_
+        && oldLen < highWaterMark_
+        && highWaterMarkCallback_)
+    {
+        loop_->queueInLoop(
+            std::bind(highWaterMarkCallback_, shared_from_this(), remaining)
+        );
+    }
+    outputSizeChangedInLoop();
+    if (!cork_ && !channel_->isWriting())
+    {
+        // 注册写事件，剩下的数据在handleWrite中发送
+        channel_->enableWriting();
+    }
+}
+
+// 直接把outputBuffer_写一次，全部写完或者连接出错了返回true，还有剩余返回false
+bool TcpConnection::writeOutputInLoop()
+{
+    int savedErrno = 0;
+    ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
+    if (n >= 0)
+    {
+        outputBuffer_.retrieve(n);
+        outputSizeChangedInLoop();
+        if (outputBuffer_.readableBytes() == 0)
+        {
+            if (writeCompleteCallback_)
+            {
+                loop_->queueInLoop(
+                    std::bind(writeCompleteCallback_, shared_from_this())
+                );
+            }
+            return true;
+        }
+    }
+    else if (savedErrno != EWOULDBLOCK)
+    {
+        LOG_ERROR("TcpConnection::writeOutputInLoop");
+        if (savedErrno == EPIPE || savedErrno == ECONNRESET) // SIGPIPE  RESET
+        {
+            outputBuffer_.retrieveAll();
+            return true;
+        }
+    }
+    return false;
+}
+
+void TcpConnection::setCork(bool on)
+{
+    cork_ = on;
+    if (!on)
+    {
+        flushInLoop();
+    }
+}
+
+void TcpConnection::flush()
+{
+    if (loop_->isInLoopThread())
+    {
+        flushInLoop();
+    }
+    else
+    {
+        loop_->runInLoop(std::bind(&TcpConnection::flushInLoop, shared_from_this()));
+    }
+}
+
+// queueInLoop放进去的回调会在这一轮的事件都处理完之后、下一次epoll_wait之前执行
+void TcpConnection::scheduleFlushInLoop()
+{
+    if (!flushPending_ && !channel_->isWriting())
+    {
+        flushPending_ = true;
+        loop_->queueInLoop(std::bind(&TcpConnection::flushInLoop, shared_from_this()));
+    }
+}
+
+// 把攒下的数据用一次writev发出去，没发完的交给handleWrite
+void TcpConnection::flushInLoop()
+{
+    flushPending_ = false;
+    if (state_ == kDisconnected
+        || channel_->isWriting()
+        || outputBuffer_.readableBytes() == 0)
+    {
+        return;
+    }
+
+    if (writeOutputInLoop())
+    {
+        if (state_ == kDisconnecting)
+        {
+            shutdownInLoop();
+        }
+        return;
+    }
+    channel_->enableWriting();
+}
+
 // 应用写的快，而内核发送数据慢，需要把待发送数据写入缓冲区，而且设置水位回调
 void TcpConnection::sendInLoop(const void* data, size_t len)
 {
@@ -100,7 +546,8 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
     // 表示channel第一次开始写数据，而且缓冲区没有待发送数据 因为readableBytes表示可读的数据，若没有
     // 则表示没有缓冲区没有要write的数据，直接write data
     // 因为是第一次，一般我们都是设置channel的isReading()，所以isWriting == false
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    // 开启了cork就不直接写，全部放进缓冲区等flush
+    if (!cork_ && !channel_->isWriting() && outputBuffer_.readableBytes() == 0)
     {
         nwrote = ::write(channel_->fd(), data, len);
         if (nwrote >= 0)
@@ -147,7 +594,12 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
         }
 		 // 把数据继续放入缓冲区
         outputBuffer_.append((char*)data + nwrote, remaining);
-        if (!channel_->isWriting())
+        outputSizeChangedInLoop();
+        if (cork_)
+        {
+            scheduleFlushInLoop();
+        }
+        else if (!channel_->isWriting())
         {
 			// 注册写事件，否则poller不会给channel通知epollout事件
             channel_->enableWriting(); 
@@ -167,12 +619,266 @@ void TcpConnection::shutdown()
     }
 }
 
+void TcpConnection::startRead()
+{
+    loop_->runInLoop(std::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::stopRead()
+{
+    loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::startReadInLoop()
+{
+    reading_ = true;
+    updateReadingInLoop();
+}
+
+void TcpConnection::stopReadInLoop()
+{
+    reading_ = false;
+    updateReadingInLoop();
+}
+
+void TcpConnection::setFlowPaused(bool paused)
+{
+    loop_->runInLoop(std::bind(&TcpConnection::setFlowPausedInLoop, shared_from_this(), paused));
+}
+
+void TcpConnection::setFlowPausedInLoop(bool paused)
+{
+    flowPaused_ = paused;
+    updateReadingInLoop();
+}
+
+void TcpConnection::updateReadingInLoop()
+{
+    // 已经断开的channel不能再注册到poller上
+    if (state_ == kDisconnected)
+    {
+        return;
+    }
+    // relay读到EOF以后socket一直可读，不能再关注读事件
+    const bool want = reading_ && !flowPaused_ && !memoryPaused_ && !relayReadDone_;
+    if (want && !channel_->isReading())
+    {
+        channel_->enableReading();
+    }
+    else if (!want && channel_->isReading())
+    {
+        channel_->disableReading();
+    }
+}
+
+void TcpConnection::setFlowControl(const TcpConnectionPtr &peer, size_t highMark, size_t lowMark)
+{
+    flowControlPeer_ = peer;
+    flowControlHigh_ = highMark;
+    flowControlLow_ = lowMark;
+    outputSizeChangedInLoop();
+}
+
+void TcpConnection::outputSizeChangedInLoop()
+{
+    updateMemoryUsageInLoop();
+    if (flowControlHigh_ == 0)
+    {
+        return;
+    }
+    const size_t pending = outputBuffer_.readableBytes();
+    if (!peerPaused_ && pending >= flowControlHigh_)
+    {
+        TcpConnectionPtr peer = flowControlPeer_.lock();
+        if (peer)
+        {
+            peer->setFlowPaused(true);
+            peerPaused_ = true;
+        }
+    }
+    else if (peerPaused_ && pending <= flowControlLow_)
+    {
+        TcpConnectionPtr peer = flowControlPeer_.lock();
+        if (peer)
+        {
+            peer->setFlowPaused(false);
+        }
+        peerPaused_ = false;
+    }
+}
+
+void TcpConnection::relayTo(const TcpConnectionPtr &peer, size_t pipeSize)
+{
+    relaying_ = true;
+    relayPeer_ = peer;
+    size_t highMark = pipeSize;
+    if (peer->getLoop() == loop_)
+    {
+        PipePtr pipe = std::make_shared<Pipe>();
+        if (pipe->valid())
+        {
+            pipe->setCapacity(pipeSize);
+            relayPipe_ = pipe;
+            // 管道满了就不能再splice进去了，所以水位不能超过管道的实际容量
+            highMark = pipe->capacity();
+        }
+    }
+    LOG_INFO("TcpConnection::relayTo [%s] -> [%s] %s \n", name_.c_str(), peer->name().c_str(),
+        relayPipe_ ? "splice" : "buffered");
+
+    peer->getLoop()->runInLoop(std::bind(&TcpConnection::setFlowControl,
+        peer, shared_from_this(), highMark, highMark / 2));
+    if (inputBuffer_.readableBytes() > 0)
+    {
+        peer->send(&inputBuffer_);
+        updateMemoryUsageInLoop();
+    }
+}
+
+void TcpConnection::handleRelayRead()
+{
+    TcpConnectionPtr peer = relayPeer_.lock();
+    if (!peer || peer->state_ == kDisconnected)
+    {
+        handleClose();
+        return;
+    }
+    size_t budget = loop_->ioBudget(maxReadBytes_ > 0 ? maxReadBytes_ : SIZE_MAX);
+    // 管道中还有peer没发出去的数据，只能再放满管道
+    const size_t capacity = relayPipe_->capacity();
+    const size_t inPipe = relayPipe_->readableBytes();
+    const size_t room = capacity > inPipe ? capacity - inPipe : 0;
+    if (budget == 0 || room == 0)
+    {
+        return;
+    }
+
+    ssize_t n = ::splice(channel_->fd(), nullptr, relayPipe_->writeFd(), nullptr,
+                    std::min(budget, room), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    loop_->chargeIo(n > 0 ? n : 0);
+    if (n > 0)
+    {
+        peer->sendPipeInLoop(relayPipe_, n);
+    }
+    else if (n == 0)
+    {
+        handleRelayEof();
+    }
+    else if (errno == EINVAL || errno == ENOSYS)
+    {
+        // 这个socket不支持splice，之后改成普通的拷贝转发，管道中已有的数据还挂在peer的发送队列上，顺序不会乱
+        LOG_ERROR("TcpConnection::handleRelayRead [%s] splice not supported, fall back to buffered relay \n", name_.c_str());
+        relayPipe_.reset();
+    }
+    else if (errno != EAGAIN)
+    {
+        LOG_ERROR("TcpConnection::handleRelayRead");
+        handleError();
+    }
+}
+
+void TcpConnection::handleRelayEof()
+{
+    relayReadDone_ = true;
+    updateReadingInLoop();
+    TcpConnectionPtr peer = relayPeer_.lock();
+    if (peer)
+    {
+        // 等peer的数据发完再发FIN
+        peer->shutdown();
+    }
+    // 另一个方向也已经结束（或者peer已经没了），可以关闭了，否则等shutdownInLoop发完FIN再关闭
+    if (!peer || peer->state_ == kDisconnected
+        || (state_ == kDisconnecting && !channel_->isWriting() && outputBuffer_.readableBytes() == 0))
+    {
+        handleClose();
+    }
+}
+
+void TcpConnection::updateMemoryUsageInLoop()
+{
+    // 断开以后的变化不再统计，connectDestroyed的时候把记过的全部减掉
+    if (state_ == kDisconnected)
+    {
+        return;
+    }
+    const int64_t bytes = static_cast<int64_t>(inputBuffer_.readableBytes() + outputBuffer_.memoryBytes());
+    if (bytes != accountedBytes_)
+    {
+        loop_->addBufferBytes(bytes - accountedBytes_);
+        accountedBytes_ = bytes;
+    }
+}
+
+void TcpConnection::releaseMemoryUsageInLoop()
+{
+    loop_->addBufferBytes(-accountedBytes_);
+    accountedBytes_ = 0;
+}
+
+void TcpConnection::checkMemoryBudgetInLoop()
+{
+    MemoryBudget &budget = MemoryBudget::instance();
+    if (memoryOverBudgetCallback_
+        && budget.exceeded(MemoryBudget::kCloseLargest, loop_->unflushedBufferBytes()))
+    {
+        memoryOverBudgetCallback_(shared_from_this());
+    }
+    if (!memoryPaused_ && state_ == kConnected
+        && budget.exceeded(MemoryBudget::kStopReading, loop_->unflushedBufferBytes()))
+    {
+        memoryPaused_ = true;
+        updateReadingInLoop();
+        // 用量降下来之前连接可能已经关闭了，不能让它延长连接的生命周期
+        std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+        budget.waitForMemory(loop_, [weakConn]()
+        {
+            TcpConnectionPtr conn = weakConn.lock();
+            if (conn)
+            {
+                conn->memoryPaused_ = false;
+                conn->updateReadingInLoop();
+            }
+        });
+    }
+}
+
 void TcpConnection::shutdownInLoop()
 {
-	// 当前channel已经发送完数据了
-    if (!channel_->isWriting()) 
+	// 当前channel已经发送完数据了，cork攒着的数据也要等flush发完
+    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) 
     {
         socket_->shutdownWrite(); // 关闭写端
+        // relay两个方向都结束了
+        if (relayReadDone_ && state_ != kDisconnected)
+        {
+            handleClose();
+        }
+    }
+}
+
+void TcpConnection::forceClose()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        // 在loop线程中（比如MemoryBudget的kCloseLargest）马上把它从统计中去掉，
+        // 否则这一轮后面的连接看到的还是超过预算，又会关闭一个
+        if (loop_->isInLoopThread())
+        {
+            releaseMemoryUsageInLoop();
+        }
+        loop_->queueInLoop(
+            std::bind(&TcpConnection::forceCloseInLoop, shared_from_this())
+        );
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose();
     }
 }
 
@@ -203,21 +909,66 @@ void TcpConnection::connectDestroyed()
     }
 	// 把channel从poller中删除
     channel_->remove(); 
+
+    releaseMemoryUsageInLoop();
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
+    if (relayPipe_)
+    {
+        handleRelayRead();
+        return;
+    }
+    size_t budget = loop_->ioBudget(maxReadBytes_ > 0 ? maxReadBytes_ : SIZE_MAX);
+    if (budget == 0)
+    {
+        // 这一轮loop的预算用完了，数据还在内核中，下一轮epoll_wait会再通知
+        return;
+    }
     int savedErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+    Timestamp rxTime;
+    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno, budget, rxTimestamping_ ? &rxTime : nullptr);
+    loop_->chargeIo(n > 0 ? n : 0);
     if (n > 0)
     {
-        // 已建立连接的用户有可读事件发生，调用用户传入的回调操作 onMessage
-        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        // 同一轮的所有连接拿到的都是poll返回的时间，loop忙的时候数据其实早就到了
+        if (rxTime.valid())
+        {
+            loop_->recordQueueingDelay(Timestamp::now() - rxTime);
+            receiveTime = rxTime;
+        }
+        if (relaying_)
+        {
+            TcpConnectionPtr peer = relayPeer_.lock();
+            if (!peer || peer->state_ == kDisconnected)
+            {
+                inputBuffer_.retrieveAll();
+                handleClose();
+                return;
+            }
+            // 不在同一个loop的话数据移动到peer的loop中，不拷贝
+            peer->send(&inputBuffer_);
+        }
+        else
+        {
+            // 已建立连接的用户有可读事件发生，调用用户传入的回调操作 onMessage
+            messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        }
+        updateMemoryUsageInLoop();
+        checkMemoryBudgetInLoop();
     }
 	// 客户断开
     else if (n == 0)
     {
-        handleClose();
+        if (relaying_)
+        {
+            handleRelayEof();
+        }
+        else
+        {
+            handleClose();
+        }
     }
     else
     {
@@ -231,11 +982,19 @@ void TcpConnection::handleWrite()
 {
     if (channel_->isWriting())
     {
+        size_t budget = loop_->ioBudget(maxWriteBytes_ > 0 ? maxWriteBytes_ : SIZE_MAX);
+        if (budget == 0)
+        {
+            return; // 还在关注epollout，下一轮再写
+        }
         int savedErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
-        if (n > 0)
+        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno, budget);
+        loop_->chargeIo(n > 0 ? n : 0);
+        // 文件块被截断丢弃的时候会返回0
+        if (n >= 0)
         {
             outputBuffer_.retrieve(n);
+            outputSizeChangedInLoop();
 			// 表示全部发送了
             if (outputBuffer_.readableBytes() == 0)
             {
@@ -272,6 +1031,26 @@ void TcpConnection::handleClose()
     setState(kDisconnected);
     channel_->disableAll();
 
+    // 自己断开了，被暂停的peer要恢复读，否则它永远读不到对端的数据和关闭
+    if (peerPaused_)
+    {
+        TcpConnectionPtr peer = flowControlPeer_.lock();
+        if (peer)
+        {
+            peer->setFlowPaused(false);
+        }
+        peerPaused_ = false;
+    }
+    // 转发的另一端也要结束，等它的数据发完
+    if (relaying_)
+    {
+        TcpConnectionPtr peer = relayPeer_.lock();
+        if (peer)
+        {
+            peer->shutdown();
+        }
+    }
+
     TcpConnectionPtr connPtr(shared_from_this());
 	// 执行连接关闭的回调 其实和下面类似
     connectionCallback_(connPtr); 
@@ -281,6 +1060,13 @@ void TcpConnection::handleClose()
 
 void TcpConnection::handleError()
 {
+    // zero copy的发送完成通知也是通过socket的错误队列到来的，epoll会报告EPOLLERR，在这里回收
+    bool reaped = false;
+    if (outputBuffer_.zeroCopy() || outputBuffer_.pinnedChunks() > 0)
+    {
+        reaped = outputBuffer_.reapZeroCopy(channel_->fd()) > 0;
+    }
+
     int optval;
     socklen_t optlen = sizeof optval;
     int err = 0;
@@ -292,5 +1078,10 @@ void TcpConnection::handleError()
     {
         err = optval;
     }
+    // 只是完成通知，不是真正的错误
+    if (reaped && err == 0)
+    {
+        return;
+    }
     LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d \n", name_.c_str(), err);
 }
\ No newline at end of file
@@ -4,11 +4,15 @@
 #include "InetAddress.h"
 #include "Callbacks.h"
 #include "Buffer.h"
+#include "OutputQueue.h"
 #include "Timestamp.h"
 
 #include <memory>
 #include <string>
 #include <atomic>
+#include <vector>
+
+struct iovec;
 
 class Channel;
 class EventLoop;
@@ -34,9 +38,78 @@ public:
     bool connected() const { return state_ == kConnected; }
 
     // 发送数据
-    void send(const std::string &buf);
+    // 在其他线程调用的时候，数据的所有权会转移到loop_所在的线程中，调用者的数据立刻就可以释放
+    void send(const std::string &buf); // 跨线程时拷贝一次
+    void send(std::string &&buf);      // 跨线程时移动，不拷贝
+    void send(const void *data, size_t len); // 跨线程时拷贝一次
+    void send(Buffer *buf);            // 取走buf中的全部可读数据，buf被清空，整块放入发送队列不拷贝
+    void send(const PayloadPtr &payload); // 只增加引用计数，广播给很多连接的时候共享同一份数据
+
+    // 分散写：多块数据（比如 头部+消息体）用一次writev发出去，不需要先拼接
+    // iov只是借用，没发完的部分以及跨线程调用时会拷贝一次
+    void sendv(const struct iovec *iov, int iovcnt);
+    // pieces交给TcpConnection，没发完的部分按块排队，不拷贝
+    void sendv(std::vector<std::string> &&pieces);
+
+    // 用sendfile发送文件fd从offset开始的length个字节，排在之前所有待发送数据的后面
+    // 内部会dup一份fd，调用返回以后调用者就可以close自己的fd
+    void sendFile(int fd, off_t offset, size_t length);
+
+    // 大于threshold的待发送数据块用MSG_ZEROCOPY发送，只对交给TcpConnection的数据生效
+    // （send(std::string&&) send(Buffer*) sendv(std::vector<std::string>&&)），借用的数据还是拷贝
+    // 要在loop线程中调用，比如在connectionCallback中
+    bool setZeroCopy(bool on, size_t threshold = OutputQueue::kDefaultZeroCopyThreshold);
+
+    // 开启SO_TIMESTAMPING软件接收时间戳，MessageCallback收到的receiveTime变成内核收到数据的时间，
+    // 而不是这一轮epoll_wait返回的时间；从收到到loop处理之间的排队延迟记到EventLoop::queueingDelay中
+    // 在loop线程中调用，或者在连接建立之前调用，内核不支持返回false
+    bool setRxTimestamping(bool on);
+
+    // 开启cork以后，一轮事件循环中多次send只是放进发送缓冲区，等这一轮的事件都处理完以后
+    // （下一次epoll_wait之前）再用一次writev发出去，适合一次收到多个pipeline请求、回复多次send的场景
+    // 要在loop线程中调用，关闭的时候会立刻flush
+    void setCork(bool on);
+    bool cork() const { return cork_; }
+    // 立刻发送cork攒下的数据，对延迟敏感的消息可以send之后马上flush
+    void flush();
+
+    // 每一轮事件循环中这个连接最多读/写多少字节，0表示不限制，没读写完的下一轮继续
+    // 还要受所在loop的预算限制（EventLoop::setIterationBudget）
+    void setIoBudget(size_t maxReadBytes, size_t maxWriteBytes)
+    { maxReadBytes_ = maxReadBytes; maxWriteBytes_ = maxWriteBytes; }
     // 关闭连接
     void shutdown();
+    // 不等待数据发完，直接关闭连接
+    void forceClose();
+
+    // 暂停/恢复读数据，线程安全，暂停期间数据留在内核的接收缓冲区中，TCP的窗口会让对端慢下来
+    void startRead();
+    void stopRead();
+    bool isReading() const { return reading_; }
+
+    // 自动流控：本连接待发送的数据超过highMark时暂停peer的读，降到lowMark以下再恢复
+    // 比如代理把client读到的数据发给upstream：upstream->setFlowControl(client, 4M, 1M)，
+    // 这样upstream慢的时候client的数据不会在outputBuffer_中无限堆积，peer也可以是自己（比如echo）
+    // 要在loop线程中调用
+    void setFlowControl(const TcpConnectionPtr &peer, size_t highMark, size_t lowMark);
+
+    // 四层转发：从这个连接读到的数据原样发给peer，不再调用MessageCallback，双向转发的话两边各调用一次
+    // 两个连接在同一个loop中时用splice经过内核管道转发，数据不进入用户空间；
+    // 不在同一个loop或者splice不可用的时候退回普通的读到inputBuffer_再send
+    // 会设置peer->setFlowControl(this, ...)：peer还没发出去的数据到了pipeSize就暂停读这个连接
+    // 读到EOF以后等peer的数据发完再shutdown它（半关闭），两个方向都结束了才关闭连接
+    // 要在loop线程中调用，inputBuffer_中已经有的数据先转发出去
+    void relayTo(const TcpConnectionPtr &peer, size_t pipeSize = kDefaultRelayPipeSize);
+    // 是否在用splice转发
+    bool relaySpliced() const { return relayPipe_ != nullptr; }
+    static const size_t kDefaultRelayPipeSize = 256*1024;
+
+    // 上层协议给每个连接保存的状态（比如HttpServer的解析器），随连接一起释放，用的时候static_pointer_cast
+    void setContext(const std::shared_ptr<void> &context) { context_ = context; }
+    const std::shared_ptr<void>& getContext() const { return context_; }
+
+    // 输入/输出缓冲区占用的内存字节数（不包括sendFile的文件块），计入MemoryBudget
+    size_t bufferBytes() const { return static_cast<size_t>(accountedBytes_); }
 
     void setConnectionCallback(const ConnectionCallback& cb)
     { connectionCallback_ = cb; }
@@ -53,6 +126,10 @@ public:
     void setCloseCallback(const CloseCallback& cb)
     { closeCallback_ = cb; }
 
+    // 开启MemoryBudget::kCloseLargest时，读完数据发现超过预算会调用
+    void setMemoryOverBudgetCallback(const MemoryOverBudgetCallback& cb)
+    { memoryOverBudgetCallback_ = cb; }
+
     // 连接建立
     void connectEstablished();
     // 连接销毁
@@ -73,12 +150,50 @@ private:
     void handleError();
 
     void sendInLoop(const void* message, size_t len);
+    void startReadInLoop();
+    void stopReadInLoop();
+    // 流控暂停/恢复读，和用户的startRead/stopRead分开记录，线程安全
+    void setFlowPaused(bool paused);
+    void setFlowPausedInLoop(bool paused);
+    // 根据reading_、flowPaused_和memoryPaused_决定是否关注读事件
+    void updateReadingInLoop();
+    // outputBuffer_的大小变化以后调用：更新内存统计，检查是否要暂停/恢复peer的读
+    void outputSizeChangedInLoop();
+    // 把缓冲区大小的变化记到loop的计数器上
+    void updateMemoryUsageInLoop();
+    // 连接要关闭了，把记过的字节全部减掉
+    void releaseMemoryUsageInLoop();
+    // 读完数据以后按MemoryBudget的策略处理超过预算的情况
+    void checkMemoryBudgetInLoop();
+    void sendStringInLoop(std::string &message);
+    void sendBufferInLoop(Buffer &buf);
+    void sendPayloadInLoop(const PayloadPtr &payload);
+    void sendvInLoop(const struct iovec *iov, int iovcnt);
+    void sendPiecesInLoop(std::vector<std::string> &pieces);
+    void sendFileInLoop(int fd, off_t offset, size_t length);
+    // 同一个loop中的relay把数据splice进pipe以后调用，排在之前所有待发送数据的后面
+    void sendPipeInLoop(const PipePtr &pipe, size_t length);
+    // relay模式下socket可读，splice到管道中交给peer
+    void handleRelayRead();
+    // relay模式下读到EOF
+    void handleRelayEof();
+    // outputBuffer_中刚放入了新数据，之前是空的话先直接写一次，没写完的注册epollout
+    void writeQueuedInLoop(size_t oldLen);
+    bool writeOutputInLoop();
+    void scheduleFlushInLoop();
+    void flushInLoop();
     void shutdownInLoop();
+    void forceCloseInLoop();
     // 这里的loop是subloop
     EventLoop *loop_; 
     const std::string name_;
     std::atomic_int state_;
-    bool reading_;
+    bool reading_;      // 用户希望的读状态
+    bool flowPaused_;   // 因为peer的待发送数据太多被流控暂停了读
+    bool memoryPaused_; // 因为超过内存预算暂停了读
+    bool rxTimestamping_; // 是否读内核的接收时间戳
+    bool cork_;         // 是否开启了cork
+    bool flushPending_; // 本轮循环是否已经安排了flush
 
     // 这里和Acceptor很相似，因为Acceptor和mainloop相关，TcpConnection和subloop相关
     std::unique_ptr<Socket> socket_;
@@ -93,8 +208,23 @@ private:
     WriteCompleteCallback writeCompleteCallback_; // 消息发送完成以后的回调
     HighWaterMarkCallback highWaterMarkCallback_;
     CloseCallback closeCallback_;
+    MemoryOverBudgetCallback memoryOverBudgetCallback_;
     size_t highWaterMark_;
+    std::weak_ptr<TcpConnection> flowControlPeer_;
+    size_t flowControlHigh_; // 0表示没有开启自动流控
+    size_t flowControlLow_;
+    bool peerPaused_;
+    size_t maxReadBytes_;  // 每一轮最多读多少字节
+    size_t maxWriteBytes_; // 每一轮最多写多少字节
+    int64_t accountedBytes_; // 已经记到loop上的缓冲区字节数
+
+    bool relaying_;       // 是否调用过relayTo
+    bool relayReadDone_;  // relay读到了EOF，不再读
+    std::weak_ptr<TcpConnection> relayPeer_;
+    PipePtr relayPipe_;   // 用splice转发时的管道，为空表示普通的拷贝转发
+
+    std::shared_ptr<void> context_;
 
     Buffer inputBuffer_;  // 读 接受数据的缓冲区
-    Buffer outputBuffer_; // 写 发送数据的缓冲区
+    OutputQueue outputBuffer_; // 写 发送数据的缓冲区，按块排队
 };
\ No newline at end of file
@@ -1,8 +1,10 @@
 #include "TcpServer.h"
 #include "Logger.h"
 #include "TcpConnection.h"
+#include "MemoryBudget.h"
 
 #include <strings.h>
+#include <unistd.h>
 #include <functional>
 
 static EventLoop* CheckLoopNotNull(EventLoop *loop)
@@ -25,8 +27,9 @@ TcpServer::TcpServer(EventLoop *loop,
                 , threadPool_(new EventLoopThreadPool(loop, name_))
                 , connectionCallback_()
                 , messageCallback_()
-                , nextConnId_(1)
                 , started_(0)
+                , nextConnId_(1)
+                , rxTimestamping_(false)
 {
     // 当有新用户连接时候，会执行该回调函数
     acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, 
@@ -61,6 +64,10 @@ void TcpServer::start()
     if (started_++ == 0) 
     {
         threadPool_->start(threadInitCallback_); // 启动底层的loop线程池
+        for (EventLoop *ioLoop : threadPool_->getAllLoops())
+        {
+            loopConnections_[ioLoop];
+        }
         loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
     }
 }
@@ -68,6 +75,16 @@ void TcpServer::start()
 // 有一个新客户端的连接，就会执行这个回调操作
 void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 {
+    // 缓冲区内存超过预算，不再接受新连接
+    if (MemoryBudget::instance().exceeded(MemoryBudget::kRejectConnections))
+    {
+        LOG_ERROR("TcpServer::newConnection [%s] - reject %s, buffer memory %ld over budget %lu \n",
+            name_.c_str(), peerAddr.toIpPort().c_str(),
+            (long)MemoryBudget::instance().usage(), MemoryBudget::instance().limit());
+        ::close(sockfd);
+        return;
+    }
+
     // 轮询算法选择一个subloop来管理对应的这个新连接
     EventLoop *ioLoop = threadPool_->getNextLoop(); 
     char buf[64] = {0};
@@ -100,14 +117,22 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    if (rxTimestamping_)
+    {
+        conn->setRxTimestamping(true);
+    }
+    // 多出来的conn参数被bind忽略
+    conn->setMemoryOverBudgetCallback(
+        std::bind(&TcpServer::closeLargestInLoop, &loopConnections_[ioLoop])
+    );
 
     // 设置了如何关闭连接的回调
     conn->setCloseCallback(
         std::bind(&TcpServer::removeConnection, this, std::placeholders::_1)
     );
 
-    // 直接调用connectEstablished
-    ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+    // 在ioLoop中登记这个连接，再调用connectEstablished
+    ioLoop->runInLoop(std::bind(&TcpServer::connectEstablishedInLoop, &loopConnections_[ioLoop], conn));
 }
 
 void TcpServer::removeConnection(const TcpConnectionPtr &conn)
@@ -125,6 +150,59 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
     connections_.erase(conn->name());
     EventLoop *ioLoop = conn->getLoop(); 
     ioLoop->queueInLoop(
-        std::bind(&TcpConnection::connectDestroyed, conn)
+        std::bind(&TcpServer::connectDestroyedInLoop, &loopConnections_[ioLoop], conn)
     );
-}
\ No newline at end of file
+}
+
+void TcpServer::connectEstablishedInLoop(ConnectionSet *conns, const TcpConnectionPtr &conn)
+{
+    conns->insert(conn);
+    conn->connectEstablished();
+}
+
+void TcpServer::connectDestroyedInLoop(ConnectionSet *conns, const TcpConnectionPtr &conn)
+{
+    conns->erase(conn);
+    conn->connectDestroyed();
+}
+
+void TcpServer::broadcast(const PayloadPtr &payload, const BroadcastFilter &filter)
+{
+    for (auto &item : loopConnections_)
+    {
+        item.first->runInLoop(
+            std::bind(&TcpServer::broadcastInLoop, &item.second, payload, filter)
+        );
+    }
+}
+
+void TcpServer::broadcastInLoop(ConnectionSet *conns, const PayloadPtr &payload, const BroadcastFilter &filter)
+{
+    for (const TcpConnectionPtr &conn : *conns)
+    {
+        if (conn->connected() && (!filter || filter(conn)))
+        {
+            conn->send(payload);
+        }
+    }
+}
+
+void TcpServer::closeLargestInLoop(ConnectionSet *conns)
+{
+    TcpConnectionPtr largest;
+    for (const TcpConnectionPtr &conn : *conns)
+    {
+        // 正在关闭的连接跳过，否则每次都会选中同一个
+        if (conn->connected() && (!largest || conn->bufferBytes() > largest->bufferBytes()))
+        {
+            largest = conn;
+        }
+    }
+    if (largest)
+    {
+        LOG_ERROR("TcpServer::closeLargestInLoop - close %s holding %lu bytes, buffer memory %ld over budget %lu \n",
+            largest->name().c_str(), largest->bufferBytes(),
+            (long)MemoryBudget::instance().usage(), MemoryBudget::instance().limit());
+        largest->forceClose();
+    }
+}
@@ -30,12 +30,15 @@
 #include <memory>
 #include <atomic>
 #include <unordered_map>
+#include <unordered_set>
 
 // 对外的服务器编程使用的类
 class TcpServer : noncopyable
 {
 public:
     using ThreadInitCallback = std::function<void(EventLoop*)>;
+    // 广播时在连接所在的loop线程中调用，返回true才发给这个连接
+    using BroadcastFilter = std::function<bool(const TcpConnectionPtr&)>;
 	// 是否重用端口	
     enum Option
     {
@@ -54,18 +57,33 @@ public:
     void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
     void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
     void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+    // 新连接都开启内核接收时间戳，见TcpConnection::setRxTimestamping，在start之前调用
+    void setRxTimestamping(bool on) { rxTimestamping_ = on; }
 
     // 设置底层subloop的个数
     void setThreadNum(int numThreads);
 
     // 开启服务器监听
     void start();
+
+    // 把payload发给所有连接（或者filter返回true的连接），线程安全
+    // 每个subloop只投递一个任务，在loop线程中遍历自己的连接发送，所有连接共享同一份payload
+    void broadcast(const PayloadPtr &payload, const BroadcastFilter &filter = BroadcastFilter());
 private:
     void newConnection(int sockfd, const InetAddress &peerAddr);
     void removeConnection(const TcpConnectionPtr &conn);
     void removeConnectionInLoop(const TcpConnectionPtr &conn);
 
     using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+    // 每个loop自己的连接，只在该loop线程中修改和遍历，所以不用加锁
+    using ConnectionSet = std::unordered_set<TcpConnectionPtr>;
+    using LoopConnectionMap = std::unordered_map<EventLoop*, ConnectionSet>;
+
+    static void connectEstablishedInLoop(ConnectionSet *conns, const TcpConnectionPtr &conn);
+    static void connectDestroyedInLoop(ConnectionSet *conns, const TcpConnectionPtr &conn);
+    static void broadcastInLoop(ConnectionSet *conns, const PayloadPtr &payload, const BroadcastFilter &filter);
+    // 超过内存预算时关闭本loop中缓冲区占用最大的连接
+    static void closeLargestInLoop(ConnectionSet *conns);
 	// 用户定义的loop	baseLoop
     EventLoop *loop_; 
 
@@ -75,6 +93,10 @@ private:
 	// 运行在mainloop，任务就是监听新连接
     std::unique_ptr<Acceptor> acceptor_; 
 
+    // start()的时候为每个loop建好，之后这个map本身不再改变
+    // 放在threadPool_前面，析构的时候loop线程都已经退出了
+    LoopConnectionMap loopConnections_;
+
     std::shared_ptr<EventLoopThreadPool> threadPool_; // one loop per thread
 
     ConnectionCallback connectionCallback_; // 有新连接时的回调
@@ -86,5 +108,6 @@ private:
     std::atomic_int started_;
 
     int nextConnId_;
+    bool rxTimestamping_;
     ConnectionMap connections_; // 保存所有的连接
 };
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <functional>
+#include <condition_variable>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <string>
+
+/**
+ *  固定数量的工作线程，从一个任务队列中取任务执行，给不能在IO线程中做的计算或者阻塞操作用
+ *  - maxQueueSize为0表示队列不限长度，否则队列满的时候run会阻塞，对提交任务的线程形成反压
+ *  - start(0)不创建线程，run直接在调用者线程中执行任务
+ */
+class ThreadPool : noncopyable
+{
+public:
+    using Task = std::function<void()>;
+    using ThreadInitCallback = std::function<void()>;
+
+    explicit ThreadPool(const std::string &name = std::string("ThreadPool"));
+    ~ThreadPool();
+
+    // 在start之前设置
+    void setMaxQueueSize(size_t maxSize) { maxQueueSize_ = maxSize; }
+    void setThreadInitCallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
+
+    void start(int numThreads);
+    // 等队列中已经提交的任务都执行完再退出
+    void stop();
+
+    void run(Task task);
+
+    size_t queueSize() const;
+    const std::string& name() const { return name_; }
+private:
+    bool isFull() const { return maxQueueSize_ > 0 && queue_.size() >= maxQueueSize_; }
+    void runInThread();
+    bool take(Task *task);
+
+    std::string name_;
+    ThreadInitCallback threadInitCallback_;
+    std::vector<std::unique_ptr<Thread>> threads_;
+    mutable std::mutex mutex_; // 保护下面的成员
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    std::deque<Task> queue_;
+    size_t maxQueueSize_;
+    bool running_;
+};
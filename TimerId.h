@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+
+// 定时器的标识，EventLoop::cancel用，默认构造的是无效的
+class TimerId
+{
+public:
+    TimerId() : sequence_(0) {}
+    explicit TimerId(int64_t sequence) : sequence_(sequence) {}
+
+    int64_t sequence() const { return sequence_; }
+    bool valid() const { return sequence_ > 0; }
+private:
+    int64_t sequence_;
+};
@@ -0,0 +1,150 @@
+#include "TimerQueue.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+std::atomic<int64_t> TimerQueue::s_numCreated(0);
+
+static int createTimerfd()
+{
+    int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerfd < 0)
+    {
+        LOG_FATAL("timerfd_create error:%d \n", errno);
+    }
+    return timerfd;
+}
+
+TimerQueue::TimerQueue(EventLoop *loop)
+    : loop_(loop)
+    , timerfd_(createTimerfd())
+    , timerfdChannel_(loop, timerfd_)
+    , callingExpiredTimers_(false)
+{
+    timerfdChannel_.setReadCallback(std::bind(&TimerQueue::handleRead, this));
+    timerfdChannel_.enableReading();
+}
+
+TimerQueue::~TimerQueue()
+{
+    timerfdChannel_.disableAll();
+    timerfdChannel_.remove();
+    ::close(timerfd_);
+}
+
+TimerId TimerQueue::addTimer(TimerCallback cb, Timestamp when, double interval)
+{
+    const int64_t sequence = ++s_numCreated;
+    auto timer = std::make_shared<Timer>();
+    timer->callback = std::move(cb);
+    timer->expiration = when;
+    timer->interval = interval;
+    loop_->runInLoop([this, sequence, timer]()
+    {
+        addTimerInLoop(sequence, *timer);
+    });
+    return TimerId(sequence);
+}
+
+void TimerQueue::cancel(TimerId timerId)
+{
+    if (!timerId.valid())
+    {
+        return;
+    }
+    loop_->runInLoop(std::bind(&TimerQueue::cancelInLoop, this, timerId.sequence()));
+}
+
+void TimerQueue::addTimerInLoop(int64_t sequence, Timer &timer)
+{
+    const bool earliestChanged = queue_.empty() || timer.expiration < queue_.begin()->first;
+    queue_.insert(Entry(timer.expiration, sequence));
+    timers_[sequence] = std::move(timer);
+    if (earliestChanged)
+    {
+        resetTimerfd();
+    }
+}
+
+void TimerQueue::cancelInLoop(int64_t sequence)
+{
+    auto it = timers_.find(sequence);
+    if (it != timers_.end())
+    {
+        queue_.erase(Entry(it->second.expiration, sequence));
+        timers_.erase(it);
+    }
+    else if (callingExpiredTimers_)
+    {
+        // 正在执行的定时器已经从timers_中取出来了，记下来，周期定时器就不再加回去
+        cancelingTimers_.insert(sequence);
+    }
+}
+
+void TimerQueue::handleRead()
+{
+    uint64_t howmany = 0;
+    ssize_t n = ::read(timerfd_, &howmany, sizeof howmany);
+    if (n != sizeof howmany)
+    {
+        LOG_ERROR("TimerQueue::handleRead() reads %ld bytes instead of 8 \n", (long)n);
+    }
+
+    // 先把所有到期的取出来再执行，回调中添加或者取消定时器不会影响这次遍历
+    const Timestamp now = Timestamp::now();
+    std::vector<std::pair<int64_t, Timer>> expired;
+    while (!queue_.empty() && queue_.begin()->first <= now)
+    {
+        const int64_t sequence = queue_.begin()->second;
+        queue_.erase(queue_.begin());
+        auto it = timers_.find(sequence);
+        expired.emplace_back(sequence, std::move(it->second));
+        timers_.erase(it);
+    }
+
+    callingExpiredTimers_ = true;
+    cancelingTimers_.clear();
+    for (auto &item : expired)
+    {
+        item.second.callback();
+    }
+    callingExpiredTimers_ = false;
+
+    // 周期定时器算好下一次的时间再放回去
+    for (auto &item : expired)
+    {
+        Timer &timer = item.second;
+        if (timer.interval > 0 && cancelingTimers_.find(item.first) == cancelingTimers_.end())
+        {
+            timer.expiration = addTime(now, timer.interval);
+            queue_.insert(Entry(timer.expiration, item.first));
+            timers_[item.first] = std::move(timer);
+        }
+    }
+    resetTimerfd();
+}
+
+void TimerQueue::resetTimerfd()
+{
+    struct itimerspec newValue;
+    ::memset(&newValue, 0, sizeof newValue);
+    if (!queue_.empty())
+    {
+        // 最少100微秒，it_value全0表示停止定时器
+        int64_t micros = queue_.begin()->first - Timestamp::now();
+        if (micros < 100)
+        {
+            micros = 100;
+        }
+        newValue.it_value.tv_sec = static_cast<time_t>(micros / Timestamp::kMicroSecondsPerSecond);
+        newValue.it_value.tv_nsec = static_cast<long>(micros % Timestamp::kMicroSecondsPerSecond * 1000);
+    }
+    if (::timerfd_settime(timerfd_, 0, &newValue, nullptr) < 0)
+    {
+        LOG_ERROR("timerfd_settime error:%d \n", errno);
+    }
+}
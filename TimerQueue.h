@@ -0,0 +1,61 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "TimerId.h"
+#include "Channel.h"
+
+#include <atomic>
+#include <functional>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+class EventLoop;
+
+/**
+ *  EventLoop的定时器，用一个timerfd注册到poller上，timerfd总是设置成最早到期的那个定时器的时间
+ *  到期的时候在loop线程中执行回调，addTimer和cancel是线程安全的（转到loop线程中执行）
+ */
+class TimerQueue : noncopyable
+{
+public:
+    using TimerCallback = std::function<void()>;
+
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+    // interval大于0的是周期定时器
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+    void cancel(TimerId timerId);
+private:
+    struct Timer
+    {
+        TimerCallback callback;
+        Timestamp expiration;
+        double interval;
+    };
+    // 按到期时间排序，同一时间按序号排
+    using Entry = std::pair<Timestamp, int64_t>;
+
+    void addTimerInLoop(int64_t sequence, Timer &timer);
+    void cancelInLoop(int64_t sequence);
+    // timerfd可读，说明有定时器到期了
+    void handleRead();
+    // 把timerfd设置成最早的那个定时器的到期时间
+    void resetTimerfd();
+
+    EventLoop *loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+
+    std::set<Entry> queue_;
+    std::unordered_map<int64_t, Timer> timers_;
+
+    bool callingExpiredTimers_;
+    std::unordered_set<int64_t> cancelingTimers_; // 在自己的回调中被取消的周期定时器，不再重新加入
+
+    static std::atomic<int64_t> s_numCreated;
+};
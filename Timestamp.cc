@@ -1,6 +1,75 @@
 #include "Timestamp.h"
 
-#include <time.h>
+#include <atomic>
+#include <string.h>
+#include <stdio.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+namespace
+{
+// TSC到微秒的换算：now = baseMicros + (tsc - baseTsc) * microsPerTick
+// 开启以后这几个值不再修改，usingTsc用release/acquire保证其他线程看到的是校准好的值
+std::atomic_bool s_useTsc(false);
+uint64_t s_baseTsc = 0;
+int64_t s_baseMicros = 0;
+double s_microsPerTick = 0;
+
+// 每个线程缓存上一次格式化的秒："2026/10/19 16:07:00"
+__thread time_t t_lastSecond = -1;
+__thread char t_secondsText[32];
+__thread size_t t_secondsTextLen = 0;
+
+int64_t realtimeMicros()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * Timestamp::kMicroSecondsPerSecond + ts.tv_nsec / 1000;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+bool hasInvariantTsc()
+{
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007)
+    {
+        return false;
+    }
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return (edx & (1u << 8)) != 0;
+}
+
+bool calibrateTsc()
+{
+    if (!hasInvariantTsc())
+    {
+        return false;
+    }
+    // 用CLOCK_MONOTONIC_RAW测一段时间内TSC走了多少，不受NTP调频的影响
+    struct timespec start, end;
+    ::clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+    const uint64_t tscStart = __rdtsc();
+    do
+    {
+        ::clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+    } while ((end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec) < 20 * 1000 * 1000);
+    const uint64_t tscEnd = __rdtsc();
+    const double elapsedMicros = ((end.tv_sec - start.tv_sec) * 1000000000.0 + (end.tv_nsec - start.tv_nsec)) / 1000.0;
+    if (tscEnd <= tscStart)
+    {
+        return false;
+    }
+    s_microsPerTick = elapsedMicros / static_cast<double>(tscEnd - tscStart);
+    s_baseTsc = __rdtsc();
+    s_baseMicros = realtimeMicros();
+    return true;
+}
+#else
+bool calibrateTsc() { return false; }
+#endif
+}
 
 Timestamp::Timestamp():microSecondsSinceEpoch_(0) {}
 
@@ -10,27 +79,93 @@ Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
 
 Timestamp Timestamp::now()
 {
-    return Timestamp(time(NULL));
+#if defined(__x86_64__) || defined(__i386__)
+    if (s_useTsc.load(std::memory_order_acquire))
+    {
+        // 按有符号数算，别的核上的TSC比校准时的略小也不会溢出
+        const int64_t ticks = static_cast<int64_t>(__rdtsc() - s_baseTsc);
+        return Timestamp(s_baseMicros + static_cast<int64_t>(ticks * s_microsPerTick));
+    }
+#endif
+    return Timestamp(realtimeMicros());
+}
+
+bool Timestamp::useTsc(bool on)
+{
+    if (!on)
+    {
+        s_useTsc.store(false, std::memory_order_release);
+        return true;
+    }
+    if (s_useTsc.load(std::memory_order_acquire))
+    {
+        return true;
+    }
+    if (!calibrateTsc())
+    {
+        return false;
+    }
+    s_useTsc.store(true, std::memory_order_release);
+    return true;
+}
+
+bool Timestamp::usingTsc()
+{
+    return s_useTsc.load(std::memory_order_acquire);
+}
+
+size_t Timestamp::format(char *buf, size_t size, bool showMicroseconds) const
+{
+    const time_t seconds = secondsSinceEpoch();
+    if (seconds != t_lastSecond)
+    {
+		// localtime_r 使用 seconds 的值来填充 tm 结构，每个线程每秒只调用一次
+        struct tm tm_time;
+        ::localtime_r(&seconds, &tm_time);
+        int n = snprintf(t_secondsText, sizeof t_secondsText, "%4d/%02d/%02d %02d:%02d:%02d",
+            tm_time.tm_year + 1900,
+            tm_time.tm_mon + 1,
+            tm_time.tm_mday,
+            tm_time.tm_hour,
+            tm_time.tm_min,
+            tm_time.tm_sec);
+        t_secondsTextLen = n > 0 ? static_cast<size_t>(n) : 0;
+        t_lastSecond = seconds;
+    }
+
+    const size_t len = t_secondsTextLen + (showMicroseconds ? 7 : 0);
+    if (size <= len)
+    {
+        if (size > 0)
+        {
+            buf[0] = '\0';
+        }
+        return 0;
+    }
+    ::memcpy(buf, t_secondsText, t_secondsTextLen);
+    if (showMicroseconds)
+    {
+        int micro = static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
+        char *p = buf + t_secondsTextLen;
+        p[0] = '.';
+        for (int i = 6; i >= 1; --i)
+        {
+            p[i] = static_cast<char>('0' + micro % 10);
+            micro /= 10;
+        }
+    }
+    buf[len] = '\0';
+    return len;
 }
 
 std::string Timestamp::toString() const
 {
-    char buf[128] = {0};
-	// struct tm *localtime(const time_t *timer) 使用 timer 的值来填充 tm 结构
-    tm *tm_time = localtime(&microSecondsSinceEpoch_);
-    snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d", 
-        tm_time->tm_year + 1900,
-        tm_time->tm_mon + 1,
-        tm_time->tm_mday,
-        tm_time->tm_hour,
-        tm_time->tm_min,
-        tm_time->tm_sec);
-    return buf;
-}
-
-// #include <iostream>
-// int main()
-// {
-//     std::cout << Timestamp::now().toString() << std::endl; 
-//     return 0;
-// }
\ No newline at end of file
+    return toFormattedString(false);
+}
+
+std::string Timestamp::toFormattedString(bool showMicroseconds) const
+{
+    char buf[64];
+    size_t n = format(buf, sizeof buf, showMicroseconds);
+    return std::string(buf, n);
+}
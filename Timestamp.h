@@ -2,15 +2,70 @@
 
 #include <iostream>
 #include <string>
+#include <stdint.h>
+#include <time.h>
 
-// 时间类
+// 时间类，精确到微秒
 class Timestamp
 {
 public:
+    static const int kMicroSecondsPerSecond = 1000 * 1000;
+
     Timestamp();
     explicit Timestamp(int64_t microSecondsSinceEpoch);
+    // clock_gettime(CLOCK_REALTIME)走vDSO，不陷入内核；开启了TSC以后直接读CPU的时间戳计数器
     static Timestamp now();
+    static Timestamp invalid() { return Timestamp(); }
+    static Timestamp fromUnixTime(time_t t, int microseconds = 0)
+    {
+        return Timestamp(static_cast<int64_t>(t) * kMicroSecondsPerSecond + microseconds);
+    }
+
+    // 用校准过的TSC作为now()的时钟源，CPU不支持不变的TSC（invariant TSC）时返回false
+    // 校准要花十几毫秒，在程序启动的时候调用；校准以后不再跟随NTP对系统时间的调整
+    static bool useTsc(bool on);
+    static bool usingTsc();
+
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+    time_t secondsSinceEpoch() const
+    { return static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond); }
+
+    // 2026/10/19 16:07:00
     std::string toString() const;
+    // 2026/10/19 16:07:00.123456
+    std::string toFormattedString(bool showMicroseconds = true) const;
+    // 格式化到buf中，返回写了多少字节（不含'\0'），buf至少32字节
+    // 每个线程缓存了上一次格式化的秒，同一秒内只拼接微秒，不再调用localtime_r
+    size_t format(char *buf, size_t size, bool showMicroseconds = true) const;
 private:
     int64_t microSecondsSinceEpoch_;
-};
\ No newline at end of file
+};
+
+inline bool operator<(Timestamp lhs, Timestamp rhs)
+{ return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch(); }
+inline bool operator>(Timestamp lhs, Timestamp rhs) { return rhs < lhs; }
+inline bool operator<=(Timestamp lhs, Timestamp rhs) { return !(rhs < lhs); }
+inline bool operator>=(Timestamp lhs, Timestamp rhs) { return !(lhs < rhs); }
+inline bool operator==(Timestamp lhs, Timestamp rhs)
+{ return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch(); }
+inline bool operator!=(Timestamp lhs, Timestamp rhs) { return !(lhs == rhs); }
+
+// 两个时间相差的微秒数
+inline int64_t operator-(Timestamp high, Timestamp low)
+{ return high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch(); }
+inline Timestamp operator+(Timestamp t, int64_t microseconds)
+{ return Timestamp(t.microSecondsSinceEpoch() + microseconds); }
+inline Timestamp operator-(Timestamp t, int64_t microseconds)
+{ return Timestamp(t.microSecondsSinceEpoch() - microseconds); }
+
+// 两个时间相差的秒数
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+    return static_cast<double>(high - low) / Timestamp::kMicroSecondsPerSecond;
+}
+
+inline Timestamp addTime(Timestamp t, double seconds)
+{
+    return t + static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+}
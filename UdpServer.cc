@@ -0,0 +1,89 @@
+#include "UdpServer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+UdpServer::UdpServer(EventLoop *loop,
+                const InetAddress &listenAddr,
+                const std::string &name)
+    : loop_(loop)
+    , listenAddr_(listenAddr)
+    , name_(name)
+    , threadPool_(new EventLoopThreadPool(loop, name))
+    , batchSize_(UdpSocket::kDefaultBatchSize)
+    , maxDatagramSize_(UdpSocket::kDefaultMaxDatagramSize)
+    , gro_(false)
+    , gso_(false)
+    , started_(0)
+{
+}
+
+UdpServer::~UdpServer()
+{
+    for (UdpSocket *socket : sockets_)
+    {
+        EventLoop *ioLoop = socket->getLoop();
+        if (ioLoop->isInLoopThread())
+        {
+            // baseloop上的socket，baseloop可能已经退出了，queueInLoop的任务不会再执行
+            delete socket;
+        }
+        else
+        {
+            // 排在socket已经投递的发送任务后面析构，threadPool_析构的时候loop线程会先执行完这些任务再退出
+            ioLoop->queueInLoop(std::bind(&UdpServer::destroySocket, socket));
+        }
+    }
+}
+
+void UdpServer::start()
+{
+    if (started_++ == 0)
+    {
+        threadPool_->start(threadInitCallback_);
+        std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+        for (EventLoop *ioLoop : loops)
+        {
+            UdpSocket *socket = new UdpSocket(ioLoop, listenAddr_, loops.size() > 1);
+            socket->setMessageCallback(messageCallback_);
+            socket->setBatchSize(batchSize_);
+            socket->setMaxDatagramSize(maxDatagramSize_);
+            socket->setGso(gso_);
+            if (gro_ && !socket->setGro(true))
+            {
+                LOG_ERROR("UdpServer::start [%s] - UDP_GRO is not supported \n", name_.c_str());
+            }
+            sockets_.push_back(socket);
+            socket->start();
+        }
+    }
+}
+
+uint64_t UdpServer::packetsReceived() const
+{
+    uint64_t total = 0;
+    for (UdpSocket *socket : sockets_)
+    {
+        total += socket->packetsReceived();
+    }
+    return total;
+}
+
+uint64_t UdpServer::packetsSent() const
+{
+    uint64_t total = 0;
+    for (UdpSocket *socket : sockets_)
+    {
+        total += socket->packetsSent();
+    }
+    return total;
+}
+
+uint64_t UdpServer::packetsDropped() const
+{
+    uint64_t total = 0;
+    for (UdpSocket *socket : sockets_)
+    {
+        total += socket->packetsDropped();
+    }
+    return total;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "UdpSocket.h"
+#include "EventLoopThreadPool.h"
+#include "InetAddress.h"
+
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <string>
+
+class EventLoop;
+
+/**
+ *  UDP服务器：每个subloop一个UdpSocket，都用SO_REUSEPORT绑定同一个端口，
+ *  内核按四元组的哈希把数据报分到各个socket上，同一个对端的数据报总是在同一个loop中处理
+ *  没有subloop的时候只在baseloop上开一个socket
+ *  回复直接用回调中的UdpSocket::send，在同一个loop中攒起来批量发送
+ *
+ *  UdpServer要在baseloop线程中析构
+ */
+class UdpServer : noncopyable
+{
+public:
+    using ThreadInitCallback = std::function<void(EventLoop*)>;
+
+    UdpServer(EventLoop *loop,
+            const InetAddress &listenAddr,
+            const std::string &name);
+    ~UdpServer();
+
+    // 下面的设置都在start之前调用
+    void setThreadNum(int numThreads) { threadPool_->setThreadNum(numThreads); }
+    void setThreadInitCallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
+    void setMessageCallback(const UdpSocket::UdpMessageCallback &cb) { messageCallback_ = cb; }
+    void setBatchSize(int batchSize) { batchSize_ = batchSize; }
+    void setMaxDatagramSize(size_t maxSize) { maxDatagramSize_ = maxSize; }
+    void setGro(bool on) { gro_ = on; }
+    void setGso(bool on) { gso_ = on; }
+
+    void start();
+
+    EventLoop* getLoop() const { return loop_; }
+    const std::string& name() const { return name_; }
+    // 所有socket的统计之和，线程安全
+    uint64_t packetsReceived() const;
+    uint64_t packetsSent() const;
+    uint64_t packetsDropped() const;
+private:
+    static void destroySocket(UdpSocket *socket) { delete socket; }
+
+    EventLoop *loop_;
+    const InetAddress listenAddr_;
+    const std::string name_;
+    std::shared_ptr<EventLoopThreadPool> threadPool_;
+    ThreadInitCallback threadInitCallback_;
+    UdpSocket::UdpMessageCallback messageCallback_;
+    int batchSize_;
+    size_t maxDatagramSize_;
+    bool gro_;
+    bool gso_;
+    std::atomic_int started_;
+    std::vector<UdpSocket*> sockets_; // start以后不再变化，每个socket在自己的loop中析构
+};
@@ -0,0 +1,398 @@
+#include "UdpSocket.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+namespace
+{
+
+const int kMaxBatchesPerRead = 8;       // 一次可读事件最多调用几次recvmmsg，不要饿死同一个loop上的其他fd
+const size_t kSendBatch = 256;          // 一次sendmmsg最多几个消息
+const size_t kMaxUdpPayload = 65507;
+const size_t kGroBufferSize = 65536;    // GRO合并以后的数据报最大是64K
+const size_t kGsoMaxSegments = 64;      // 老内核的UDP_MAX_SEGMENTS
+const size_t kGsoMaxBytes = 65000;
+
+int createNonblockingUdp()
+{
+    int sockfd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+    if (sockfd < 0)
+    {
+        LOG_FATAL("%s:%s:%d udp socket create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    return sockfd;
+}
+
+bool sameAddress(const sockaddr_in &lhs, const sockaddr_in &rhs)
+{
+    return lhs.sin_addr.s_addr == rhs.sin_addr.s_addr && lhs.sin_port == rhs.sin_port;
+}
+
+} // namespace
+
+const int UdpSocket::kDefaultBatchSize;
+const size_t UdpSocket::kDefaultMaxDatagramSize;
+const size_t UdpSocket::kMaxPendingDatagrams;
+const size_t UdpSocket::kMaxPendingBytes;
+
+UdpSocket::UdpSocket(EventLoop *loop, const InetAddress &bindAddr, bool reusePort)
+    : loop_(loop)
+    , socket_(createNonblockingUdp())
+    , channel_(loop, socket_.fd())
+    , localAddr_(bindAddr)
+    , batchSize_(kDefaultBatchSize)
+    , maxDatagramSize_(kDefaultMaxDatagramSize)
+    , gro_(false)
+    , gso_(false)
+    , pendingHead_(0)
+    , flushPending_(false)
+    , alive_(std::make_shared<bool>(true))
+    , packetsReceived_(0)
+    , packetsSent_(0)
+    , packetsDropped_(0)
+{
+    socket_.setReuseAddr(true);
+    socket_.setReusePort(reusePort);
+    socket_.bindAddress(bindAddr);
+
+    sockaddr_in addr;
+    socklen_t addrlen = sizeof addr;
+    ::memset(&addr, 0, sizeof addr);
+    if (::getsockname(socket_.fd(), (sockaddr*)&addr, &addrlen) == 0)
+    {
+        localAddr_.setSockAddr(addr);
+    }
+
+    channel_.setReadCallback(std::bind(&UdpSocket::handleRead, this, std::placeholders::_1));
+    channel_.setWriteCallback(std::bind(&UdpSocket::handleWrite, this));
+}
+
+UdpSocket::~UdpSocket()
+{
+    // 还没发出去的数据报尽量发掉，发不出去的就丢了
+    if (!pending_.empty())
+    {
+        flushInLoop();
+    }
+    channel_.disableAll();
+    channel_.remove();
+}
+
+bool UdpSocket::setGro(bool on)
+{
+    int optval = on ? 1 : 0;
+    if (::setsockopt(socket_.fd(), SOL_UDP, UDP_GRO, &optval, sizeof optval) < 0)
+    {
+        LOG_ERROR("UdpSocket::setGro fd:%d err:%d \n", socket_.fd(), errno);
+        return false;
+    }
+    gro_ = on;
+    return true;
+}
+
+void UdpSocket::start()
+{
+    loop_->runInLoop(std::bind(&UdpSocket::startInLoop, this));
+}
+
+void UdpSocket::startInLoop()
+{
+    // 每个数据报一个固定大小的槽位，开启GRO以后一个槽位要放得下合并以后的64K
+    const size_t slotSize = gro_ ? kGroBufferSize : maxDatagramSize_;
+    const size_t controlSize = CMSG_SPACE(sizeof(int));
+    recvBuffer_.resize(batchSize_ * slotSize);
+    recvMsgs_.resize(batchSize_);
+    recvIovecs_.resize(batchSize_);
+    recvAddrs_.resize(batchSize_);
+    recvControl_.resize(batchSize_ * controlSize);
+    for (int i = 0; i < batchSize_; ++i)
+    {
+        recvIovecs_[i].iov_base = &recvBuffer_[i * slotSize];
+        recvIovecs_[i].iov_len = slotSize;
+    }
+    channel_.enableReading();
+}
+
+void UdpSocket::handleRead(Timestamp receiveTime)
+{
+    const size_t controlSize = CMSG_SPACE(sizeof(int));
+    for (int round = 0; round < kMaxBatchesPerRead; ++round)
+    {
+        // 内核会改写这些字段，每次都要重新填
+        for (int i = 0; i < batchSize_; ++i)
+        {
+            msghdr &hdr = recvMsgs_[i].msg_hdr;
+            hdr.msg_name = &recvAddrs_[i];
+            hdr.msg_namelen = sizeof(sockaddr_in);
+            hdr.msg_iov = &recvIovecs_[i];
+            hdr.msg_iovlen = 1;
+            hdr.msg_control = gro_ ? &recvControl_[i * controlSize] : nullptr;
+            hdr.msg_controllen = gro_ ? controlSize : 0;
+            hdr.msg_flags = 0;
+        }
+
+        int n = ::recvmmsg(socket_.fd(), recvMsgs_.data(), batchSize_, 0, nullptr);
+        if (n < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                LOG_ERROR("UdpSocket::handleRead fd:%d err:%d \n", socket_.fd(), errno);
+            }
+            break;
+        }
+        for (int i = 0; i < n; ++i)
+        {
+            const msghdr &hdr = recvMsgs_[i].msg_hdr;
+            if (hdr.msg_flags & MSG_TRUNC)
+            {
+                packetsDropped_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            deliver(static_cast<const char*>(recvIovecs_[i].iov_base), recvMsgs_[i].msg_len, hdr, receiveTime);
+        }
+        if (n < batchSize_)
+        {
+            break;
+        }
+    }
+}
+
+void UdpSocket::deliver(const char *data, size_t len, const msghdr &hdr, Timestamp receiveTime)
+{
+    // GRO合并过的数据报带着每一段的大小，最后一段可能小一些
+    size_t segmentSize = len;
+    if (gro_)
+    {
+        for (cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(const_cast<msghdr*>(&hdr), cmsg))
+        {
+            if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+            {
+                int gsoSize = 0;
+                ::memcpy(&gsoSize, CMSG_DATA(cmsg), sizeof gsoSize);
+                if (gsoSize > 0)
+                {
+                    segmentSize = static_cast<size_t>(gsoSize);
+                }
+            }
+        }
+    }
+
+    const InetAddress peer(*static_cast<const sockaddr_in*>(hdr.msg_name));
+    uint64_t count = 0;
+    size_t offset = 0;
+    do
+    {
+        const size_t segment = std::min(segmentSize, len - offset);
+        if (messageCallback_)
+        {
+            messageCallback_(this, data + offset, segment, peer, receiveTime);
+        }
+        offset += segment;
+        ++count;
+    } while (offset < len);
+    packetsReceived_.fetch_add(count, std::memory_order_relaxed);
+}
+
+void UdpSocket::send(const void *data, size_t len, const InetAddress &peer)
+{
+    if (loop_->isInLoopThread())
+    {
+        sendInLoop(data, len, *peer.getSockAddr());
+    }
+    else
+    {
+        loop_->runInLoop(std::bind(&UdpSocket::sendCopyInLoop, this,
+                                std::string(static_cast<const char*>(data), len), *peer.getSockAddr()));
+    }
+}
+
+void UdpSocket::sendCopyInLoop(const std::string &data, const sockaddr_in &peer)
+{
+    sendInLoop(data.data(), data.size(), peer);
+}
+
+void UdpSocket::sendInLoop(const void *data, size_t len, const sockaddr_in &peer)
+{
+    // 只算还没发出去的
+    const size_t sentBytes = pending_.empty() ? 0 : pending_[pendingHead_].offset;
+    if (len > kMaxUdpPayload || pending_.size() - pendingHead_ >= kMaxPendingDatagrams
+        || sendBuffer_.size() - sentBytes + len > kMaxPendingBytes)
+    {
+        packetsDropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    PendingDatagram datagram;
+    datagram.offset = sendBuffer_.size();
+    datagram.len = len;
+    datagram.peer = peer;
+    const char *p = static_cast<const char*>(data);
+    sendBuffer_.insert(sendBuffer_.end(), p, p + len);
+    pending_.push_back(datagram);
+
+    // 本轮事件处理完以后统一发送；在等可写的话handleWrite会发
+    if (!flushPending_ && !channel_.isWriting())
+    {
+        flushPending_ = true;
+        std::weak_ptr<bool> alive(alive_);
+        loop_->queueInLoop([this, alive]() {
+            if (!alive.expired())
+            {
+                flushInLoop();
+            }
+        });
+    }
+}
+
+void UdpSocket::handleWrite()
+{
+    flushInLoop();
+}
+
+void UdpSocket::flushInLoop()
+{
+    flushPending_ = false;
+    size_t sent = pendingHead_;
+    while (sent < pending_.size())
+    {
+        ssize_t n = sendBatch(sent);
+        if (n < 0)
+        {
+            break;
+        }
+        sent += static_cast<size_t>(n);
+    }
+
+    if (sent == pending_.size())
+    {
+        pending_.clear();
+        sendBuffer_.clear();
+        pendingHead_ = 0;
+        if (channel_.isWriting())
+        {
+            channel_.disableWriting();
+        }
+    }
+    else
+    {
+        // 发送缓冲区满了，剩下的等可写；发出去的部分占了一半以上才挪到前面
+        pendingHead_ = sent;
+        const size_t base = pending_[sent].offset;
+        if (base > sendBuffer_.size() / 2)
+        {
+            sendBuffer_.erase(sendBuffer_.begin(), sendBuffer_.begin() + base);
+            pending_.erase(pending_.begin(), pending_.begin() + sent);
+            for (PendingDatagram &datagram : pending_)
+            {
+                datagram.offset -= base;
+            }
+            pendingHead_ = 0;
+        }
+        if (!channel_.isWriting())
+        {
+            channel_.enableWriting();
+        }
+    }
+}
+
+ssize_t UdpSocket::sendBatch(size_t begin)
+{
+    const size_t controlSize = CMSG_SPACE(sizeof(uint16_t));
+    sendMsgs_.resize(kSendBatch);
+    sendIovecs_.resize(kSendBatch);
+    sendControl_.resize(kSendBatch * controlSize);
+    sendSegments_.resize(kSendBatch);
+
+    size_t m = 0;
+    size_t i = begin;
+    while (i < pending_.size() && m < kSendBatch)
+    {
+        PendingDatagram &datagram = pending_[i];
+        size_t count = 1;
+        size_t bytes = datagram.len;
+        // 发给同一个地址的连续数据报，大小相同（最后一个可以小一些）就合并，它们在sendBuffer_中本来就是连续的
+        if (gso_ && datagram.len > 0)
+        {
+            while (i + count < pending_.size() && count < kGsoMaxSegments)
+            {
+                const PendingDatagram &next = pending_[i + count];
+                if (!sameAddress(next.peer, datagram.peer) || next.len == 0 || next.len > datagram.len
+                    || bytes + next.len > kGsoMaxBytes)
+                {
+                    break;
+                }
+                bytes += next.len;
+                ++count;
+                if (next.len < datagram.len)
+                {
+                    break;
+                }
+            }
+        }
+
+        sendIovecs_[m].iov_base = &sendBuffer_[datagram.offset];
+        sendIovecs_[m].iov_len = bytes;
+        msghdr &hdr = sendMsgs_[m].msg_hdr;
+        ::memset(&hdr, 0, sizeof hdr);
+        hdr.msg_name = &datagram.peer;
+        hdr.msg_namelen = sizeof(sockaddr_in);
+        hdr.msg_iov = &sendIovecs_[m];
+        hdr.msg_iovlen = 1;
+        if (count > 1)
+        {
+            hdr.msg_control = &sendControl_[m * controlSize];
+            hdr.msg_controllen = controlSize;
+            cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t segmentSize = static_cast<uint16_t>(datagram.len);
+            ::memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof segmentSize);
+        }
+        sendSegments_[m] = count;
+        i += count;
+        ++m;
+    }
+
+    int n = ::sendmmsg(socket_.fd(), sendMsgs_.data(), static_cast<unsigned int>(m), 0);
+    if (n < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return -1;
+        }
+        // 网卡或者内核不支持GSO，关掉以后重新发
+        if (sendSegments_[0] > 1 && (errno == EIO || errno == EINVAL))
+        {
+            LOG_ERROR("UdpSocket::sendBatch fd:%d GSO failed err:%d, disable GSO \n", socket_.fd(), errno);
+            gso_ = false;
+            return 0;
+        }
+        // 其他错误只影响第一个数据报，丢掉它继续发后面的
+        LOG_ERROR("UdpSocket::sendBatch fd:%d err:%d \n", socket_.fd(), errno);
+        packetsDropped_.fetch_add(sendSegments_[0], std::memory_order_relaxed);
+        return static_cast<ssize_t>(sendSegments_[0]);
+    }
+
+    size_t sent = 0;
+    for (int k = 0; k < n; ++k)
+    {
+        sent += sendSegments_[k];
+    }
+    packetsSent_.fetch_add(sent, std::memory_order_relaxed);
+    return static_cast<ssize_t>(sent);
+}
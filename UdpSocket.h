@@ -0,0 +1,133 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Socket.h"
+#include "Channel.h"
+#include "Timestamp.h"
+
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+class EventLoop;
+
+/**
+ *  绑定在一个EventLoop上的UDP socket，收发都是批量的
+ *
+ *  接收：可读的时候用recvmmsg一次收batchSize个数据报，放在预先分配好的缓冲区池中，
+ *        按顺序交给MessageCallback，data直接指向池中的内存，只在回调期间有效
+ *        开启GRO以后内核会把同一个流的多个数据报合并成一个大的，这里按段大小拆开再交给回调
+ *  发送：loop线程中的send先拷贝到发送缓冲区中排队，本轮事件处理完以后用一次sendmmsg发出去；
+ *        开启GSO以后，发给同一个地址、大小相同的连续数据报合并成一个带UDP_SEGMENT的大数据报，
+ *        由内核（或者网卡）再切开；socket发送缓冲区满了就等可写，排队的数据报个数或者字节数超过上限直接丢掉
+ *  超过maxDatagramSize的数据报会被截断，按丢包计数，不交给回调
+ *
+ *  UdpSocket要在loop线程中析构
+ */
+class UdpSocket : noncopyable
+{
+public:
+    // data只在回调期间有效
+    using UdpMessageCallback = std::function<void (UdpSocket*,
+                                                const char *data,
+                                                size_t len,
+                                                const InetAddress &peer,
+                                                Timestamp receiveTime)>;
+
+    static const int kDefaultBatchSize = 64;
+    static const size_t kDefaultMaxDatagramSize = 2048;
+    static const size_t kMaxPendingDatagrams = 64*1024;
+    static const size_t kMaxPendingBytes = 16*1024*1024;
+
+    // reusePort为true时可以有多个socket绑定同一个端口，内核按四元组的哈希把数据报分给它们
+    UdpSocket(EventLoop *loop, const InetAddress &bindAddr, bool reusePort = false);
+    ~UdpSocket();
+
+    void setMessageCallback(const UdpMessageCallback &cb) { messageCallback_ = cb; }
+    // 下面的设置都在start之前调用
+    void setBatchSize(int batchSize) { batchSize_ = batchSize; }
+    void setMaxDatagramSize(size_t maxSize) { maxDatagramSize_ = maxSize; }
+    // UDP_GRO需要linux 5.0以上，内核不支持返回false
+    bool setGro(bool on);
+    // UDP_SEGMENT需要linux 4.18以上，发送失败时会自动关掉
+    void setGso(bool on) { gso_ = on; }
+
+    // 开始接收，线程安全
+    void start();
+
+    // 线程安全，在其他线程调用时拷贝一次数据
+    void send(const void *data, size_t len, const InetAddress &peer);
+    void send(const std::string &message, const InetAddress &peer)
+    {
+        send(message.data(), message.size(), peer);
+    }
+
+    EventLoop* getLoop() const { return loop_; }
+    int fd() const { return socket_.fd(); }
+    // 绑定的是0端口的话，这里是内核分配的实际端口
+    const InetAddress& localAddress() const { return localAddr_; }
+
+    // 统计，线程安全
+    uint64_t packetsReceived() const { return packetsReceived_.load(std::memory_order_relaxed); }
+    uint64_t packetsSent() const { return packetsSent_.load(std::memory_order_relaxed); }
+    uint64_t packetsDropped() const { return packetsDropped_.load(std::memory_order_relaxed); }
+private:
+    // 排在发送缓冲区中的一个数据报
+    struct PendingDatagram
+    {
+        size_t offset;      // 在sendBuffer_中的位置
+        size_t len;
+        sockaddr_in peer;
+    };
+
+    void startInLoop();
+    void handleRead(Timestamp receiveTime);
+    void handleWrite();
+    void sendInLoop(const void *data, size_t len, const sockaddr_in &peer);
+    void sendCopyInLoop(const std::string &data, const sockaddr_in &peer);
+    void flushInLoop();
+    // 用sendmmsg发送pending_，返回发出去了几个PendingDatagram，-1表示socket缓冲区满了
+    ssize_t sendBatch(size_t begin);
+    void deliver(const char *data, size_t len, const msghdr &hdr, Timestamp receiveTime);
+
+    EventLoop *loop_;
+    Socket socket_;
+    Channel channel_;
+    InetAddress localAddr_;
+    UdpMessageCallback messageCallback_;
+    int batchSize_;
+    size_t maxDatagramSize_;
+    bool gro_;
+    bool gso_;
+
+    // 接收缓冲区池，start的时候按batchSize_和maxDatagramSize_分配，之后一直复用
+    std::vector<char> recvBuffer_;
+    std::vector<mmsghdr> recvMsgs_;
+    std::vector<iovec> recvIovecs_;
+    std::vector<sockaddr_in> recvAddrs_;
+    std::vector<char> recvControl_;
+
+    // 等待sendmmsg的数据报，数据连续地放在sendBuffer_中
+    // pending_[pendingHead_]之前的已经发出去了，发出去的部分超过sendBuffer_的一半才挪走，
+    // 不用每次发送缓冲区满的时候都把剩下的数据往前挪
+    std::vector<char> sendBuffer_;
+    std::vector<PendingDatagram> pending_;
+    size_t pendingHead_;
+    std::vector<mmsghdr> sendMsgs_;
+    std::vector<iovec> sendIovecs_;
+    std::vector<char> sendControl_;
+    std::vector<size_t> sendSegments_; // sendMsgs_中每个消息包含几个PendingDatagram
+    bool flushPending_;
+    // queueInLoop的flushInLoop可能排在析构之后执行，任务里拿它的weak_ptr判断socket还在不在
+    std::shared_ptr<bool> alive_;
+
+    std::atomic<uint64_t> packetsReceived_;
+    std::atomic<uint64_t> packetsSent_;
+    std::atomic<uint64_t> packetsDropped_;
+};
@@ -0,0 +1,432 @@
+#include "WebSocketCodec.h"
+#include "HttpRequest.h"
+#include "Buffer.h"
+#include "TcpConnection.h"
+
+#include <string.h>
+#include <strings.h>
+#include <endian.h>
+#include <sys/uio.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MYMUDUO_X86_SIMD 1
+#endif
+
+namespace
+{
+// ---------------- 去掩码 ----------------
+// 掩码是4个字节循环使用，先把它转到和data对齐的位置上，扩展成8/16/32字节，整块异或
+
+void unmaskScalar(char *p, char *end, uint32_t key)
+{
+    const uint64_t key64 = (static_cast<uint64_t>(key) << 32) | key;
+    for (; p + 8 <= end; p += 8)
+    {
+        uint64_t v;
+        ::memcpy(&v, p, 8);
+        v ^= key64;
+        ::memcpy(p, &v, 8);
+    }
+    const unsigned char *k = reinterpret_cast<const unsigned char*>(&key);
+    for (size_t i = 0; p < end; ++p, ++i)
+    {
+        *p ^= k[i & 3];
+    }
+}
+
+#ifdef MYMUDUO_X86_SIMD
+__attribute__((target("sse2")))
+void unmaskSSE2(char *p, char *end, uint32_t key)
+{
+    const __m128i mask = _mm_set1_epi32(static_cast<int>(key));
+    for (; p + 16 <= end; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_xor_si128(v, mask));
+    }
+    unmaskScalar(p, end, key);
+}
+
+__attribute__((target("avx2")))
+void unmaskAVX2(char *p, char *end, uint32_t key)
+{
+    const __m256i mask = _mm256_set1_epi32(static_cast<int>(key));
+    // 一次处理128个字节，4个独立的异或可以并行
+    for (; p + 128 <= end; p += 128)
+    {
+        __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+        __m256i v2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 64));
+        __m256i v3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 96));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm256_xor_si256(v0, mask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p + 32), _mm256_xor_si256(v1, mask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p + 64), _mm256_xor_si256(v2, mask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p + 96), _mm256_xor_si256(v3, mask));
+    }
+    for (; p + 32 <= end; p += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm256_xor_si256(v, mask));
+    }
+    unmaskSSE2(p, end, key);
+}
+
+bool cpuHasAvx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+const bool kHasAvx2 = cpuHasAvx2();
+#endif // MYMUDUO_X86_SIMD
+
+// ---------------- 握手用的SHA1和base64 ----------------
+// 只在握手的时候算一次，够用就行
+inline uint32_t rol(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+void sha1(const std::string &input, unsigned char digest[20])
+{
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::string msg(input);
+    const uint64_t bitLength = static_cast<uint64_t>(input.size()) * 8;
+    msg.push_back(static_cast<char>(0x80));
+    while (msg.size() % 64 != 56)
+    {
+        msg.push_back('\0');
+    }
+    for (int i = 7; i >= 0; --i)
+    {
+        msg.push_back(static_cast<char>((bitLength >> (i * 8)) & 0xff));
+    }
+
+    for (size_t chunk = 0; chunk < msg.size(); chunk += 64)
+    {
+        uint32_t w[80];
+        const unsigned char *p = reinterpret_cast<const unsigned char*>(msg.data() + chunk);
+        for (int i = 0; i < 16; ++i)
+        {
+            w[i] = (uint32_t(p[4*i]) << 24) | (uint32_t(p[4*i+1]) << 16) | (uint32_t(p[4*i+2]) << 8) | p[4*i+3];
+        }
+        for (int i = 16; i < 80; ++i)
+        {
+            w[i] = rol(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i)
+        {
+            uint32_t f, k;
+            if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else             { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+            uint32_t temp = rol(a, 5) + f + e + k + w[i];
+            e = d; d = c; c = rol(b, 30); b = a; a = temp;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+    for (int i = 0; i < 5; ++i)
+    {
+        digest[4*i] = static_cast<unsigned char>(h[i] >> 24);
+        digest[4*i+1] = static_cast<unsigned char>(h[i] >> 16);
+        digest[4*i+2] = static_cast<unsigned char>(h[i] >> 8);
+        digest[4*i+3] = static_cast<unsigned char>(h[i]);
+    }
+}
+
+std::string base64(const unsigned char *data, size_t len)
+{
+    static const char kTable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((len + 2) / 3 * 4);
+    for (size_t i = 0; i < len; i += 3)
+    {
+        uint32_t n = uint32_t(data[i]) << 16;
+        if (i + 1 < len) n |= uint32_t(data[i+1]) << 8;
+        if (i + 2 < len) n |= data[i+2];
+        out.push_back(kTable[(n >> 18) & 63]);
+        out.push_back(kTable[(n >> 12) & 63]);
+        out.push_back(i + 1 < len ? kTable[(n >> 6) & 63] : '=');
+        out.push_back(i + 2 < len ? kTable[n & 63] : '=');
+    }
+    return out;
+}
+
+bool containsTokenIgnoreCase(const StringPiece &list, const char *token)
+{
+    const size_t len = ::strlen(token);
+    for (size_t i = 0; i + len <= list.size(); ++i)
+    {
+        if (::strncasecmp(list.data() + i, token, len) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+} // namespace
+
+int WebSocketCodec::parseFrameHeader(const char *data, size_t len, FrameHeader *header)
+{
+    if (len < 2)
+    {
+        return 0;
+    }
+    const unsigned char *p = reinterpret_cast<const unsigned char*>(data);
+    header->fin = (p[0] & 0x80) != 0;
+    header->opcode = p[0] & 0x0f;
+    header->masked = (p[1] & 0x80) != 0;
+    // 没有协商扩展，保留位必须是0
+    if (p[0] & 0x70)
+    {
+        return -1;
+    }
+    switch (header->opcode)
+    {
+    case kContinuation: case kText: case kBinary:
+        break;
+    case kClose: case kPing: case kPong:
+        if (!header->fin || (p[1] & 0x7f) > kMaxControlPayload)
+        {
+            return -1;
+        }
+        break;
+    default:
+        return -1;
+    }
+
+    size_t pos = 2;
+    uint64_t payloadLength = p[1] & 0x7f;
+    if (payloadLength == 126)
+    {
+        if (len < pos + 2)
+        {
+            return 0;
+        }
+        uint16_t be16;
+        ::memcpy(&be16, p + pos, 2);
+        payloadLength = be16toh(be16);
+        pos += 2;
+    }
+    else if (payloadLength == 127)
+    {
+        if (len < pos + 8)
+        {
+            return 0;
+        }
+        uint64_t be64;
+        ::memcpy(&be64, p + pos, 8);
+        payloadLength = be64toh(be64);
+        pos += 8;
+        if (payloadLength >> 63)
+        {
+            return -1;
+        }
+    }
+    if (header->masked)
+    {
+        if (len < pos + 4)
+        {
+            return 0;
+        }
+        ::memcpy(header->maskKey, p + pos, 4);
+        pos += 4;
+    }
+    header->payloadLength = payloadLength;
+    header->headerLength = pos;
+    return 1;
+}
+
+bool WebSocketCodec::isValidCloseCode(int code)
+{
+    return (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1011) || (code >= 3000 && code <= 4999);
+}
+
+bool WebSocketCodec::isValidUtf8(const char *data, size_t len)
+{
+    const unsigned char *p = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char *end = p + len;
+    while (p < end)
+    {
+        // 文本大多是ASCII，8个字节一起看最高位
+        if (end - p >= 8)
+        {
+            uint64_t word;
+            ::memcpy(&word, p, 8);
+            if ((word & 0x8080808080808080ULL) == 0)
+            {
+                p += 8;
+                continue;
+            }
+        }
+        const unsigned char c = *p;
+        if (c < 0x80)
+        {
+            ++p;
+            continue;
+        }
+        // 多字节序列的长度，以及第二个字节的范围（排除过长编码、代理项和超过U+10FFFF的码点）
+        size_t n = 0;
+        unsigned char lo = 0x80;
+        unsigned char hi = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF)
+        {
+            n = 2;
+        }
+        else if (c >= 0xE0 && c <= 0xEF)
+        {
+            n = 3;
+            if (c == 0xE0) lo = 0xA0;
+            if (c == 0xED) hi = 0x9F;
+        }
+        else if (c >= 0xF0 && c <= 0xF4)
+        {
+            n = 4;
+            if (c == 0xF0) lo = 0x90;
+            if (c == 0xF4) hi = 0x8F;
+        }
+        else
+        {
+            return false;
+        }
+        if (static_cast<size_t>(end - p) < n || p[1] < lo || p[1] > hi)
+        {
+            return false;
+        }
+        for (size_t i = 2; i < n; ++i)
+        {
+            if ((p[i] & 0xC0) != 0x80)
+            {
+                return false;
+            }
+        }
+        p += n;
+    }
+    return true;
+}
+
+void WebSocketCodec::unmask(char *data, size_t len, const unsigned char key[4], size_t keyOffset)
+{
+    // 把掩码旋转到从data[0]开始，之后按4字节周期整块异或
+    unsigned char rotated[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        rotated[i] = key[(keyOffset + i) & 3];
+    }
+    uint32_t key32;
+    ::memcpy(&key32, rotated, 4);
+#ifdef MYMUDUO_X86_SIMD
+    if (kHasAvx2)
+    {
+        unmaskAVX2(data, data + len, key32);
+    }
+    else
+    {
+        unmaskSSE2(data, data + len, key32);
+    }
+#else
+    unmaskScalar(data, data + len, key32);
+#endif
+}
+
+size_t WebSocketCodec::encodeFrameHeader(char *buf, int opcode, size_t payloadLength, bool fin)
+{
+    unsigned char *p = reinterpret_cast<unsigned char*>(buf);
+    p[0] = static_cast<unsigned char>((fin ? 0x80 : 0) | (opcode & 0x0f));
+    if (payloadLength < 126)
+    {
+        p[1] = static_cast<unsigned char>(payloadLength);
+        return 2;
+    }
+    else if (payloadLength <= 0xffff)
+    {
+        p[1] = 126;
+        uint16_t be16 = htobe16(static_cast<uint16_t>(payloadLength));
+        ::memcpy(p + 2, &be16, 2);
+        return 4;
+    }
+    p[1] = 127;
+    uint64_t be64 = htobe64(static_cast<uint64_t>(payloadLength));
+    ::memcpy(p + 2, &be64, 8);
+    return 10;
+}
+
+void WebSocketCodec::send(const TcpConnectionPtr &conn, int opcode, const void *data, size_t len)
+{
+    char header[kMaxFrameHeaderLength];
+    struct iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = encodeFrameHeader(header, opcode, len);
+    iov[1].iov_base = const_cast<void*>(data);
+    iov[1].iov_len = len;
+    conn->sendv(iov, len > 0 ? 2 : 1);
+}
+
+void WebSocketCodec::send(const TcpConnectionPtr &conn, int opcode, std::string &&payload)
+{
+    char header[kMaxFrameHeaderLength];
+    size_t headerLen = encodeFrameHeader(header, opcode, payload.size());
+    std::vector<std::string> pieces;
+    pieces.reserve(2);
+    pieces.emplace_back(header, headerLen);
+    pieces.push_back(std::move(payload));
+    conn->sendv(std::move(pieces));
+}
+
+void WebSocketCodec::sendClose(const TcpConnectionPtr &conn, int code, const StringPiece &reason)
+{
+    char payload[kMaxControlPayload];
+    payload[0] = static_cast<char>((code >> 8) & 0xff);
+    payload[1] = static_cast<char>(code & 0xff);
+    size_t reasonLen = reason.size() < kMaxControlPayload - 2 ? reason.size() : kMaxControlPayload - 2;
+    ::memcpy(payload + 2, reason.data(), reasonLen);
+    send(conn, kClose, payload, 2 + reasonLen);
+}
+
+PayloadPtr WebSocketCodec::makeFrame(int opcode, const StringPiece &data)
+{
+    char header[kMaxFrameHeaderLength];
+    size_t headerLen = encodeFrameHeader(header, opcode, data.size());
+    std::string frame;
+    frame.reserve(headerLen + data.size());
+    frame.append(header, headerLen);
+    frame.append(data.data(), data.size());
+    return makePayload(std::move(frame));
+}
+
+std::string WebSocketCodec::acceptKey(const StringPiece &key)
+{
+    static const char kGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    unsigned char digest[20];
+    sha1(key.as_string() + kGuid, digest);
+    return base64(digest, sizeof digest);
+}
+
+bool WebSocketCodec::handshake(const HttpRequest &request, Buffer *output)
+{
+    StringPiece key = request.header("Sec-WebSocket-Key");
+    if (request.method() != HttpRequest::kGet
+        || request.version() != HttpRequest::kHttp11
+        || !containsTokenIgnoreCase(request.header("Upgrade"), "websocket")
+        || !containsTokenIgnoreCase(request.header("Connection"), "upgrade")
+        || request.header("Sec-WebSocket-Version") != "13"
+        || key.empty())
+    {
+        return false;
+    }
+
+    std::string accept = acceptKey(key);
+    static const char kResponse[] =
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: ";
+    output->append(kResponse, sizeof kResponse - 1);
+    output->append(accept.data(), accept.size());
+    output->append("\r\n\r\n", 4);
+    return true;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Callbacks.h"
+#include "StringPiece.h"
+
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+class Buffer;
+class HttpRequest;
+
+/**
+ *  WebSocket（RFC 6455）的握手和帧编解码，都是无状态的静态函数，连接的状态由WebSocketServer保存
+ *
+ *  帧格式：
+ *    [FIN RSV1-3 opcode(4)] [MASK len7] [len16 | len64]? [mask key(4)]? [payload]
+ *  客户端发来的帧都带掩码，在Buffer中原地用SSE2/AVX2异或去掉掩码，不拷贝
+ *  服务器发的帧不带掩码，头部最多10个字节，和payload用一次writev发出去
+ */
+class WebSocketCodec
+{
+public:
+    enum Opcode
+    {
+        kContinuation = 0x0,
+        kText = 0x1,
+        kBinary = 0x2,
+        kClose = 0x8,
+        kPing = 0x9,
+        kPong = 0xA,
+    };
+
+    // 关闭帧的状态码
+    enum CloseCode
+    {
+        kNormalClosure = 1000,
+        kGoingAway = 1001,
+        kProtocolError = 1002,
+        kInvalidPayload = 1007,  // 文本消息不是合法的UTF-8
+        kMessageTooBig = 1009,
+    };
+
+    struct FrameHeader
+    {
+        bool fin;
+        int opcode;
+        bool masked;
+        unsigned char maskKey[4];
+        uint64_t payloadLength;
+        size_t headerLength;
+    };
+
+    static const size_t kMaxFrameHeaderLength = 14;
+    // 控制帧的payload最多125个字节
+    static const size_t kMaxControlPayload = 125;
+
+    // 解析帧头，返回1表示帧头完整，0表示数据还不够，-1表示格式错误（保留位不为0、未知的opcode、分片的控制帧等）
+    static int parseFrameHeader(const char *data, size_t len, FrameHeader *header);
+
+    // 对端的关闭帧里可以出现的状态码：1000-1003、1007-1011（RFC 6455 7.4.1）和3000-4999
+    static bool isValidCloseCode(int code);
+    // 严格的UTF-8检查，过长的编码、代理项（U+D800-U+DFFF）和超过U+10FFFF的码点都不合法
+    static bool isValidUtf8(const char *data, size_t len);
+
+    // 原地异或掩码，keyOffset是data[0]对应掩码的第几个字节
+    static void unmask(char *data, size_t len, const unsigned char key[4], size_t keyOffset = 0);
+
+    // 编码不带掩码的帧头，buf至少kMaxFrameHeaderLength个字节，返回帧头长度
+    static size_t encodeFrameHeader(char *buf, int opcode, size_t payloadLength, bool fin = true);
+
+    // 发送一帧，帧头和payload一起writev，data在这一次发不完的时候才拷贝
+    static void send(const TcpConnectionPtr &conn, int opcode, const void *data, size_t len);
+    static void send(const TcpConnectionPtr &conn, int opcode, const StringPiece &data)
+    {
+        send(conn, opcode, data.data(), data.size());
+    }
+    // payload的所有权交给TcpConnection，不拷贝
+    static void send(const TcpConnectionPtr &conn, int opcode, std::string &&payload);
+    // 关闭帧，payload是2字节的状态码加原因
+    static void sendClose(const TcpConnectionPtr &conn, int code, const StringPiece &reason = StringPiece());
+    // 编码成一个完整的帧，给TcpServer::broadcast用，所有连接共享同一份数据
+    static PayloadPtr makeFrame(int opcode, const StringPiece &data);
+
+    // 检查升级请求，合法的话把101响应写到output中返回true
+    static bool handshake(const HttpRequest &request, Buffer *output);
+    // Sec-WebSocket-Accept = base64(sha1(key + GUID))
+    static std::string acceptKey(const StringPiece &key);
+};
@@ -0,0 +1,274 @@
+#include "WebSocketServer.h"
+#include "HttpParser.h"
+#include "HttpResponse.h"
+#include "Logger.h"
+
+// 每个连接的状态，放在TcpConnection的context中，只在连接所在的loop线程中访问
+struct WebSocketServer::Context
+{
+    Context()
+        : upgraded(false)
+        , closeSent(false)
+        , messageOpcode(-1)
+    {}
+
+    HttpParser http;        // 握手之前解析升级请求
+    bool upgraded;
+    bool closeSent;
+    int messageOpcode;      // 正在拼接的分片消息的类型，-1表示没有
+    std::string message;    // 分片消息已经收到的部分
+};
+
+WebSocketServer::WebSocketServer(EventLoop *loop,
+                const InetAddress &listenAddr,
+                const std::string &name,
+                TcpServer::Option option)
+    : server_(loop, listenAddr, name, option)
+    , maxMessageSize_(kDefaultMaxMessageSize)
+{
+    server_.setConnectionCallback(
+        std::bind(&WebSocketServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(
+        std::bind(&WebSocketServer::onMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+void WebSocketServer::start()
+{
+    server_.start();
+}
+
+void WebSocketServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setContext(std::make_shared<Context>());
+    }
+    else if (isUpgraded(conn) && connectionCallback_)
+    {
+        connectionCallback_(conn);
+    }
+}
+
+bool WebSocketServer::isUpgraded(const TcpConnectionPtr &conn)
+{
+    Context *context = static_cast<Context*>(conn->getContext().get());
+    return context != nullptr && context->upgraded;
+}
+
+void WebSocketServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    // 已经在关闭的连接，剩下的数据不再处理
+    if (!conn->connected())
+    {
+        buf->retrieveAll();
+        return;
+    }
+    Context *context = static_cast<Context*>(conn->getContext().get());
+    if (!context->upgraded)
+    {
+        onHandshake(conn, context, buf);
+        if (!context->upgraded)
+        {
+            return;
+        }
+    }
+    // 客户端可能握手请求后面紧跟着就发了帧
+    onFrames(conn, context, buf, receiveTime);
+}
+
+void WebSocketServer::onHandshake(const TcpConnectionPtr &conn, Context *context, Buffer *buf)
+{
+    HttpParser::Result result = context->http.parse(buf);
+    if (result == HttpParser::kNeedMore)
+    {
+        return;
+    }
+
+    Buffer output;
+    if (result == HttpParser::kComplete && WebSocketCodec::handshake(context->http.request(), &output))
+    {
+        buf->retrieve(context->http.requestBytes());
+        conn->send(&output);
+        context->upgraded = true;
+        if (connectionCallback_)
+        {
+            connectionCallback_(conn);
+        }
+        return;
+    }
+
+    LOG_ERROR("WebSocketServer::onHandshake [%s] invalid upgrade request \n", conn->name().c_str());
+    HttpResponse response(true);
+    response.setStatusCode(result == HttpParser::kError ? context->http.errorStatus() : HttpResponse::k400BadRequest);
+    response.addHeader("Sec-WebSocket-Version", "13");
+    response.appendToBuffer(&output);
+    conn->send(&output);
+    buf->retrieveAll();
+    conn->shutdown();
+}
+
+void WebSocketServer::onFrames(const TcpConnectionPtr &conn, Context *context, Buffer *buf, Timestamp receiveTime)
+{
+    while (conn->connected())
+    {
+        WebSocketCodec::FrameHeader header;
+        int result = WebSocketCodec::parseFrameHeader(buf->peek(), buf->readableBytes(), &header);
+        if (result == 0)
+        {
+            break;
+        }
+        // 客户端发的帧必须带掩码
+        if (result < 0 || !header.masked)
+        {
+            failConnection(conn, context, buf, WebSocketCodec::kProtocolError);
+            return;
+        }
+        const size_t pending = context->messageOpcode >= 0 ? context->message.size() : 0;
+        if (header.payloadLength > maxMessageSize_ - pending)
+        {
+            failConnection(conn, context, buf, WebSocketCodec::kMessageTooBig);
+            return;
+        }
+        const size_t payloadLength = static_cast<size_t>(header.payloadLength);
+        const size_t frameLength = header.headerLength + payloadLength;
+        if (buf->readableBytes() < frameLength)
+        {
+            break;
+        }
+
+        // 原地去掉掩码，payload直接指向inputBuffer_
+        char *payload = buf->mutablePeek() + header.headerLength;
+        WebSocketCodec::unmask(payload, payloadLength, header.maskKey);
+        StringPiece data(payload, payloadLength);
+
+        switch (header.opcode)
+        {
+        case WebSocketCodec::kText:
+        case WebSocketCodec::kBinary:
+            if (context->messageOpcode >= 0)
+            {
+                // 上一个分片消息还没有结束
+                failConnection(conn, context, buf, WebSocketCodec::kProtocolError);
+                return;
+            }
+            if (header.fin)
+            {
+                if (header.opcode == WebSocketCodec::kText && !WebSocketCodec::isValidUtf8(data.data(), data.size()))
+                {
+                    failConnection(conn, context, buf, WebSocketCodec::kInvalidPayload);
+                    return;
+                }
+                if (messageCallback_)
+                {
+                    messageCallback_(conn, data, header.opcode == WebSocketCodec::kBinary, receiveTime);
+                }
+            }
+            else
+            {
+                context->messageOpcode = header.opcode;
+                context->message.assign(data.data(), data.size());
+            }
+            break;
+
+        case WebSocketCodec::kContinuation:
+            if (context->messageOpcode < 0)
+            {
+                failConnection(conn, context, buf, WebSocketCodec::kProtocolError);
+                return;
+            }
+            context->message.append(data.data(), data.size());
+            if (header.fin)
+            {
+                if (context->messageOpcode == WebSocketCodec::kText
+                    && !WebSocketCodec::isValidUtf8(context->message.data(), context->message.size()))
+                {
+                    failConnection(conn, context, buf, WebSocketCodec::kInvalidPayload);
+                    return;
+                }
+                if (messageCallback_)
+                {
+                    messageCallback_(conn, context->message,
+                        context->messageOpcode == WebSocketCodec::kBinary, receiveTime);
+                }
+                context->messageOpcode = -1;
+                context->message.clear();
+            }
+            break;
+
+        case WebSocketCodec::kPing:
+            WebSocketCodec::send(conn, WebSocketCodec::kPong, data);
+            break;
+
+        case WebSocketCodec::kPong:
+            break;
+
+        case WebSocketCodec::kClose:
+            // 对端发起的关闭回复同样的状态码（没有状态码就回复1000），我们发起的关闭这里就是对端的确认
+            if (!context->closeSent)
+            {
+                int code = WebSocketCodec::kNormalClosure;
+                if (payloadLength == 1)
+                {
+                    failConnection(conn, context, buf, WebSocketCodec::kProtocolError);
+                    return;
+                }
+                if (payloadLength >= 2)
+                {
+                    code = (static_cast<unsigned char>(data[0]) << 8) | static_cast<unsigned char>(data[1]);
+                    if (!WebSocketCodec::isValidCloseCode(code))
+                    {
+                        failConnection(conn, context, buf, WebSocketCodec::kProtocolError);
+                        return;
+                    }
+                    // 原因也必须是UTF-8
+                    if (!WebSocketCodec::isValidUtf8(data.data() + 2, payloadLength - 2))
+                    {
+                        failConnection(conn, context, buf, WebSocketCodec::kInvalidPayload);
+                        return;
+                    }
+                }
+                WebSocketCodec::sendClose(conn, code);
+                context->closeSent = true;
+            }
+            buf->retrieveAll();
+            conn->shutdown();
+            return;
+        }
+        buf->retrieve(frameLength);
+    }
+}
+
+void WebSocketServer::failConnection(const TcpConnectionPtr &conn, Context *context, Buffer *buf, int code)
+{
+    LOG_ERROR("WebSocketServer::failConnection [%s] close code %d \n", conn->name().c_str(), code);
+    if (!context->closeSent)
+    {
+        WebSocketCodec::sendClose(conn, code);
+        context->closeSent = true;
+    }
+    context->messageOpcode = -1;
+    context->message.clear();
+    buf->retrieveAll();
+    conn->shutdown();
+}
+
+void WebSocketServer::close(const TcpConnectionPtr &conn, int code, const StringPiece &reason)
+{
+    // closeSent只在连接所在的loop线程中修改
+    std::string reasonCopy(reason.data(), reason.size());
+    conn->getLoop()->runInLoop([conn, code, reasonCopy]() {
+        Context *context = static_cast<Context*>(conn->getContext().get());
+        if (context == nullptr || !context->upgraded || context->closeSent || !conn->connected())
+        {
+            return;
+        }
+        WebSocketCodec::sendClose(conn, code, reasonCopy);
+        context->closeSent = true;
+    });
+}
+
+void WebSocketServer::broadcast(const StringPiece &message, bool binary)
+{
+    server_.broadcast(WebSocketCodec::makeFrame(binary ? WebSocketCodec::kBinary : WebSocketCodec::kText, message),
+                    &WebSocketServer::isUpgraded);
+}
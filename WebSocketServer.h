@@ -0,0 +1,72 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpServer.h"
+#include "WebSocketCodec.h"
+#include "StringPiece.h"
+
+#include <functional>
+#include <string>
+
+/**
+ *  基于TcpServer的WebSocket服务器
+ *
+ *  连接先按HTTP解析升级请求（HttpParser），握手成功以后切换成按帧解析
+ *  - 没有分片的消息直接在inputBuffer_中原地去掉掩码交给回调，不拷贝；分片的消息拼起来再交给回调
+ *  - ping自动回复pong，收到close回复close然后关闭连接
+ *  - 协议错误回复close(1002)，消息超过maxMessageSize回复close(1009)
+ *  ConnectionCallback在握手成功和升级过的连接断开时调用，没有升级成功的连接不会通知用户
+ */
+class WebSocketServer : noncopyable
+{
+public:
+    // message只在回调期间有效，binary为false表示文本消息
+    using WebSocketMessageCallback = std::function<void (const TcpConnectionPtr&,
+                                                        const StringPiece &message,
+                                                        bool binary,
+                                                        Timestamp)>;
+
+    static const size_t kDefaultMaxMessageSize = 16*1024*1024;
+
+    WebSocketServer(EventLoop *loop,
+                const InetAddress &listenAddr,
+                const std::string &name,
+                TcpServer::Option option = TcpServer::kNoReusePort);
+
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const WebSocketMessageCallback &cb) { messageCallback_ = cb; }
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    void setThreadInitCallback(const TcpServer::ThreadInitCallback &cb) { server_.setThreadInitcallback(cb); }
+    // 在start之前设置
+    void setMaxMessageSize(size_t maxMessageSize) { maxMessageSize_ = maxMessageSize; }
+
+    void start();
+
+    // 发送消息，线程安全
+    static void sendText(const TcpConnectionPtr &conn, const StringPiece &text)
+    { WebSocketCodec::send(conn, WebSocketCodec::kText, text); }
+    static void sendBinary(const TcpConnectionPtr &conn, const StringPiece &data)
+    { WebSocketCodec::send(conn, WebSocketCodec::kBinary, data); }
+    static void sendBinary(const TcpConnectionPtr &conn, std::string &&data)
+    { WebSocketCodec::send(conn, WebSocketCodec::kBinary, std::move(data)); }
+    // 发送close帧，等对端回复close以后关闭连接
+    static void close(const TcpConnectionPtr &conn, int code = WebSocketCodec::kNormalClosure,
+                    const StringPiece &reason = StringPiece());
+
+    // 发给所有握手成功的连接，帧只编码一次，所有连接共享
+    void broadcast(const StringPiece &message, bool binary = false);
+private:
+    struct Context;
+
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+    void onHandshake(const TcpConnectionPtr &conn, Context *context, Buffer *buf);
+    void onFrames(const TcpConnectionPtr &conn, Context *context, Buffer *buf, Timestamp receiveTime);
+    void failConnection(const TcpConnectionPtr &conn, Context *context, Buffer *buf, int code);
+    static bool isUpgraded(const TcpConnectionPtr &conn);
+
+    TcpServer server_;
+    ConnectionCallback connectionCallback_;
+    WebSocketMessageCallback messageCallback_;
+    size_t maxMessageSize_;
+};
@@ -0,0 +1,498 @@
+#include "KvServer.h"
+#include "RespCodec.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Buffer.h"
+#include "Timestamp.h"
+
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <vector>
+#include <string>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+namespace
+{
+
+enum Command
+{
+    kGet,
+    kSet,
+    kDel,
+    kExpire,
+    kTtl,
+    kPing,
+    kEcho,
+    kHello,
+    kConfig,
+    kCommand,
+    kQuit,
+    kUnknown,
+};
+
+struct CommandInfo
+{
+    const char *name;
+    Command command;
+    int minArgs;    // 包括命令名
+    int maxArgs;    // -1表示不限
+};
+
+const CommandInfo kCommands[] =
+{
+    { "get", kGet, 2, 2 },
+    { "set", kSet, 3, 6 },
+    { "del", kDel, 2, -1 },
+    { "expire", kExpire, 3, 3 },
+    { "ttl", kTtl, 2, 2 },
+    { "ping", kPing, 1, 2 },
+    { "echo", kEcho, 2, 2 },
+    { "hello", kHello, 1, -1 },
+    { "config", kConfig, 1, -1 },
+    { "command", kCommand, 1, -1 },
+    { "quit", kQuit, 1, 1 },
+};
+
+const CommandInfo* lookupCommand(const StringPiece &name)
+{
+    for (const CommandInfo &info : kCommands)
+    {
+        if (::strlen(info.name) == name.size() && ::strncasecmp(info.name, name.data(), name.size()) == 0)
+        {
+            return &info;
+        }
+    }
+    return nullptr;
+}
+
+bool parseInteger(const StringPiece &str, int64_t *value)
+{
+    if (str.empty() || str.size() > 19)
+    {
+        return false;
+    }
+    char buf[24];
+    ::memcpy(buf, str.data(), str.size());
+    buf[str.size()] = '\0';
+    char *end = nullptr;
+    errno = 0;
+    *value = ::strtoll(buf, &end, 10);
+    return end == buf + str.size() && errno != ERANGE;
+}
+
+bool equalsIgnoreCase(const StringPiece &str, const char *s)
+{
+    return ::strlen(s) == str.size() && ::strncasecmp(s, str.data(), str.size()) == 0;
+}
+
+// FNV-1a，只用来选分片
+size_t hashKey(const StringPiece &key)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < key.size(); ++i)
+    {
+        h ^= static_cast<unsigned char>(key[i]);
+        h *= 1099511628211ULL;
+    }
+    return static_cast<size_t>(h);
+}
+
+} // namespace
+
+// 一个分片，公开的函数都先加锁，任何loop线程都可以调用
+class Shard : noncopyable
+{
+public:
+    // 执行一个只涉及一个key的命令（GET SET EXPIRE TTL），回复写到out
+    void execute(Command command, const std::vector<StringPiece> &args, bool resp3, Buffer *out);
+    int64_t del(const StringPiece &key);
+    // 定期删掉过期的key，不然没人访问的key会一直占着内存
+    void expireCycle();
+private:
+    struct Entry
+    {
+        std::string value;
+        int64_t expireAt;   // 微秒，0表示不过期
+        int64_t queuedAt;   // expires_中这个key有效的那条记录的时间，0表示没有
+    };
+
+    // 下面的函数调用之前要持有mutex_
+    // 顺便删掉已经过期的key
+    Entry* lookup(const StringPiece &key);
+    void setExpire(const std::string &key, Entry *entry, int64_t expireAt);
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> map_;
+    // (过期时间, key)，每个key最多一条有效的记录（时间等于queuedAt），其余的弹出来的时候跳过
+    // 过期时间往后推的时候不入队，记录弹出来的时候再按新的过期时间重新入队，反复SET EX同一个key堆也不会变大
+    using ExpireItem = std::pair<int64_t, std::string>;
+    std::priority_queue<ExpireItem, std::vector<ExpireItem>, std::greater<ExpireItem>> expires_;
+    std::string keyScratch_; // 查找时用的key，复用内存
+};
+
+Shard::Entry* Shard::lookup(const StringPiece &key)
+{
+    keyScratch_.assign(key.data(), key.size());
+    auto it = map_.find(keyScratch_);
+    if (it == map_.end())
+    {
+        return nullptr;
+    }
+    if (it->second.expireAt != 0 && it->second.expireAt <= Timestamp::now().microSecondsSinceEpoch())
+    {
+        map_.erase(it);
+        return nullptr;
+    }
+    return &it->second;
+}
+
+void Shard::setExpire(const std::string &key, Entry *entry, int64_t expireAt)
+{
+    entry->expireAt = expireAt;
+    // 已经有一条更早的记录在排队的话，等它弹出来再说
+    if (expireAt != 0 && (entry->queuedAt == 0 || entry->queuedAt > expireAt))
+    {
+        entry->queuedAt = expireAt;
+        expires_.push(ExpireItem(expireAt, key));
+    }
+}
+
+void Shard::expireCycle()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int64_t now = Timestamp::now().microSecondsSinceEpoch();
+    // 每次最多处理这么多，不要长时间阻塞loop
+    int budget = 10000;
+    while (!expires_.empty() && expires_.top().first <= now && budget-- > 0)
+    {
+        const int64_t queuedAt = expires_.top().first;
+        auto it = map_.find(expires_.top().second);
+        if (it == map_.end() || it->second.queuedAt != queuedAt)
+        {
+            expires_.pop();
+            continue;
+        }
+        Entry &entry = it->second;
+        if (entry.expireAt == queuedAt)
+        {
+            map_.erase(it);
+            expires_.pop();
+        }
+        else
+        {
+            // 过期时间推后了或者去掉了，按新的时间重新排队
+            const std::string key = expires_.top().second;
+            expires_.pop();
+            entry.queuedAt = 0;
+            setExpire(key, &entry, entry.expireAt);
+        }
+    }
+}
+
+int64_t Shard::del(const StringPiece &key)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (lookup(key) == nullptr)
+    {
+        return 0;
+    }
+    map_.erase(keyScratch_);
+    return 1;
+}
+
+void Shard::execute(Command command, const std::vector<StringPiece> &args, bool resp3, Buffer *out)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const StringPiece &key = args[1];
+    switch (command)
+    {
+    case kGet:
+    {
+        Entry *entry = lookup(key);
+        if (entry == nullptr)
+        {
+            RespWriter::appendNull(out, resp3);
+        }
+        else
+        {
+            RespWriter::appendBulkString(out, entry->value);
+        }
+        break;
+    }
+
+    case kSet:
+    {
+        // SET key value [EX seconds | PX milliseconds]
+        int64_t expireAt = 0;
+        if (args.size() > 3)
+        {
+            int64_t ttl = 0;
+            const bool ex = equalsIgnoreCase(args[3], "ex");
+            if (args.size() != 5 || (!ex && !equalsIgnoreCase(args[3], "px")))
+            {
+                RespWriter::appendError(out, "ERR syntax error");
+                break;
+            }
+            const int64_t now = Timestamp::now().microSecondsSinceEpoch();
+            const int64_t unit = ex ? 1000000 : 1000;
+            if (!parseInteger(args[4], &ttl) || ttl <= 0 || ttl > (INT64_MAX - now) / unit)
+            {
+                RespWriter::appendError(out, "ERR invalid expire time in 'set' command");
+                break;
+            }
+            expireAt = now + ttl * unit;
+        }
+        keyScratch_.assign(key.data(), key.size());
+        Entry &entry = map_[keyScratch_];
+        entry.value.assign(args[2].data(), args[2].size());
+        setExpire(keyScratch_, &entry, expireAt);
+        RespWriter::appendSimpleString(out, "OK");
+        break;
+    }
+
+    case kExpire:
+    {
+        int64_t seconds = 0;
+        if (!parseInteger(args[2], &seconds))
+        {
+            RespWriter::appendError(out, "ERR value is not an integer or out of range");
+            break;
+        }
+        const int64_t now = Timestamp::now().microSecondsSinceEpoch();
+        if (seconds > (INT64_MAX - now) / 1000000)
+        {
+            RespWriter::appendError(out, "ERR invalid expire time in 'expire' command");
+            break;
+        }
+        Entry *entry = lookup(key);
+        if (entry == nullptr)
+        {
+            RespWriter::appendInteger(out, 0);
+        }
+        else if (seconds <= 0)
+        {
+            map_.erase(keyScratch_);
+            RespWriter::appendInteger(out, 1);
+        }
+        else
+        {
+            setExpire(keyScratch_, entry, now + seconds * 1000000);
+            RespWriter::appendInteger(out, 1);
+        }
+        break;
+    }
+
+    case kTtl:
+    {
+        // key不存在返回-2，没有过期时间返回-1
+        Entry *entry = lookup(key);
+        if (entry == nullptr)
+        {
+            RespWriter::appendInteger(out, -2);
+        }
+        else if (entry->expireAt == 0)
+        {
+            RespWriter::appendInteger(out, -1);
+        }
+        else
+        {
+            int64_t remaining = entry->expireAt - Timestamp::now().microSecondsSinceEpoch();
+            RespWriter::appendInteger(out, (remaining + 999999) / 1000000);
+        }
+        break;
+    }
+
+    default:
+        RespWriter::appendError(out, "ERR not a key command");
+        break;
+    }
+}
+
+struct KvServer::Session
+{
+    RespParser parser;
+    std::vector<StringPiece> args;
+    bool resp3 = false;
+    bool quitting = false;  // 收到了QUIT，这一轮的回复发出去以后关闭连接
+    Buffer out;             // 这一轮要发送的回复
+};
+
+KvServer::KvServer(EventLoop *loop, const InetAddress &listenAddr, int numThreads)
+    : loop_(loop)
+    , server_(loop, listenAddr, "KvServer")
+{
+    for (int i = 0; i < kNumShards; ++i)
+    {
+        shards_.emplace_back(new Shard);
+    }
+    server_.setThreadNum(numThreads);
+    server_.setConnectionCallback(std::bind(&KvServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(
+        std::bind(&KvServer::onMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    expireTimer_ = loop_->runEvery(0.1, std::bind(&KvServer::expireCycle, this));
+}
+
+KvServer::~KvServer()
+{
+    loop_->cancel(expireTimer_);
+}
+
+void KvServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setContext(std::make_shared<Session>());
+    }
+}
+
+Shard* KvServer::shardOf(const StringPiece &key) const
+{
+    return shards_[hashKey(key) % shards_.size()].get();
+}
+
+void KvServer::expireCycle()
+{
+    for (const std::unique_ptr<Shard> &shard : shards_)
+    {
+        shard->expireCycle();
+    }
+}
+
+void KvServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    Session *session = static_cast<Session*>(conn->getContext().get());
+    RespParser::Result result = RespParser::kNeedMore;
+    while (!session->quitting && (result = session->parser.parse(buf)) == RespParser::kComplete)
+    {
+        if (!session->parser.command(&session->args))
+        {
+            result = RespParser::kError;
+            break;
+        }
+        if (!session->args.empty())
+        {
+            dispatch(session);
+        }
+        buf->retrieve(session->parser.messageBytes());
+        session->parser.reset();
+    }
+
+    if (result == RespParser::kError)
+    {
+        const char *error = session->parser.error() ? session->parser.error() : "expected array of bulk strings";
+        RespWriter::appendError(&session->out, std::string("ERR Protocol error: ") + error);
+        buf->retrieveAll();
+        conn->send(&session->out);
+        conn->shutdown();
+        return;
+    }
+    if (session->out.readableBytes() > 0)
+    {
+        conn->send(&session->out);
+    }
+    if (session->quitting)
+    {
+        // QUIT后面的命令不再执行，回复都交给send了才能shutdown
+        buf->retrieveAll();
+        conn->shutdown();
+    }
+}
+
+void KvServer::dispatch(Session *session)
+{
+    const std::vector<StringPiece> &args = session->args;
+    const CommandInfo *info = lookupCommand(args[0]);
+    Buffer *out = &session->out;
+    if (info == nullptr)
+    {
+        RespWriter::appendError(out, "ERR unknown command '" + args[0].as_string() + "'");
+        return;
+    }
+    const int argc = static_cast<int>(args.size());
+    if (argc < info->minArgs || (info->maxArgs >= 0 && argc > info->maxArgs))
+    {
+        RespWriter::appendError(out, std::string("ERR wrong number of arguments for '") + info->name + "' command");
+        return;
+    }
+
+    switch (info->command)
+    {
+    case kGet:
+    case kSet:
+    case kExpire:
+    case kTtl:
+        shardOf(args[1])->execute(info->command, args, session->resp3, out);
+        break;
+
+    case kDel:
+    {
+        int64_t count = 0;
+        for (int i = 1; i < argc; ++i)
+        {
+            count += shardOf(args[i])->del(args[i]);
+        }
+        RespWriter::appendInteger(out, count);
+        break;
+    }
+
+    case kPing:
+        if (argc == 1)
+        {
+            RespWriter::appendSimpleString(out, "PONG");
+        }
+        else
+        {
+            RespWriter::appendBulkString(out, args[1]);
+        }
+        break;
+
+    case kEcho:
+        RespWriter::appendBulkString(out, args[1]);
+        break;
+
+    case kHello:
+    {
+        // HELLO [protover]，切换协议以后的回复就用新协议编码
+        int64_t version = session->resp3 ? 3 : 2;
+        if (argc >= 2 && (!parseInteger(args[1], &version) || (version != 2 && version != 3)))
+        {
+            RespWriter::appendError(out, "NOPROTO unsupported protocol version");
+                break;
+        }
+        session->resp3 = version == 3;
+        RespWriter::appendMapHeader(out, 4, session->resp3);
+        RespWriter::appendBulkString(out, "server");
+        RespWriter::appendBulkString(out, "mymuduo-kv");
+        RespWriter::appendBulkString(out, "proto");
+        RespWriter::appendInteger(out, version);
+        RespWriter::appendBulkString(out, "mode");
+        RespWriter::appendBulkString(out, "standalone");
+        RespWriter::appendBulkString(out, "role");
+        RespWriter::appendBulkString(out, "master");
+        break;
+    }
+
+    case kConfig:
+        // redis-benchmark启动的时候会CONFIG GET，回复空的就行
+        RespWriter::appendMapHeader(out, 0, session->resp3);
+        break;
+
+    case kCommand:
+        RespWriter::appendArrayHeader(out, 0);
+        break;
+
+    case kQuit:
+        RespWriter::appendSimpleString(out, "OK");
+        session->quitting = true;
+        break;
+
+    default:
+        break;
+    }
+}
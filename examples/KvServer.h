@@ -0,0 +1,46 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpServer.h"
+#include "StringPiece.h"
+#include "TimerId.h"
+#include "Timestamp.h"
+
+#include <memory>
+#include <vector>
+
+class Shard;
+
+/**
+ *  兼容redis协议（RESP2/RESP3）的内存KV服务器，支持 GET SET DEL EXPIRE TTL PING ECHO HELLO QUIT
+ *
+ *  数据按key的哈希分成kNumShards个分片，每个分片一把锁，命令在连接自己的loop线程中直接执行，
+ *  不用把命令转发到别的loop再把回复送回来，所以回复天然按请求的顺序写出去；
+ *  分片远多于loop线程，两个线程同时访问同一个分片的机会很小
+ *  过期的key在访问的时候顺便删掉，baseloop上的定时器也定期清理没人访问的过期key
+ */
+class KvServer : noncopyable
+{
+public:
+    static const int kNumShards = 64;
+
+    KvServer(EventLoop *loop, const InetAddress &listenAddr, int numThreads);
+    ~KvServer();
+
+    void start() { server_.start(); }
+private:
+    struct Session;
+
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp);
+    // 执行session->args中的一个命令，回复追加到session->out
+    void dispatch(Session *session);
+    Shard* shardOf(const StringPiece &key) const;
+    void expireCycle();
+
+    EventLoop *loop_;
+    // 放在server_前面，析构的时候loop线程都已经退出了
+    std::vector<std::unique_ptr<Shard>> shards_;
+    TcpServer server_;
+    TimerId expireTimer_;
+};
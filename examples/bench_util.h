@@ -0,0 +1,112 @@
+#pragma once
+
+// 压测程序共用的小工具
+
+#include "EventLoop.h"
+#include "TcpConnection.h"
+#include "InetAddress.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <time.h>
+
+// 在loop线程中执行cb并等它执行完，用来在另一个线程的loop上同步地创建/启动服务器
+inline void runInLoopAndWait(EventLoop *loop, const std::function<void()> &cb)
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool done = false;
+    loop->runInLoop([&]() {
+        cb();
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        cond.notify_one();
+    });
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&]() { return done; });
+}
+
+// 单调时钟的微秒数，压测计时用
+inline int64_t nowMicros()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+inline double secondsSince(int64_t startMicros)
+{
+    return static_cast<double>(nowMicros() - startMicros) / 1e6;
+}
+
+// 客户端连接：阻塞地连上serverAddr（回环地址上马上就能连上），再把socket交给loop，和TcpServer接受的连接一样用
+// 必须在loop线程中调用，返回之前已经执行过connectionCallback；对端关闭以后连接自己从loop上摘下来
+inline TcpConnectionPtr connectTo(EventLoop *loop,
+                                  const InetAddress &serverAddr,
+                                  const std::string &name,
+                                  const ConnectionCallback &connectionCallback,
+                                  const MessageCallback &messageCallback,
+                                  const WriteCompleteCallback &writeCompleteCallback = WriteCompleteCallback())
+{
+    int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (sockfd < 0 || ::connect(sockfd, (const sockaddr*)serverAddr.getSockAddr(), sizeof(sockaddr_in)) < 0)
+    {
+        LOG_FATAL("connectTo %s failed, errno:%d \n", serverAddr.toIpPort().c_str(), errno);
+    }
+    ::fcntl(sockfd, F_SETFL, ::fcntl(sockfd, F_GETFL) | O_NONBLOCK);
+
+    sockaddr_in local;
+    socklen_t addrlen = sizeof local;
+    ::getsockname(sockfd, (sockaddr*)&local, &addrlen);
+    TcpConnectionPtr conn(new TcpConnection(loop, name, sockfd, InetAddress(local), serverAddr));
+    conn->setConnectionCallback(connectionCallback ? connectionCallback : [](const TcpConnectionPtr&) {});
+    conn->setMessageCallback(messageCallback);
+    conn->setWriteCompleteCallback(writeCompleteCallback);
+    conn->setCloseCallback([](const TcpConnectionPtr &c) {
+        c->getLoop()->queueInLoop(std::bind(&TcpConnection::connectDestroyed, c));
+    });
+    conn->connectEstablished();
+    return conn;
+}
+
+// 记录延迟样本（微秒），最后排序打印分位数
+class LatencyRecorder
+{
+public:
+    void reserve(size_t n) { samples_.reserve(n); }
+    void add(int64_t micros) { samples_.push_back(micros); }
+    void clear() { samples_.clear(); }
+    size_t count() const { return samples_.size(); }
+
+    void print(const char *label)
+    {
+        if (samples_.empty())
+        {
+            printf("%s: no samples\n", label);
+            return;
+        }
+        std::sort(samples_.begin(), samples_.end());
+        printf("%s: n=%zu p50=%ldus p90=%ldus p99=%ldus p999=%ldus max=%ldus\n", label, samples_.size(),
+            (long)percentile(0.50), (long)percentile(0.90), (long)percentile(0.99),
+            (long)percentile(0.999), (long)samples_.back());
+    }
+private:
+    int64_t percentile(double p) const
+    {
+        size_t index = static_cast<size_t>(p * (samples_.size() - 1));
+        return samples_[index];
+    }
+
+    std::vector<int64_t> samples_;
+};
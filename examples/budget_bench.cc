@@ -0,0 +1,154 @@
+// 读写预算对混合负载的效果：同一个服务器loop上有bulk个大流量回显连接和一个ping-pong连接
+// 不开预算时大流量连接每次读写都尽量多做，ping要排在它们后面；开了预算以后每个连接每轮最多读写ioBudget字节，
+// 整个loop每轮最多读写loopBudget字节，ping的延迟应该明显下降，代价是大流量连接的吞吐量
+// 用法：budget_bench [bulk=8] [chunkKB=256] [ioBudgetKB=16] [loopBudgetKB=128] [seconds=5]
+
+#include "TcpServer.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+#include "bench_util.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[])
+{
+    const int numBulk = argc > 1 ? ::atoi(argv[1]) : 8;
+    const size_t chunkSize = (argc > 2 ? ::atoi(argv[2]) : 256) * 1024;
+    const size_t ioBudget = (argc > 3 ? ::atoi(argv[3]) : 16) * 1024;
+    const size_t loopBudget = (argc > 4 ? ::atoi(argv[4]) : 128) * 1024;
+    const double seconds = argc > 5 ? ::atof(argv[5]) : 5;
+    Logger::setMinLevel(ERROR);
+
+    // 服务器只用一个loop线程，所有连接都在这个loop上竞争
+    const InetAddress serverAddr(19007);
+    EventLoopThread serverThread;
+    EventLoop *serverLoop = serverThread.startLoop();
+    std::unique_ptr<TcpServer> server;
+    bool budgetOn = false; // 只在建立新一组连接之前修改
+    runInLoopAndWait(serverLoop, [&]() {
+        server.reset(new TcpServer(serverLoop, serverAddr, "BudgetEcho"));
+        server->setConnectionCallback([&](const TcpConnectionPtr &conn) {
+            if (conn->connected() && budgetOn)
+            {
+                conn->setIoBudget(ioBudget, ioBudget);
+            }
+        });
+        server->setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+            conn->send(buf);
+        });
+        server->start();
+    });
+
+    EventLoopThread bulkThread;
+    EventLoop *bulkLoop = bulkThread.startLoop();
+    EventLoopThread pingThread;
+    EventLoop *pingLoop = pingThread.startLoop();
+    const std::string chunk(chunkSize, 'x');
+    std::atomic<int64_t> bulkBytes(0);
+    std::atomic<bool> stopping(false);
+    LatencyRecorder latency; // 只在ping的loop线程中访问
+    bool measuring = false;
+    int64_t pingSent = 0;
+
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        budgetOn = mode == 1;
+        stopping = false;
+        runInLoopAndWait(serverLoop, [&]() {
+            serverLoop->setIterationBudget(budgetOn ? loopBudget : 0, 0);
+        });
+
+        // 大流量连接：收到多少回显就再发多少，保持chunkSize字节在路上
+        std::vector<TcpConnectionPtr> bulkClients;
+        runInLoopAndWait(bulkLoop, [&]() {
+            for (int i = 0; i < numBulk; ++i)
+            {
+                bulkClients.push_back(connectTo(bulkLoop, serverAddr, "BulkClient",
+                    [&](const TcpConnectionPtr &conn) {
+                        if (conn->connected())
+                        {
+                            conn->send(chunk);
+                        }
+                    },
+                    [&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+                        const size_t n = buf->readableBytes();
+                        buf->retrieveAll();
+                        bulkBytes += n;
+                        if (!stopping)
+                        {
+                            conn->send(chunk.data(), n);
+                        }
+                    }));
+            }
+        });
+
+        // ping-pong连接：一次只有一个字节在路上，收到回复就记录往返时间再发下一个
+        TcpConnectionPtr pingClient;
+        runInLoopAndWait(pingLoop, [&]() {
+            pingClient = connectTo(pingLoop, serverAddr, "PingClient",
+                [&](const TcpConnectionPtr &conn) {
+                    if (conn->connected())
+                    {
+                        pingSent = nowMicros();
+                        conn->send("p", 1);
+                    }
+                },
+                [&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+                    buf->retrieveAll();
+                    const int64_t now = nowMicros();
+                    if (measuring)
+                    {
+                        latency.add(now - pingSent);
+                    }
+                    if (!stopping)
+                    {
+                        pingSent = now;
+                        conn->send("p", 1);
+                    }
+                });
+        });
+
+        // 先跑一秒热身，再开始计数
+        ::sleep(1);
+        runInLoopAndWait(pingLoop, [&]() {
+            latency.clear();
+            measuring = true;
+        });
+        const int64_t bulkBefore = bulkBytes.load();
+        const int64_t start = nowMicros();
+        ::usleep(static_cast<useconds_t>(seconds * 1e6));
+        const double elapsed = secondsSince(start);
+        const int64_t bulk = bulkBytes.load() - bulkBefore;
+        runInLoopAndWait(pingLoop, [&]() { measuring = false; });
+
+        printf("budget=%-3s bulk %.1f MB/s\n", budgetOn ? "on" : "off", bulk / elapsed / 1e6);
+        latency.print(budgetOn ? "ping rtt (budget on) " : "ping rtt (budget off)");
+
+        // 不再发新的数据，等路上的回显收完再断开
+        stopping = true;
+        ::usleep(200 * 1000);
+        runInLoopAndWait(pingLoop, [&]() {
+            pingClient->shutdown();
+            pingClient.reset();
+        });
+        runInLoopAndWait(bulkLoop, [&]() {
+            for (const TcpConnectionPtr &conn : bulkClients)
+            {
+                conn->shutdown();
+            }
+            bulkClients.clear();
+        });
+        ::usleep(100 * 1000);
+    }
+
+    runInLoopAndWait(serverLoop, [&]() { server.reset(); });
+    return 0;
+}
@@ -0,0 +1,130 @@
+// Buffer分隔符查找的微基准：在一大段pipeline的HTTP请求/RESP命令上反复找出所有分隔符，
+// 对比Buffer::findCRLF/findEOL/findAnyOf（SSE2/AVX2）和std::search/逐字节查找
+// 用法：buffer_find_bench [inputMB=16] [rounds=20]
+
+#include "Buffer.h"
+#include "bench_util.h"
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+
+const char kCRLF[] = "\r\n";
+
+// 返回找到的分隔符个数，防止被编译器优化掉
+size_t scanCRLF(const Buffer &buf)
+{
+    size_t count = 0;
+    const char *p = buf.peek();
+    while ((p = buf.findCRLF(p)) != nullptr)
+    {
+        ++count;
+        p += 2;
+    }
+    return count;
+}
+
+size_t scanEOL(const Buffer &buf)
+{
+    size_t count = 0;
+    const char *p = buf.peek();
+    while ((p = buf.findEOL(p)) != nullptr)
+    {
+        ++count;
+        ++p;
+    }
+    return count;
+}
+
+size_t scanAnyOf(const Buffer &buf)
+{
+    static const char kChars[] = "\r\n: ";
+    size_t count = 0;
+    const char *p = buf.peek();
+    while ((p = buf.findAnyOf(kChars, 4, p)) != nullptr)
+    {
+        ++count;
+        ++p;
+    }
+    return count;
+}
+
+size_t scanStdSearch(const Buffer &buf)
+{
+    size_t count = 0;
+    const char *p = buf.peek();
+    const char *end = buf.beginWrite();
+    while ((p = std::search(p, end, kCRLF, kCRLF + 2)) != end)
+    {
+        ++count;
+        p += 2;
+    }
+    return count;
+}
+
+size_t scanBytewise(const Buffer &buf)
+{
+    size_t count = 0;
+    const char *end = buf.beginWrite();
+    for (const char *p = buf.peek(); p + 1 < end; ++p)
+    {
+        if (p[0] == '\r' && p[1] == '\n')
+        {
+            ++count;
+            ++p;
+        }
+    }
+    return count;
+}
+
+void run(const char *name, const std::function<size_t(const Buffer&)> &scan, const Buffer &buf, int rounds)
+{
+    size_t found = 0;
+    const int64_t start = nowMicros();
+    for (int i = 0; i < rounds; ++i)
+    {
+        found += scan(buf);
+    }
+    const double elapsed = secondsSince(start);
+    const double bytes = static_cast<double>(buf.readableBytes()) * rounds;
+    printf("%-16s %8.2f GB/s %10.1f M delimiters/s\n", name, bytes / elapsed / 1e9, found / elapsed / 1e6);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const size_t inputMB = argc > 1 ? ::atoi(argv[1]) : 16;
+    const int rounds = argc > 2 ? ::atoi(argv[2]) : 20;
+
+    // 一半是HTTP请求头，一半是RESP命令，行长从十几字节到一百多字节不等
+    const std::string http =
+        "GET /api/v1/items/123456?fields=name,price,stock HTTP/1.1\r\n"
+        "Host: backend.example.com\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)\r\n"
+        "Accept: application/json\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n";
+    const std::string resp = "*3\r\n$3\r\nSET\r\n$16\r\nkey:000000012345\r\n$32\r\nxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\r\n";
+
+    Buffer buf;
+    while (buf.readableBytes() < inputMB * 1024 * 1024)
+    {
+        buf.append(http.data(), http.size());
+        buf.append(resp.data(), resp.size());
+    }
+    printf("input %zu bytes, %d rounds\n", buf.readableBytes(), rounds);
+
+    run("findCRLF", scanCRLF, buf, rounds);
+    run("findEOL", scanEOL, buf, rounds);
+    run("findAnyOf(4)", scanAnyOf, buf, rounds);
+    run("std::search", scanStdSearch, buf, rounds);
+    run("bytewise", scanBytewise, buf, rounds);
+    return 0;
+}
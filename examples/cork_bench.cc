@@ -0,0 +1,143 @@
+// cork对流水线回显的效果：服务器把收到的每个message单独send回去，客户端每个连接保持depth个message在路上
+// 不开cork时每次send都会马上write一次，开了cork以后一轮事件循环的回复合并成一次writev
+// 统计每秒回显的message数，以及服务器loop线程每个message平均的write类系统调用次数（/proc/thread-self/io的syscw）
+// 用法：cork_bench [messageSize=64] [connections=16] [depth=64] [seconds=5]
+
+#include "TcpServer.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+#include "bench_util.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace
+{
+
+// 当前线程到目前为止的write类系统调用次数
+int64_t threadWriteSyscalls()
+{
+    int64_t syscw = -1;
+    FILE *fp = ::fopen("/proc/thread-self/io", "r");
+    if (fp != nullptr)
+    {
+        char line[128];
+        while (::fgets(line, sizeof line, fp) != nullptr)
+        {
+            if (::strncmp(line, "syscw:", 6) == 0)
+            {
+                syscw = ::atoll(line + 6);
+            }
+        }
+        ::fclose(fp);
+    }
+    return syscw;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const size_t messageSize = argc > 1 ? ::atoi(argv[1]) : 64;
+    const int numConnections = argc > 2 ? ::atoi(argv[2]) : 16;
+    const int depth = argc > 3 ? ::atoi(argv[3]) : 64;
+    const double seconds = argc > 4 ? ::atof(argv[4]) : 5;
+    Logger::setMinLevel(ERROR);
+
+    // 服务器只用一个loop线程，syscw就是这个线程的计数
+    const InetAddress serverAddr(19006);
+    EventLoopThread serverThread;
+    EventLoop *serverLoop = serverThread.startLoop();
+    std::unique_ptr<TcpServer> server;
+    bool corkOn = false; // 只在建立新一组连接之前修改
+    runInLoopAndWait(serverLoop, [&]() {
+        server.reset(new TcpServer(serverLoop, serverAddr, "CorkEcho"));
+        server->setConnectionCallback([&](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                conn->setCork(corkOn);
+            }
+        });
+        server->setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+            while (buf->readableBytes() >= messageSize)
+            {
+                conn->send(buf->peek(), messageSize);
+                buf->retrieve(messageSize);
+            }
+        });
+        server->start();
+    });
+
+    EventLoopThread clientThread;
+    EventLoop *clientLoop = clientThread.startLoop();
+    const std::string requests(messageSize * depth, 'x');
+    std::atomic<int64_t> echoed(0);
+    std::atomic<bool> stopping(false);
+
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        corkOn = mode == 1;
+        stopping = false;
+        std::vector<TcpConnectionPtr> clients;
+        runInLoopAndWait(clientLoop, [&]() {
+            for (int i = 0; i < numConnections; ++i)
+            {
+                // 收到几个完整的回复就再发几个请求，保持depth个在路上
+                clients.push_back(connectTo(clientLoop, serverAddr, "CorkClient",
+                    [&](const TcpConnectionPtr &conn) {
+                        if (conn->connected())
+                        {
+                            conn->send(requests);
+                        }
+                    },
+                    [&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+                        const size_t n = buf->readableBytes() / messageSize;
+                        buf->retrieve(n * messageSize);
+                        echoed += n;
+                        if (!stopping)
+                        {
+                            conn->send(requests.data(), n * messageSize);
+                        }
+                    }));
+            }
+        });
+
+        // 先跑一秒热身，再开始计数
+        ::sleep(1);
+        int64_t syscwBefore = 0;
+        runInLoopAndWait(serverLoop, [&]() { syscwBefore = threadWriteSyscalls(); });
+        const int64_t echoedBefore = echoed.load();
+        const int64_t start = nowMicros();
+        ::usleep(static_cast<useconds_t>(seconds * 1e6));
+        int64_t syscwAfter = 0;
+        runInLoopAndWait(serverLoop, [&]() { syscwAfter = threadWriteSyscalls(); });
+        const int64_t n = echoed.load() - echoedBefore;
+        const double elapsed = secondsSince(start);
+        printf("cork=%-3s messageSize=%zu connections=%d depth=%d: %.0f msgs/s, %.3f writes/msg\n",
+            corkOn ? "on" : "off", messageSize, numConnections, depth, n / elapsed,
+            n > 0 ? static_cast<double>(syscwAfter - syscwBefore) / n : 0.0);
+
+        // 不再发新的请求，等路上的回复收完再断开，避免服务器往已经关闭的连接回写
+        stopping = true;
+        ::usleep(100 * 1000);
+        runInLoopAndWait(clientLoop, [&]() {
+            for (const TcpConnectionPtr &conn : clients)
+            {
+                conn->shutdown();
+            }
+            clients.clear();
+        });
+        ::usleep(100 * 1000);
+    }
+
+    runInLoopAndWait(serverLoop, [&]() { server.reset(); });
+    return 0;
+}
@@ -0,0 +1,154 @@
+// 一条消息发给大量订阅者：TcpServer::broadcast（所有连接共享一份payload）和以前的做法
+// （自己保存连接列表，逐个conn->send(string)，每个连接拷贝一份）的对比
+// 每种方式发送messages条消息，统计发布耗时、全部送达耗时、进程CPU时间，以及发布完那一刻RSS的增长（待发送数据占用的内存）
+// 客户端和服务器在同一个进程里，subscribers个连接要占两倍的fd，10000个订阅者需要ulimit -n大于20000
+// 用法：fanout_bench [subscribers=5000] [messageSize=1024] [messages=20] [serverThreads=0]
+
+#include "TcpServer.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+#include "bench_util.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace
+{
+
+double cpuSeconds()
+{
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+        + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+long rssKB()
+{
+    long pages = 0;
+    long resident = 0;
+    FILE *fp = ::fopen("/proc/self/statm", "r");
+    if (fp != nullptr)
+    {
+        if (::fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+        {
+            resident = 0;
+        }
+        ::fclose(fp);
+    }
+    return resident * (::sysconf(_SC_PAGESIZE) / 1024);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const int subscribers = argc > 1 ? ::atoi(argv[1]) : 5000;
+    const size_t messageSize = argc > 2 ? ::atoi(argv[2]) : 1024;
+    const int messages = argc > 3 ? ::atoi(argv[3]) : 20;
+    const int serverThreads = argc > 4 ? ::atoi(argv[4]) : 0;
+    Logger::setMinLevel(ERROR);
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::vector<TcpConnectionPtr> conns; // 逐个send的方式自己维护的连接列表
+    std::atomic<size_t> received(0);
+    size_t target = 0;
+
+    const InetAddress serverAddr(19005);
+    EventLoopThread serverThread;
+    EventLoop *serverLoop = serverThread.startLoop();
+    std::unique_ptr<TcpServer> server;
+    runInLoopAndWait(serverLoop, [&]() {
+        server.reset(new TcpServer(serverLoop, serverAddr, "FanoutServer"));
+        server->setThreadNum(serverThreads);
+        server->setConnectionCallback([&](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                conns.push_back(conn);
+                cond.notify_all();
+            }
+        });
+        server->start();
+    });
+
+    EventLoopThread clientThread;
+    EventLoop *clientLoop = clientThread.startLoop();
+    std::vector<TcpConnectionPtr> clients;
+    runInLoopAndWait(clientLoop, [&]() {
+        for (int i = 0; i < subscribers; ++i)
+        {
+            clients.push_back(connectTo(clientLoop, serverAddr, "Subscriber", ConnectionCallback(),
+                [&](const TcpConnectionPtr&, Buffer *buf, Timestamp) {
+                    if (received.fetch_add(buf->readableBytes()) + buf->readableBytes() == target)
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        cond.notify_all();
+                    }
+                    buf->retrieveAll();
+                }));
+        }
+    });
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&]() { return conns.size() == static_cast<size_t>(subscribers); });
+    }
+    printf("subscribers=%d messageSize=%zu messages=%d serverThreads=%d\n",
+        subscribers, messageSize, messages, serverThreads);
+
+    const std::string message(messageSize, 'x');
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        received = 0;
+        target = static_cast<size_t>(subscribers) * messageSize * messages;
+        const long rssBefore = rssKB();
+        const double cpuBefore = cpuSeconds();
+        const int64_t start = nowMicros();
+        for (int i = 0; i < messages; ++i)
+        {
+            if (mode == 0)
+            {
+                server->broadcast(makePayload(std::string(message)));
+            }
+            else
+            {
+                for (const TcpConnectionPtr &conn : conns)
+                {
+                    conn->send(message);
+                }
+            }
+        }
+        const double publish = secondsSince(start);
+        const long rssGrowth = rssKB() - rssBefore;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&]() { return received.load() == target; });
+        }
+        const double deliver = secondsSince(start);
+        printf("%-9s publish %8.2f ms  deliver %8.2f ms  cpu %8.2f ms  rss +%ld KB\n",
+            mode == 0 ? "broadcast" : "send", publish * 1e3, deliver * 1e3,
+            (cpuSeconds() - cpuBefore) * 1e3, rssGrowth);
+    }
+
+    conns.clear();
+    runInLoopAndWait(clientLoop, [&]() {
+        for (const TcpConnectionPtr &conn : clients)
+        {
+            conn->shutdown();
+        }
+        clients.clear();
+    });
+    runInLoopAndWait(serverLoop, [&]() { server.reset(); });
+    return 0;
+}
@@ -0,0 +1,153 @@
+// HttpServer压测，类似wrk：同一个进程里起一个回复固定body的HttpServer，connections个长连接，
+// 每个连接一次发pipeline个GET，收齐所有响应再发下一批，统计每秒请求数和每一批的往返延迟
+// 用法：http_bench [connections=32] [pipeline=1] [seconds=5] [serverThreads=0] [bodySize=13]
+
+#include "HttpServer.h"
+#include "TcpClient.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+#include "bench_util.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace
+{
+
+// 从buf中取出一个完整的响应，返回false表示数据还不够
+bool retrieveResponse(Buffer *buf)
+{
+    const char *begin = buf->peek();
+    const char *end = begin + buf->readableBytes();
+    const char kHeaderEnd[] = "\r\n\r\n";
+    const char *headerEnd = std::search(begin, end, kHeaderEnd, kHeaderEnd + 4);
+    if (headerEnd == end)
+    {
+        return false;
+    }
+    size_t contentLength = 0;
+    const char kContentLength[] = "Content-Length: ";
+    const char *field = std::search(begin, headerEnd, kContentLength, kContentLength + sizeof kContentLength - 1);
+    if (field != headerEnd)
+    {
+        contentLength = ::strtoul(field + sizeof kContentLength - 1, nullptr, 10);
+    }
+    const size_t total = headerEnd + 4 - begin + contentLength;
+    if (buf->readableBytes() < total)
+    {
+        return false;
+    }
+    buf->retrieve(total);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const int numConnections = argc > 1 ? ::atoi(argv[1]) : 32;
+    const int pipeline = argc > 2 ? ::atoi(argv[2]) : 1;
+    const double seconds = argc > 3 ? ::atof(argv[3]) : 5;
+    const int serverThreads = argc > 4 ? ::atoi(argv[4]) : 0;
+    const size_t bodySize = argc > 5 ? ::atoi(argv[5]) : 13;
+    Logger::setMinLevel(ERROR);
+
+    const InetAddress serverAddr(19014);
+    EventLoopThread serverThread;
+    EventLoop *serverLoop = serverThread.startLoop();
+    std::unique_ptr<HttpServer> server;
+    const std::string body(bodySize, 'x');
+    runInLoopAndWait(serverLoop, [&]() {
+        server.reset(new HttpServer(serverLoop, serverAddr, "HttpBench"));
+        server->setThreadNum(serverThreads);
+        server->setHttpCallback([&](const HttpRequest&, HttpResponse *resp) {
+            resp->setStatusCode(200);
+            resp->setStatusMessage("OK");
+            resp->setContentType("text/plain");
+            resp->setBody(body);
+        });
+        server->start();
+    });
+
+    EventLoop loop;
+    std::string requests;
+    for (int i = 0; i < pipeline; ++i)
+    {
+        requests += "GET /bench HTTP/1.1\r\nHost: 127.0.0.1\r\nUser-Agent: http_bench\r\nAccept: */*\r\n\r\n";
+    }
+    std::vector<Timestamp> sent(numConnections);
+    std::vector<int> outstanding(numConnections);
+    LatencyRecorder latency;
+    int64_t responses = 0;
+    int64_t errors = 0;
+    bool measuring = false;
+    Timestamp start;
+
+    std::vector<std::unique_ptr<TcpClient>> clients;
+    for (int i = 0; i < numConnections; ++i)
+    {
+        clients.emplace_back(new TcpClient(&loop, serverAddr, "HttpClient"));
+        clients.back()->setConnectionCallback([&, i](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                sent[i] = Timestamp::now();
+                outstanding[i] = pipeline;
+                conn->send(requests);
+            }
+            else if (outstanding[i] > 0)
+            {
+                // 服务器在响应收齐之前关闭了连接
+                ++errors;
+            }
+        });
+        clients.back()->setMessageCallback([&, i](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+            while (outstanding[i] > 0 && retrieveResponse(buf))
+            {
+                --outstanding[i];
+                if (measuring)
+                {
+                    ++responses;
+                }
+            }
+            if (outstanding[i] > 0)
+            {
+                return;
+            }
+            const Timestamp now = Timestamp::now();
+            if (measuring)
+            {
+                latency.add(now - sent[i]);
+            }
+            sent[i] = now;
+            outstanding[i] = pipeline;
+            conn->send(requests);
+        });
+        clients.back()->connect();
+    }
+
+    // 先跑一秒热身，再开始计数
+    loop.runAfter(1.0, [&]() {
+        measuring = true;
+        start = Timestamp::now();
+    });
+    loop.runAfter(1.0 + seconds, [&]() {
+        const double elapsed = timeDifference(Timestamp::now(), start);
+        printf("connections=%d pipeline=%d serverThreads=%d bodySize=%zu: %.0f req/s, %ld errors\n",
+            numConnections, pipeline, serverThreads, bodySize, responses / elapsed, (long)errors);
+        latency.print("batch rtt");
+        loop.quit();
+    });
+    loop.loop();
+
+    clients.clear();
+    runInLoopAndWait(serverLoop, [&]() { server.reset(); });
+    return 0;
+}
@@ -0,0 +1,151 @@
+// KvServer的吞吐量随subloop个数的变化：同一个进程里依次起不同subloop个数的KvServer，
+// 客户端connections个连接，每个连接保持depth个命令在路上（pipeline），收到几个回复就再发几个，
+// 命令一半GET一半SET，key在keys个里面随机选，统计每秒完成的命令数
+// 用法：kv_bench [connections=16] [depth=16] [seconds=3] [keys=100000] [subLoops...=0 1 2 4]
+
+#include "KvServer.h"
+#include "RespCodec.h"
+#include "TcpClient.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+#include "bench_util.h"
+
+#include <atomic>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace
+{
+
+// 一个客户端连接的状态，只在客户端loop线程中访问
+struct ClientSession
+{
+    RespParser parser;
+    std::minstd_rand rng;
+    Buffer requests;
+    int64_t sent = 0;
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const int numConnections = argc > 1 ? ::atoi(argv[1]) : 16;
+    const int depth = argc > 2 ? ::atoi(argv[2]) : 16;
+    const double seconds = argc > 3 ? ::atof(argv[3]) : 3;
+    const int numKeys = argc > 4 ? ::atoi(argv[4]) : 100000;
+    std::vector<int> subLoops;
+    for (int i = 5; i < argc; ++i)
+    {
+        subLoops.push_back(::atoi(argv[i]));
+    }
+    if (subLoops.empty())
+    {
+        subLoops = { 0, 1, 2, 4 };
+    }
+    Logger::setMinLevel(ERROR);
+
+    std::vector<std::string> keys;
+    keys.reserve(numKeys);
+    for (int i = 0; i < numKeys; ++i)
+    {
+        keys.push_back("key:" + std::to_string(i));
+    }
+    const std::string value(32, 'v');
+    const StringPiece kGet("GET");
+    const StringPiece kSet("SET");
+
+    const InetAddress serverAddr(19018);
+    EventLoopThread clientThread;
+    EventLoop *clientLoop = clientThread.startLoop();
+    std::atomic<int64_t> replies(0);
+    std::atomic<bool> stopping(false);
+
+    // 追加n个命令并发出去，GET和SET交替
+    auto issue = [&](const TcpConnectionPtr &conn, ClientSession *session, size_t n) {
+        std::vector<StringPiece> args;
+        for (size_t i = 0; i < n; ++i)
+        {
+            const std::string &key = keys[session->rng() % keys.size()];
+            if (session->sent++ % 2 == 0)
+            {
+                args = { kGet, key };
+            }
+            else
+            {
+                args = { kSet, key, value };
+            }
+            RespWriter::appendCommand(&session->requests, args);
+        }
+        conn->send(&session->requests);
+    };
+
+    for (int numThreads : subLoops)
+    {
+        EventLoopThread serverThread;
+        EventLoop *serverLoop = serverThread.startLoop();
+        std::unique_ptr<KvServer> server;
+        runInLoopAndWait(serverLoop, [&]() {
+            server.reset(new KvServer(serverLoop, serverAddr, numThreads));
+            server->start();
+        });
+
+        stopping = false;
+        std::vector<std::unique_ptr<TcpClient>> clients;
+        runInLoopAndWait(clientLoop, [&]() {
+            for (int i = 0; i < numConnections; ++i)
+            {
+                clients.emplace_back(new TcpClient(clientLoop, serverAddr, "KvClient"));
+                clients.back()->setConnectionCallback([&, i](const TcpConnectionPtr &conn) {
+                    if (conn->connected())
+                    {
+                        std::shared_ptr<ClientSession> session = std::make_shared<ClientSession>();
+                        session->rng.seed(i + 1);
+                        conn->setContext(session);
+                        issue(conn, session.get(), depth);
+                    }
+                });
+                clients.back()->setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+                    ClientSession *session = static_cast<ClientSession*>(conn->getContext().get());
+                    size_t n = 0;
+                    while (session->parser.parse(buf) == RespParser::kComplete)
+                    {
+                        buf->retrieve(session->parser.messageBytes());
+                        session->parser.reset();
+                        ++n;
+                    }
+                    replies += n;
+                    if (!stopping && n > 0)
+                    {
+                        issue(conn, session, n);
+                    }
+                });
+                clients.back()->connect();
+            }
+        });
+
+        // 先跑一秒热身，再开始计数
+        ::sleep(1);
+        const int64_t before = replies.load();
+        const int64_t start = nowMicros();
+        ::usleep(static_cast<useconds_t>(seconds * 1e6));
+        const double elapsed = secondsSince(start);
+        const int64_t n = replies.load() - before;
+        printf("subLoops=%d connections=%d depth=%d: %.0f ops/s\n", numThreads, numConnections, depth, n / elapsed);
+
+        // 不再发新的命令，等路上的回复收完再断开
+        stopping = true;
+        ::usleep(200 * 1000);
+        runInLoopAndWait(clientLoop, [&]() { clients.clear(); });
+        ::usleep(100 * 1000);
+        runInLoopAndWait(serverLoop, [&]() { server.reset(); });
+    }
+    return 0;
+}
@@ -0,0 +1,22 @@
+// 兼容redis协议（RESP2/RESP3）的内存KV服务器，用来做压测的负载，实现见KvServer.h
+// 用法：kvserver [port] [numThreads]
+// 压测：redis-benchmark -p 6380 -t set,get -n 1000000 -c 64 -P 16
+
+#include "KvServer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <stdlib.h>
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? ::atoi(argv[1]) : 6380);
+    int numThreads = argc > 2 ? ::atoi(argv[2]) : 4;
+    Logger::setMinLevel(ERROR);
+
+    EventLoop loop;
+    KvServer server(&loop, InetAddress(port), numThreads);
+    server.start();
+    loop.loop();
+    return 0;
+}
@@ -0,0 +1,104 @@
+// LengthFieldCodec的小帧RPC吞吐量压测：同一个进程里起一个按帧回显的服务器和一个客户端，
+// 每个连接保持depth个帧在路上，收到一个回复就再发一个
+// 用法：lengthfield_bench [frameSize=64] [connections=16] [depth=64] [seconds=5] [serverThreads=1]
+
+#include "TcpServer.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "LengthFieldCodec.h"
+#include "Logger.h"
+#include "bench_util.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[])
+{
+    const size_t frameSize = argc > 1 ? ::atoi(argv[1]) : 64;
+    const int numConnections = argc > 2 ? ::atoi(argv[2]) : 16;
+    const int depth = argc > 3 ? ::atoi(argv[3]) : 64;
+    const double seconds = argc > 4 ? ::atof(argv[4]) : 5;
+    const int serverThreads = argc > 5 ? ::atoi(argv[5]) : 1;
+    Logger::setMinLevel(ERROR);
+
+    const InetAddress serverAddr(19001);
+    EventLoopThread serverThread;
+    EventLoop *serverLoop = serverThread.startLoop();
+    std::unique_ptr<TcpServer> server;
+    std::unique_ptr<LengthFieldCodec> serverCodec;
+    runInLoopAndWait(serverLoop, [&]() {
+        server.reset(new TcpServer(serverLoop, serverAddr, "LengthFieldEcho"));
+        serverCodec.reset(new LengthFieldCodec(
+            [&](const TcpConnectionPtr &conn, const char *data, size_t len, Timestamp) {
+                serverCodec->send(conn, data, len);
+            }));
+        server->setThreadNum(serverThreads);
+        server->setConnectionCallback([](const TcpConnectionPtr&) {});
+        server->setMessageCallback(std::bind(&LengthFieldCodec::onMessage, serverCodec.get(),
+            std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        server->start();
+    });
+
+    EventLoopThread clientThread;
+    EventLoop *clientLoop = clientThread.startLoop();
+    const std::string payload(frameSize, 'x');
+    std::atomic<int64_t> frames(0);
+    std::atomic<bool> stopping(false);
+    LengthFieldCodec clientCodec([&](const TcpConnectionPtr &conn, const char*, size_t, Timestamp) {
+        ++frames;
+        if (!stopping)
+        {
+            clientCodec.send(conn, payload);
+        }
+    });
+
+    std::vector<TcpConnectionPtr> clients;
+    runInLoopAndWait(clientLoop, [&]() {
+        for (int i = 0; i < numConnections; ++i)
+        {
+            clients.push_back(connectTo(clientLoop, serverAddr, "LengthFieldClient",
+                [&](const TcpConnectionPtr &conn) {
+                    if (conn->connected())
+                    {
+                        for (int k = 0; k < depth; ++k)
+                        {
+                            clientCodec.send(conn, payload);
+                        }
+                    }
+                },
+                std::bind(&LengthFieldCodec::onMessage, &clientCodec,
+                    std::placeholders::_1, std::placeholders::_2, std::placeholders::_3)));
+        }
+    });
+
+    // 先跑一秒热身，再开始计数
+    ::sleep(1);
+    const int64_t before = frames.load();
+    const int64_t start = nowMicros();
+    ::usleep(static_cast<useconds_t>(seconds * 1e6));
+    const double elapsed = secondsSince(start);
+    const int64_t n = frames.load() - before;
+    printf("frameSize=%zu connections=%d depth=%d: %.0f frames/s, %.1f MB/s\n",
+        frameSize, numConnections, depth, n / elapsed, n * frameSize / elapsed / 1e6);
+
+    // 不再发新的帧，等路上的回复收完再断开
+    stopping = true;
+    ::usleep(200 * 1000);
+    runInLoopAndWait(clientLoop, [&]() {
+        for (const TcpConnectionPtr &conn : clients)
+        {
+            conn->shutdown();
+        }
+        clients.clear();
+    });
+    ::usleep(100 * 1000);
+    runInLoopAndWait(serverLoop, [&]() { server.reset(); });
+    return 0;
+}
@@ -0,0 +1,128 @@
+// 日志吞吐量：threads个线程各写messages条LOG_INFO，对比两种输出
+// - stdio：每条日志直接fwrite到文件（FILE内部有锁，多个线程互相竞争）
+// - async：AsyncLogging，前台线程只拷贝到自己的缓冲区，后台线程写文件
+// 计时包括最后把日志全部写到文件（flush/stop），async同时打印丢弃的条数
+// 用法：logging_bench [threads=4] [messages=1000000] [dir=/tmp]
+
+#include "AsyncLogging.h"
+#include "Logger.h"
+#include "bench_util.h"
+
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+// threads个线程各写messages条日志，返回秒数
+double writeLogs(int threads, int messages, const std::function<void()> &finish)
+{
+    const int64_t start = nowMicros();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([t, messages]() {
+            for (int i = 0; i < messages; ++i)
+            {
+                LOG_INFO("logging_bench thread=%d seq=%d payload=%s \n", t, i, "abcdefghijklmnopqrstuvwxyz");
+            }
+        });
+    }
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+    finish();
+    return secondsSince(start);
+}
+
+// dir中以prefix开头的文件的总大小，AsyncLogging滚动的时候会生成多个文件
+off_t filesSize(const std::string &dir, const std::string &prefix)
+{
+    off_t total = 0;
+    DIR *d = ::opendir(dir.c_str());
+    if (d != nullptr)
+    {
+        while (struct dirent *entry = ::readdir(d))
+        {
+            struct stat st;
+            if (::strncmp(entry->d_name, prefix.c_str(), prefix.size()) == 0
+                && ::stat((dir + "/" + entry->d_name).c_str(), &st) == 0)
+            {
+                total += st.st_size;
+            }
+        }
+        ::closedir(d);
+    }
+    return total;
+}
+
+void removeDir(const std::string &dir)
+{
+    DIR *d = ::opendir(dir.c_str());
+    if (d != nullptr)
+    {
+        while (struct dirent *entry = ::readdir(d))
+        {
+            if (entry->d_name[0] != '.')
+            {
+                ::unlink((dir + "/" + entry->d_name).c_str());
+            }
+        }
+        ::closedir(d);
+    }
+    ::rmdir(dir.c_str());
+}
+
+void report(const char *label, int threads, int messages, double elapsed, off_t bytes)
+{
+    const double total = static_cast<double>(threads) * messages;
+    printf("%-6s threads=%d: %10.0f msgs/s %8.1f MB/s %7.1f ns/msg\n", label, threads,
+        total / elapsed, bytes / elapsed / 1e6, elapsed * 1e9 / total);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const int threads = argc > 1 ? ::atoi(argv[1]) : 4;
+    const int messages = argc > 2 ? ::atoi(argv[2]) : 1000000;
+    std::string dir = std::string(argc > 3 ? argv[3] : "/tmp") + "/mymuduo_logging_bench.XXXXXX";
+    if (::mkdtemp(&dir[0]) == nullptr)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    Logger::setMinLevel(INFO);
+
+    // Logger的输出只能在没有其他线程写日志的时候换，所以两种方式依次跑
+    {
+        FILE *fp = ::fopen((dir + "/stdio.log").c_str(), "w");
+        Logger::instance().setOutput([fp](const char *msg, size_t len) { ::fwrite(msg, 1, len, fp); });
+        const double elapsed = writeLogs(threads, messages, [fp]() { ::fflush(fp); });
+        report("stdio", threads, messages, elapsed, ::ftello(fp));
+        Logger::instance().setOutput([](const char *msg, size_t len) { ::fwrite(msg, 1, len, stdout); });
+        ::fclose(fp);
+    }
+    {
+        AsyncLogging log(dir + "/async", 1024 * 1024 * 1024);
+        log.start();
+        Logger::instance().setOutput(std::bind(&AsyncLogging::append, &log, std::placeholders::_1, std::placeholders::_2));
+        const double elapsed = writeLogs(threads, messages, [&log]() { log.stop(); });
+        Logger::instance().setOutput([](const char *msg, size_t len) { ::fwrite(msg, 1, len, stdout); });
+        report("async", threads, messages, elapsed, filesSize(dir, "async"));
+        printf("async dropped %llu messages (%llu bytes)\n",
+            (unsigned long long)log.droppedMessages(), (unsigned long long)log.droppedBytes());
+    }
+
+    removeDir(dir);
+    return 0;
+}
@@ -0,0 +1,194 @@
+// 代理转发延迟：客户端 -> 代理 -> 后端回显服务器，每个请求代理向ConnectionPool借一个后端连接转发，收到回复再归还
+// pooled：正常的连接池，后端连接复用；unpooled：maxIdle=0，归还就关闭，每个请求都要新建一次后端连接
+// 每个客户端连接一次只有一个请求在路上，统计每秒请求数和往返延迟的分位数
+// 用法：pool_bench [requestSize=64] [connections=4] [seconds=5]
+
+#include "ConnectionPool.h"
+#include "TcpServer.h"
+#include "TcpClient.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "EventLoopThreadPool.h"
+#include "Logger.h"
+#include "bench_util.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace
+{
+
+// 一个代理：自己的loop、连接池和监听的TcpServer，只在loop线程中创建和销毁
+struct Proxy
+{
+    std::unique_ptr<EventLoopThreadPool> threadPool;
+    std::unique_ptr<ConnectionPool> pool;
+    std::unique_ptr<TcpServer> server;
+};
+
+void startProxy(Proxy *proxy, EventLoop *loop, const InetAddress &listenAddr, const InetAddress &backendAddr,
+                size_t requestSize, bool pooled)
+{
+    proxy->threadPool.reset(new EventLoopThreadPool(loop, "ProxyPool"));
+    proxy->threadPool->start();
+    proxy->pool.reset(new ConnectionPool(proxy->threadPool.get(), pooled ? "Pooled" : "Unpooled"));
+    if (!pooled)
+    {
+        proxy->pool->setMaxIdle(0);
+    }
+    proxy->pool->start();
+    ConnectionPool *pool = proxy->pool.get();
+
+    proxy->server.reset(new TcpServer(loop, listenAddr, "Proxy"));
+    proxy->server->setConnectionCallback([](const TcpConnectionPtr&) {});
+    proxy->server->setMessageCallback([=](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        while (buf->readableBytes() >= requestSize)
+        {
+            std::string request = buf->retrieveAsString(requestSize);
+            std::weak_ptr<TcpConnection> weakClient(conn);
+            pool->acquire(loop, backendAddr, [=](const TcpConnectionPtr &upstream) {
+                if (!upstream)
+                {
+                    TcpConnectionPtr client = weakClient.lock();
+                    if (client)
+                    {
+                        client->forceClose();
+                    }
+                    return;
+                }
+                upstream->setMessageCallback([=](const TcpConnectionPtr &up, Buffer *response, Timestamp) {
+                    if (response->readableBytes() < requestSize)
+                    {
+                        return;
+                    }
+                    TcpConnectionPtr client = weakClient.lock();
+                    if (client)
+                    {
+                        client->send(response->peek(), requestSize);
+                    }
+                    response->retrieve(requestSize);
+                    // release会换掉正在执行的这个MessageCallback，放到回调外面做
+                    loop->queueInLoop([pool, up]() { pool->release(up); });
+                });
+                upstream->send(request);
+            });
+        }
+    });
+    proxy->server->start();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const size_t requestSize = argc > 1 ? ::atoi(argv[1]) : 64;
+    const int numConnections = argc > 2 ? ::atoi(argv[2]) : 4;
+    const double seconds = argc > 3 ? ::atof(argv[3]) : 5;
+    Logger::setMinLevel(ERROR);
+
+    // 连接池要在loop退出以后再析构，所以放在loop线程前面
+    Proxy proxies[2];
+
+    const InetAddress backendAddr(19008);
+    EventLoopThread backendThread;
+    EventLoop *backendLoop = backendThread.startLoop();
+    std::unique_ptr<TcpServer> backend;
+    runInLoopAndWait(backendLoop, [&]() {
+        backend.reset(new TcpServer(backendLoop, backendAddr, "Backend"));
+        backend->setConnectionCallback([](const TcpConnectionPtr&) {});
+        backend->setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+            conn->send(buf);
+        });
+        backend->start();
+    });
+
+    EventLoopThread proxyThread;
+    EventLoop *proxyLoop = proxyThread.startLoop();
+    const InetAddress proxyAddrs[2] = { InetAddress(19009), InetAddress(19010) };
+    runInLoopAndWait(proxyLoop, [&]() {
+        startProxy(&proxies[0], proxyLoop, proxyAddrs[0], backendAddr, requestSize, true);
+        startProxy(&proxies[1], proxyLoop, proxyAddrs[1], backendAddr, requestSize, false);
+    });
+
+    EventLoopThread clientThread;
+    EventLoop *clientLoop = clientThread.startLoop();
+    const std::string request(requestSize, 'x');
+    LatencyRecorder latency; // 只在客户端loop线程中访问
+    bool measuring = false;
+    bool stopping = false;
+    int64_t requests = 0;
+
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        std::vector<std::unique_ptr<TcpClient>> clients;
+        std::vector<Timestamp> sent(numConnections);
+        runInLoopAndWait(clientLoop, [&]() {
+            stopping = false;
+            for (int i = 0; i < numConnections; ++i)
+            {
+                clients.emplace_back(new TcpClient(clientLoop, proxyAddrs[mode], "ProxyClient"));
+                clients.back()->setConnectionCallback([&, i](const TcpConnectionPtr &conn) {
+                    if (conn->connected())
+                    {
+                        sent[i] = Timestamp::now();
+                        conn->send(request);
+                    }
+                });
+                clients.back()->setMessageCallback([&, i](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+                    if (buf->readableBytes() < requestSize)
+                    {
+                        return;
+                    }
+                    buf->retrieve(requestSize);
+                    const Timestamp now = Timestamp::now();
+                    if (measuring)
+                    {
+                        latency.add(now - sent[i]);
+                        ++requests;
+                    }
+                    if (!stopping)
+                    {
+                        sent[i] = now;
+                        conn->send(request);
+                    }
+                });
+                clients.back()->connect();
+            }
+        });
+
+        // 先跑一秒热身，再开始计数
+        ::sleep(1);
+        Timestamp start;
+        runInLoopAndWait(clientLoop, [&]() {
+            latency.clear();
+            requests = 0;
+            measuring = true;
+            start = Timestamp::now();
+        });
+        ::usleep(static_cast<useconds_t>(seconds * 1e6));
+        runInLoopAndWait(clientLoop, [&]() {
+            measuring = false;
+            stopping = true;
+            const double elapsed = timeDifference(Timestamp::now(), start);
+            printf("%-8s %.0f req/s\n", mode == 0 ? "pooled" : "unpooled", requests / elapsed);
+            latency.print(mode == 0 ? "pooled   rtt" : "unpooled rtt");
+        });
+
+        // 等路上的请求回来再断开
+        ::usleep(100 * 1000);
+        runInLoopAndWait(clientLoop, [&]() { clients.clear(); });
+        ::usleep(100 * 1000);
+    }
+
+    runInLoopAndWait(proxyLoop, [&]() {
+        proxies[0].server.reset();
+        proxies[1].server.reset();
+    });
+    runInLoopAndWait(backendLoop, [&]() { backend.reset(); });
+    return 0;
+}
@@ -0,0 +1,177 @@
+// relayTo的转发吞吐量：客户端 -> 代理 -> 后端（只收不回），代理对每个客户端连接建一个到后端的连接，两边互相relayTo
+// spliced：后端连接和客户端连接在同一个loop上，用splice经过内核管道转发
+// buffered：后端连接在另一个loop上，退回读到inputBuffer_再send
+// 统计后端每秒收到的字节数和整个进程的CPU时间
+// 用法：relay_bench [connections=4] [chunkKB=64] [seconds=5]
+
+#include "TcpServer.h"
+#include "TcpClient.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+#include "bench_util.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace
+{
+
+double cpuSeconds()
+{
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+        + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// 一个代理：客户端连接在loop上，到后端的连接在upstreamLoop上，两个loop相同时就是splice转发
+struct Proxy
+{
+    EventLoop *loop;
+    EventLoop *upstreamLoop;
+    std::unique_ptr<TcpServer> server;
+    std::vector<std::unique_ptr<TcpClient>> upstreams; // 只在upstreamLoop线程中访问
+    std::atomic_int spliced{0};
+};
+
+void startProxy(Proxy *proxy, const InetAddress &listenAddr, const InetAddress &backendAddr)
+{
+    proxy->server.reset(new TcpServer(proxy->loop, listenAddr, "RelayProxy"));
+    proxy->server->setConnectionCallback([=](const TcpConnectionPtr &conn) {
+        if (!conn->connected())
+        {
+            return;
+        }
+        std::weak_ptr<TcpConnection> weakClient(conn);
+        proxy->upstreamLoop->runInLoop([=]() {
+            proxy->upstreams.emplace_back(new TcpClient(proxy->upstreamLoop, backendAddr, "RelayUpstream"));
+            proxy->upstreams.back()->setConnectionCallback([=](const TcpConnectionPtr &upstream) {
+                TcpConnectionPtr client = weakClient.lock();
+                if (!upstream->connected() || !client)
+                {
+                    return;
+                }
+                upstream->relayTo(client);
+                client->getLoop()->runInLoop([=]() {
+                    client->relayTo(upstream);
+                    if (client->relaySpliced())
+                    {
+                        ++proxy->spliced;
+                    }
+                });
+            });
+            proxy->upstreams.back()->connect();
+        });
+    });
+    // relayTo之前收到的数据留在inputBuffer_中，relayTo的时候先转发出去
+    proxy->server->setMessageCallback([](const TcpConnectionPtr&, Buffer*, Timestamp) {});
+    proxy->server->start();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const int numConnections = argc > 1 ? ::atoi(argv[1]) : 4;
+    const size_t chunkSize = (argc > 2 ? ::atoi(argv[2]) : 64) * 1024;
+    const double seconds = argc > 3 ? ::atof(argv[3]) : 5;
+    Logger::setMinLevel(ERROR);
+
+    // 后端只收不回，统计收到的字节数
+    const InetAddress backendAddr(19011);
+    EventLoopThread backendThread;
+    EventLoop *backendLoop = backendThread.startLoop();
+    std::unique_ptr<TcpServer> backend;
+    std::atomic<int64_t> received(0);
+    runInLoopAndWait(backendLoop, [&]() {
+        backend.reset(new TcpServer(backendLoop, backendAddr, "RelaySink"));
+        backend->setConnectionCallback([](const TcpConnectionPtr&) {});
+        backend->setMessageCallback([&](const TcpConnectionPtr&, Buffer *buf, Timestamp) {
+            received += buf->readableBytes();
+            buf->retrieveAll();
+        });
+        backend->start();
+    });
+
+    EventLoopThread proxyThread;
+    EventLoop *proxyLoop = proxyThread.startLoop();
+    EventLoopThread upstreamThread;
+    EventLoop *upstreamLoop = upstreamThread.startLoop();
+    Proxy proxies[2];
+    proxies[0].loop = proxyLoop;
+    proxies[0].upstreamLoop = proxyLoop;
+    proxies[1].loop = proxyLoop;
+    proxies[1].upstreamLoop = upstreamLoop;
+    const InetAddress proxyAddrs[2] = { InetAddress(19012), InetAddress(19013) };
+    runInLoopAndWait(proxyLoop, [&]() {
+        startProxy(&proxies[0], proxyAddrs[0], backendAddr);
+        startProxy(&proxies[1], proxyAddrs[1], backendAddr);
+    });
+
+    EventLoopThread clientThread;
+    EventLoop *clientLoop = clientThread.startLoop();
+    const std::string chunk(chunkSize, 'x');
+    std::atomic<bool> stopping(false);
+
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        stopping = false;
+        // 客户端一直往代理写：发完一块（WriteComplete）再发下一块
+        std::vector<std::unique_ptr<TcpClient>> clients;
+        runInLoopAndWait(clientLoop, [&]() {
+            for (int i = 0; i < numConnections; ++i)
+            {
+                clients.emplace_back(new TcpClient(clientLoop, proxyAddrs[mode], "RelayClient"));
+                clients.back()->setConnectionCallback([&](const TcpConnectionPtr &conn) {
+                    if (conn->connected())
+                    {
+                        conn->send(chunk);
+                    }
+                });
+                clients.back()->setWriteCompleteCallback([&](const TcpConnectionPtr &conn) {
+                    if (!stopping)
+                    {
+                        conn->send(chunk);
+                    }
+                });
+                clients.back()->connect();
+            }
+        });
+
+        // 先跑一秒热身，再开始计数
+        ::sleep(1);
+        const int64_t before = received.load();
+        const double cpuBefore = cpuSeconds();
+        const Timestamp start = Timestamp::now();
+        ::usleep(static_cast<useconds_t>(seconds * 1e6));
+        const double elapsed = timeDifference(Timestamp::now(), start);
+        const double cpu = cpuSeconds() - cpuBefore;
+        const int64_t bytes = received.load() - before;
+        printf("%-8s spliced=%d/%d: %8.1f MB/s, cpu %.2f s per GB\n", mode == 0 ? "spliced" : "buffered",
+            proxies[mode].spliced.load(), numConnections, bytes / elapsed / 1e6, bytes > 0 ? cpu / (bytes / 1e9) : 0.0);
+
+        stopping = true;
+        ::usleep(200 * 1000);
+        runInLoopAndWait(clientLoop, [&]() { clients.clear(); });
+        ::usleep(100 * 1000);
+    }
+
+    runInLoopAndWait(upstreamLoop, [&]() {
+        proxies[0].upstreams.clear();
+        proxies[1].upstreams.clear();
+    });
+    runInLoopAndWait(proxyLoop, [&]() {
+        proxies[0].server.reset();
+        proxies[1].server.reset();
+    });
+    runInLoopAndWait(backendLoop, [&]() { backend.reset(); });
+    return 0;
+}
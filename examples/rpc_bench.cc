@@ -0,0 +1,134 @@
+// RpcServer/RpcClient的吞吐量和延迟：服务端注册两个回显方法，一个kInline在IO线程中执行，一个kWorker交给工作线程池，
+// 每个客户端连接保持depth个调用在路上，一个调用回复了就再发一个，统计每秒调用数和每个调用的延迟分位数
+// 用法：rpc_bench [requestSize=64] [connections=8] [depth=32] [seconds=5] [workerThreads=2]
+
+#include "RpcServer.h"
+#include "RpcClient.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+#include "bench_util.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace
+{
+
+const uint32_t kEchoInline = 1;
+const uint32_t kEchoWorker = 2;
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const size_t requestSize = argc > 1 ? ::atoi(argv[1]) : 64;
+    const int numConnections = argc > 2 ? ::atoi(argv[2]) : 8;
+    const int depth = argc > 3 ? ::atoi(argv[3]) : 32;
+    const double seconds = argc > 4 ? ::atof(argv[4]) : 5;
+    const int workerThreads = argc > 5 ? ::atoi(argv[5]) : 2;
+    Logger::setMinLevel(ERROR);
+
+    const InetAddress serverAddr(19016);
+    EventLoopThread serverThread;
+    EventLoop *serverLoop = serverThread.startLoop();
+    std::unique_ptr<RpcServer> server;
+    runInLoopAndWait(serverLoop, [&]() {
+        server.reset(new RpcServer(serverLoop, serverAddr, "RpcBench"));
+        auto echo = [](const RpcCall &call, const StringPiece &request) { RpcServer::reply(call, request); };
+        server->registerMethod(kEchoInline, echo, RpcServer::kInline);
+        server->registerMethod(kEchoWorker, echo, RpcServer::kWorker);
+        server->setWorkerThreadNum(workerThreads);
+        server->start();
+    });
+
+    EventLoopThread clientThread;
+    EventLoop *clientLoop = clientThread.startLoop();
+    const std::string request(requestSize, 'x');
+    // 下面这些只在客户端loop线程中访问
+    LatencyRecorder latency;
+    int64_t calls = 0;
+    int64_t failures = 0;
+    bool measuring = false;
+    bool stopping = false;
+
+    const uint32_t kMethods[] = { kEchoInline, kEchoWorker };
+    for (uint32_t methodId : kMethods)
+    {
+        std::vector<std::unique_ptr<RpcClient>> clients;
+        // 发起一次调用，回复以后接着发下一次，所以每个连接上一直有depth个调用
+        std::function<void(RpcClient*)> issue = [&](RpcClient *client) {
+            const Timestamp start = Timestamp::now();
+            client->call(methodId, request, [&, client, start](int status, const StringPiece&) {
+                if (measuring)
+                {
+                    if (status == RpcCodec::kOk)
+                    {
+                        latency.add(Timestamp::now() - start);
+                        ++calls;
+                    }
+                    else
+                    {
+                        ++failures;
+                    }
+                }
+                if (!stopping && status == RpcCodec::kOk)
+                {
+                    issue(client);
+                }
+            });
+        };
+        runInLoopAndWait(clientLoop, [&]() {
+            stopping = false;
+            for (int i = 0; i < numConnections; ++i)
+            {
+                clients.emplace_back(new RpcClient(clientLoop, serverAddr, "RpcBenchClient"));
+                RpcClient *client = clients.back().get();
+                client->setConnectionCallback([&, client](const TcpConnectionPtr &conn) {
+                    if (conn->connected())
+                    {
+                        for (int k = 0; k < depth; ++k)
+                        {
+                            issue(client);
+                        }
+                    }
+                });
+                client->connect();
+            }
+        });
+
+        // 先跑一秒热身，再开始计数
+        ::sleep(1);
+        Timestamp start;
+        runInLoopAndWait(clientLoop, [&]() {
+            latency.clear();
+            calls = 0;
+            failures = 0;
+            measuring = true;
+            start = Timestamp::now();
+        });
+        ::usleep(static_cast<useconds_t>(seconds * 1e6));
+        runInLoopAndWait(clientLoop, [&]() {
+            measuring = false;
+            stopping = true;
+            const double elapsed = timeDifference(Timestamp::now(), start);
+            const char *label = methodId == kEchoInline ? "inline" : "worker";
+            printf("%s requestSize=%zu connections=%d depth=%d: %.0f calls/s, %ld failures\n",
+                label, requestSize, numConnections, depth, calls / elapsed, (long)failures);
+            latency.print(label);
+        });
+
+        // 等路上的调用回来再断开，RpcClient要在loop线程中析构
+        ::usleep(200 * 1000);
+        runInLoopAndWait(clientLoop, [&]() { clients.clear(); });
+        ::usleep(100 * 1000);
+    }
+
+    runInLoopAndWait(serverLoop, [&]() { server.reset(); });
+    return 0;
+}
@@ -0,0 +1,132 @@
+// 跨线程send的分配/拷贝计数：一个生产者线程往另一个loop上的连接发消息，
+// 统计每条消息平均的堆分配次数、分配字节数和吞吐量，对比send的几个重载
+// 用法：send_alloc_bench [messageSize=256] [messages=200000]
+
+#include "TcpServer.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Buffer.h"
+#include "Logger.h"
+#include "bench_util.h"
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace
+{
+
+std::atomic<int64_t> g_allocations(0);
+std::atomic<int64_t> g_allocatedBytes(0);
+
+} // namespace
+
+// 整个进程的operator new都计数，包括生产者、loop线程和接收端
+__attribute__((noinline)) void* operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_allocatedBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+    void *p = ::malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+    ::free(p);
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t messageSize = argc > 1 ? ::atoi(argv[1]) : 256;
+    const int64_t messages = argc > 2 ? ::atoll(argv[2]) : 200000;
+    Logger::setMinLevel(ERROR);
+
+    const InetAddress serverAddr(19002);
+    EventLoopThread serverThread;
+    EventLoop *serverLoop = serverThread.startLoop();
+    std::unique_ptr<TcpServer> server;
+    TcpConnectionPtr serverConn;
+    std::atomic<bool> connected(false);
+    runInLoopAndWait(serverLoop, [&]() {
+        server.reset(new TcpServer(serverLoop, serverAddr, "SendServer"));
+        server->setConnectionCallback([&](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                serverConn = conn;
+                connected = true;
+            }
+        });
+        server->setMessageCallback([](const TcpConnectionPtr&, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+        server->start();
+    });
+
+    // 接收端只数字节
+    EventLoopThread clientThread;
+    EventLoop *clientLoop = clientThread.startLoop();
+    TcpConnectionPtr client;
+    std::atomic<int64_t> received(0);
+    runInLoopAndWait(clientLoop, [&]() {
+        client = connectTo(clientLoop, serverAddr, "SendClient", ConnectionCallback(),
+            [&](const TcpConnectionPtr&, Buffer *buf, Timestamp) {
+                received.fetch_add(static_cast<int64_t>(buf->readableBytes()), std::memory_order_relaxed);
+                buf->retrieveAll();
+            });
+    });
+    while (!connected)
+    {
+        ::usleep(1000);
+    }
+
+    const std::string message(messageSize, 'x');
+    struct Mode
+    {
+        const char *name;
+        std::function<void()> sendOne;
+    };
+    const Mode modes[] =
+    {
+        { "send(const string&)", [&]() { serverConn->send(message); } },
+        { "send(string&&)", [&]() { std::string m(message); serverConn->send(std::move(m)); } },
+        { "send(data, len)", [&]() { serverConn->send(message.data(), message.size()); } },
+        { "send(Buffer*)", [&]() { Buffer buf(messageSize); buf.append(message.data(), message.size()); serverConn->send(&buf); } },
+    };
+
+    printf("messageSize=%zu messages=%ld, caller thread != connection loop\n", messageSize, (long)messages);
+    for (const Mode &mode : modes)
+    {
+        const int64_t target = received.load() + messages * static_cast<int64_t>(messageSize);
+        const int64_t allocations = g_allocations.load();
+        const int64_t allocatedBytes = g_allocatedBytes.load();
+        const int64_t start = nowMicros();
+        for (int64_t i = 0; i < messages; ++i)
+        {
+            mode.sendOne();
+        }
+        while (received.load() < target)
+        {
+            ::usleep(100);
+        }
+        const double elapsed = secondsSince(start);
+        printf("%-22s %6.2f allocs/msg %9.1f bytes allocated/msg %10.0f msgs/s\n", mode.name,
+            static_cast<double>(g_allocations.load() - allocations) / messages,
+            static_cast<double>(g_allocatedBytes.load() - allocatedBytes) / messages,
+            messages / elapsed);
+    }
+
+    serverConn.reset();
+    runInLoopAndWait(clientLoop, [&]() {
+        client->shutdown();
+        client.reset();
+    });
+    runInLoopAndWait(serverLoop, [&]() { server.reset(); });
+    return 0;
+}
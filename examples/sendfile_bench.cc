@@ -0,0 +1,175 @@
+// sendFile和普通Buffer路径的文件发送对比：服务器收到一个请求字节就把整个文件发过来，
+// 'f'用TcpConnection::sendFile（sendfile，不经过用户空间），'b'用pread读到用户空间再send
+// 每种大小至少传totalMB的数据（至少3次），客户端收完一个文件再请求下一个
+// 用法：sendfile_bench [maxMB=1024] [totalMB=2048] [dir=/tmp]
+
+#include "TcpServer.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+#include "bench_util.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace
+{
+
+// 写一个指定大小的文件，内容不全是0，避免稀疏文件读起来比真实文件快
+int createFile(const std::string &path, size_t size)
+{
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        perror("open");
+        ::exit(1);
+    }
+    std::vector<char> block(1024 * 1024);
+    for (size_t i = 0; i < block.size(); ++i)
+    {
+        block[i] = static_cast<char>(i * 131);
+    }
+    for (size_t written = 0; written < size; )
+    {
+        size_t n = std::min(block.size(), size - written);
+        if (::write(fd, block.data(), n) != static_cast<ssize_t>(n))
+        {
+            perror("write");
+            ::exit(1);
+        }
+        written += n;
+    }
+    return fd;
+}
+
+// 以前的做法：把文件读到用户空间再send，大文件分块读，每块都整块放进发送队列
+void sendByCopy(const TcpConnectionPtr &conn, int fd, size_t size)
+{
+    const size_t kChunk = 4 * 1024 * 1024;
+    for (size_t offset = 0; offset < size; offset += kChunk)
+    {
+        size_t n = std::min(kChunk, size - offset);
+        std::string chunk(n, '\0');
+        if (::pread(fd, &chunk[0], n, static_cast<off_t>(offset)) != static_cast<ssize_t>(n))
+        {
+            perror("pread");
+            ::exit(1);
+        }
+        conn->send(std::move(chunk));
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const size_t maxMB = argc > 1 ? ::atoi(argv[1]) : 1024;
+    const size_t totalMB = argc > 2 ? ::atoi(argv[2]) : 2048;
+    const std::string dir = argc > 3 ? argv[3] : "/tmp";
+    Logger::setMinLevel(ERROR);
+
+    std::vector<size_t> sizes;
+    for (size_t size = 4 * 1024; size <= maxMB * 1024 * 1024; size *= 16)
+    {
+        sizes.push_back(size);
+    }
+    if (sizes.back() != maxMB * 1024 * 1024 && maxMB * 1024 * 1024 > 4 * 1024)
+    {
+        sizes.push_back(maxMB * 1024 * 1024);
+    }
+    const std::string path = dir + "/mymuduo_sendfile_bench.dat";
+    int fd = createFile(path, sizes.back());
+
+    const InetAddress serverAddr(19003);
+    EventLoopThread serverThread;
+    EventLoop *serverLoop = serverThread.startLoop();
+    std::unique_ptr<TcpServer> server;
+    size_t fileSize = 0; // 只在发请求之前修改，请求经过TCP到达服务器，有先后关系
+    runInLoopAndWait(serverLoop, [&]() {
+        server.reset(new TcpServer(serverLoop, serverAddr, "FileServer"));
+        server->setConnectionCallback([](const TcpConnectionPtr&) {});
+        server->setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+            while (buf->readableBytes() > 0)
+            {
+                char mode = buf->readInt8();
+                if (mode == 'f')
+                {
+                    conn->sendFile(fd, 0, fileSize);
+                }
+                else
+                {
+                    sendByCopy(conn, fd, fileSize);
+                }
+            }
+        });
+        server->start();
+    });
+
+    EventLoop loop;
+    size_t sizeIndex = 0;
+    int modeIndex = 0;
+    const char kModes[] = { 'f', 'b' };
+    int rounds = 0;
+    int roundsLeft = 0;
+    size_t received = 0;
+    int64_t start = 0;
+
+    // 开始一组测试：一种大小、一种发送方式
+    std::function<void(const TcpConnectionPtr&)> startGroup = [&](const TcpConnectionPtr &conn) {
+        fileSize = sizes[sizeIndex];
+        rounds = std::max<int>(3, static_cast<int>(totalMB * 1024 * 1024 / fileSize));
+        roundsLeft = rounds;
+        received = 0;
+        start = nowMicros();
+        conn->send(&kModes[modeIndex], 1);
+    };
+
+    const ConnectionCallback onConnection = [&](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            startGroup(conn);
+        }
+    };
+    const MessageCallback onMessage = [&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        received += buf->readableBytes();
+        buf->retrieveAll();
+        if (received < fileSize)
+        {
+            return;
+        }
+        received = 0;
+        if (--roundsLeft > 0)
+        {
+            conn->send(&kModes[modeIndex], 1);
+            return;
+        }
+        const double elapsed = secondsSince(start);
+        printf("%-10s size=%10zu x%-6d %9.1f MB/s %10.1f us/file\n", kModes[modeIndex] == 'f' ? "sendFile" : "Buffer",
+            fileSize, rounds, static_cast<double>(fileSize) * rounds / elapsed / 1e6, elapsed * 1e6 / rounds);
+        if (++modeIndex == 2)
+        {
+            modeIndex = 0;
+            ++sizeIndex;
+        }
+        if (sizeIndex == sizes.size())
+        {
+            loop.quit();
+            return;
+        }
+        startGroup(conn);
+    };
+    TcpConnectionPtr client = connectTo(&loop, serverAddr, "FileClient", onConnection, onMessage);
+    loop.loop();
+
+    runInLoopAndWait(serverLoop, [&]() { server.reset(); });
+    ::close(fd);
+    ::unlink(path.c_str());
+    return 0;
+}
@@ -0,0 +1,110 @@
+// UdpServer回显的每秒包数：客户端的每个UdpSocket保持window个数据报在路上，收到一个回复就再发一个，
+// 客户端和服务器两边都是recvmmsg/sendmmsg批量收发；UDP会丢包，一段时间没有回复就重新发满window
+// 统计服务器每秒收到的包数、客户端每秒收到的回复数和服务器的丢包数
+// 用法：udp_bench [datagramSize=64] [sockets=4] [window=256] [seconds=5] [serverThreads=0]
+
+#include "UdpServer.h"
+#include "UdpSocket.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+#include "bench_util.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[])
+{
+    const size_t datagramSize = argc > 1 ? ::atoi(argv[1]) : 64;
+    const int numSockets = argc > 2 ? ::atoi(argv[2]) : 4;
+    const int window = argc > 3 ? ::atoi(argv[3]) : 256;
+    const double seconds = argc > 4 ? ::atof(argv[4]) : 5;
+    const int serverThreads = argc > 5 ? ::atoi(argv[5]) : 0;
+    Logger::setMinLevel(ERROR);
+
+    const InetAddress serverAddr(19017);
+    EventLoopThread serverThread;
+    EventLoop *serverLoop = serverThread.startLoop();
+    std::unique_ptr<UdpServer> server;
+    runInLoopAndWait(serverLoop, [&]() {
+        server.reset(new UdpServer(serverLoop, serverAddr, "UdpEcho"));
+        server->setThreadNum(serverThreads);
+        server->setMessageCallback([](UdpSocket *socket, const char *data, size_t len,
+                                      const InetAddress &peer, Timestamp) {
+            socket->send(data, len, peer);
+        });
+        server->start();
+    });
+
+    EventLoopThread clientThread;
+    EventLoop *clientLoop = clientThread.startLoop();
+    const std::string datagram(datagramSize, 'x');
+    std::vector<std::unique_ptr<UdpSocket>> sockets;
+    std::atomic<int64_t> replies(0);
+    std::atomic<bool> stopping(false);
+    // 下面两个只在客户端loop线程中访问
+    int64_t lastReplies = 0;
+    TimerId refillTimer;
+    runInLoopAndWait(clientLoop, [&]() {
+        for (int i = 0; i < numSockets; ++i)
+        {
+            sockets.emplace_back(new UdpSocket(clientLoop, InetAddress(0)));
+            sockets.back()->setMessageCallback([&](UdpSocket *socket, const char*, size_t,
+                                                   const InetAddress&, Timestamp) {
+                ++replies;
+                if (!stopping)
+                {
+                    socket->send(datagram, serverAddr);
+                }
+            });
+            sockets.back()->start();
+            for (int k = 0; k < window; ++k)
+            {
+                sockets.back()->send(datagram, serverAddr);
+            }
+        }
+        // 丢包以后在路上的数据报越来越少，一段时间没有回复说明全丢了，重新发满window
+        refillTimer = clientLoop->runEvery(0.05, [&]() {
+            const int64_t n = replies.load();
+            if (n == lastReplies)
+            {
+                for (auto &socket : sockets)
+                {
+                    for (int k = 0; k < window; ++k)
+                    {
+                        socket->send(datagram, serverAddr);
+                    }
+                }
+            }
+            lastReplies = n;
+        });
+    });
+
+    // 先跑一秒热身，再开始计数
+    ::sleep(1);
+    const uint64_t receivedBefore = server->packetsReceived();
+    const uint64_t droppedBefore = server->packetsDropped();
+    const int64_t repliesBefore = replies.load();
+    const Timestamp start = Timestamp::now();
+    ::usleep(static_cast<useconds_t>(seconds * 1e6));
+    const double elapsed = timeDifference(Timestamp::now(), start);
+    const uint64_t received = server->packetsReceived() - receivedBefore;
+    const uint64_t dropped = server->packetsDropped() - droppedBefore;
+    const int64_t echoed = replies.load() - repliesBefore;
+    printf("datagramSize=%zu sockets=%d window=%d serverThreads=%d: server %.0f pps, client %.0f pps, "
+        "%.1f MB/s, %lu dropped\n", datagramSize, numSockets, window, serverThreads, received / elapsed,
+        echoed / elapsed, received * datagramSize / elapsed / 1e6, (unsigned long)dropped);
+
+    // 不再发新的数据报，等路上的回复收完再关掉
+    stopping = true;
+    runInLoopAndWait(clientLoop, [&]() { clientLoop->cancel(refillTimer); });
+    ::usleep(200 * 1000);
+    runInLoopAndWait(clientLoop, [&]() { sockets.clear(); });
+    runInLoopAndWait(serverLoop, [&]() { server.reset(); });
+    return 0;
+}
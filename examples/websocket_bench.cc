@@ -0,0 +1,170 @@
+// WebSocketServer回显的吞吐量：客户端握手以后发带掩码的二进制帧，服务器原地去掉掩码再原样发回来，
+// 每个连接保持depth个消息在路上，收到一个回复就再发一个，默认测64字节和64KB两种消息
+// 用法：websocket_bench [connections=16] [depth=16] [seconds=5] [serverThreads=0] [messageSize...]
+
+#include "WebSocketServer.h"
+#include "WebSocketCodec.h"
+#include "TcpClient.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+#include "bench_util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace
+{
+
+// 客户端发的帧必须带掩码
+std::string makeMaskedFrame(size_t size)
+{
+    char header[WebSocketCodec::kMaxFrameHeaderLength];
+    size_t headerLength = WebSocketCodec::encodeFrameHeader(header, WebSocketCodec::kBinary, size);
+    header[1] = static_cast<char>(header[1] | 0x80);
+    const unsigned char key[4] = { 0x12, 0x34, 0x56, 0x78 };
+    std::string frame(header, headerLength);
+    frame.append(reinterpret_cast<const char*>(key), 4);
+    std::string payload(size, 'x');
+    WebSocketCodec::unmask(&payload[0], payload.size(), key);
+    frame += payload;
+    return frame;
+}
+
+// 取出buf中所有完整的帧，返回帧数
+int retrieveFrames(Buffer *buf)
+{
+    int frames = 0;
+    WebSocketCodec::FrameHeader header;
+    while (WebSocketCodec::parseFrameHeader(buf->peek(), buf->readableBytes(), &header) == 1
+        && buf->readableBytes() >= header.headerLength + header.payloadLength)
+    {
+        buf->retrieve(header.headerLength + header.payloadLength);
+        ++frames;
+    }
+    return frames;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const int numConnections = argc > 1 ? ::atoi(argv[1]) : 16;
+    const int depth = argc > 2 ? ::atoi(argv[2]) : 16;
+    const double seconds = argc > 3 ? ::atof(argv[3]) : 5;
+    const int serverThreads = argc > 4 ? ::atoi(argv[4]) : 0;
+    std::vector<size_t> sizes;
+    for (int i = 5; i < argc; ++i)
+    {
+        sizes.push_back(::atoi(argv[i]));
+    }
+    if (sizes.empty())
+    {
+        sizes.push_back(64);
+        sizes.push_back(64 * 1024);
+    }
+    Logger::setMinLevel(ERROR);
+
+    const InetAddress serverAddr(19015);
+    EventLoopThread serverThread;
+    EventLoop *serverLoop = serverThread.startLoop();
+    std::unique_ptr<WebSocketServer> server;
+    runInLoopAndWait(serverLoop, [&]() {
+        server.reset(new WebSocketServer(serverLoop, serverAddr, "WebSocketEcho"));
+        server->setThreadNum(serverThreads);
+        server->setMessageCallback([](const TcpConnectionPtr &conn, const StringPiece &message, bool, Timestamp) {
+            WebSocketServer::sendBinary(conn, message);
+        });
+        server->start();
+    });
+
+    EventLoopThread clientThread;
+    EventLoop *clientLoop = clientThread.startLoop();
+    const std::string handshake =
+        "GET /bench HTTP/1.1\r\n"
+        "Host: 127.0.0.1\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "\r\n";
+    std::atomic<int64_t> messages(0);
+    std::atomic<bool> stopping(false);
+
+    for (size_t size : sizes)
+    {
+        const std::string frame = makeMaskedFrame(size);
+        std::string frames;
+        for (int k = 0; k < depth; ++k)
+        {
+            frames += frame;
+        }
+        stopping = false;
+        std::vector<std::unique_ptr<TcpClient>> clients;
+        runInLoopAndWait(clientLoop, [&]() {
+            for (int i = 0; i < numConnections; ++i)
+            {
+                clients.emplace_back(new TcpClient(clientLoop, serverAddr, "WebSocketClient"));
+                clients.back()->setConnectionCallback([&](const TcpConnectionPtr &conn) {
+                    if (conn->connected())
+                    {
+                        conn->setContext(std::make_shared<bool>(false)); // 是否已经握手
+                        conn->send(handshake);
+                    }
+                });
+                clients.back()->setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+                    bool *upgraded = static_cast<bool*>(conn->getContext().get());
+                    if (!*upgraded)
+                    {
+                        const char *end = buf->peek() + buf->readableBytes();
+                        const char kHeaderEnd[] = "\r\n\r\n";
+                        const char *headerEnd = std::search(buf->peek(), end, kHeaderEnd, kHeaderEnd + 4);
+                        if (headerEnd == end)
+                        {
+                            return;
+                        }
+                        buf->retrieveUntil(headerEnd + 4);
+                        *upgraded = true;
+                        conn->send(frames);
+                    }
+                    const int n = retrieveFrames(buf);
+                    messages += n;
+                    if (!stopping)
+                    {
+                        for (int k = 0; k < n; ++k)
+                        {
+                            conn->send(frame);
+                        }
+                    }
+                });
+                clients.back()->connect();
+            }
+        });
+
+        // 先跑一秒热身，再开始计数
+        ::sleep(1);
+        const int64_t before = messages.load();
+        const Timestamp start = Timestamp::now();
+        ::usleep(static_cast<useconds_t>(seconds * 1e6));
+        const double elapsed = timeDifference(Timestamp::now(), start);
+        const int64_t n = messages.load() - before;
+        printf("messageSize=%zu connections=%d depth=%d serverThreads=%d: %.0f msgs/s, %.1f MB/s\n",
+            size, numConnections, depth, serverThreads, n / elapsed, n * size / elapsed / 1e6);
+
+        // 不再发新的消息，等路上的回复收完再断开
+        stopping = true;
+        ::usleep(200 * 1000);
+        runInLoopAndWait(clientLoop, [&]() { clients.clear(); });
+        ::usleep(100 * 1000);
+    }
+
+    runInLoopAndWait(serverLoop, [&]() { server.reset(); });
+    return 0;
+}
@@ -0,0 +1,131 @@
+// MSG_ZEROCOPY的收益和负载大小的关系：服务器收到一个请求字节就把一批共享的payload发过来，
+// 'z'开启zero copy（阈值为0，每一块都用MSG_ZEROCOPY），'c'关闭（普通writev拷贝），
+// 每种大小两种方式各传totalMB的数据，看从多大的块开始zero copy比拷贝快
+// 注意：loopback上内核会把zero copy的数据再拷贝一次（SO_EE_CODE_ZEROCOPY_COPIED），要看真实的收益需要跨机器测
+// 用法：zerocopy_bench [maxKB=16384] [totalMB=1024] [batchMB=16]
+
+#include "TcpServer.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+#include "bench_util.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char *argv[])
+{
+    const size_t maxKB = argc > 1 ? ::atoi(argv[1]) : 16384;
+    const size_t totalMB = argc > 2 ? ::atoi(argv[2]) : 1024;
+    const size_t batchMB = argc > 3 ? ::atoi(argv[3]) : 16;
+    Logger::setMinLevel(ERROR);
+
+    std::vector<size_t> sizes;
+    for (size_t size = 4 * 1024; size <= maxKB * 1024; size *= 4)
+    {
+        sizes.push_back(size);
+    }
+
+    const InetAddress serverAddr(19004);
+    EventLoopThread serverThread;
+    EventLoop *serverLoop = serverThread.startLoop();
+    std::unique_ptr<TcpServer> server;
+    // payload和batch只在发请求之前修改，请求经过TCP到达服务器，有先后关系
+    PayloadPtr payload;
+    size_t batch = 0;
+    bool zeroCopySupported = true;
+    runInLoopAndWait(serverLoop, [&]() {
+        server.reset(new TcpServer(serverLoop, serverAddr, "ZeroCopyServer"));
+        server->setConnectionCallback([](const TcpConnectionPtr&) {});
+        server->setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+            while (buf->readableBytes() > 0)
+            {
+                char mode = buf->readInt8();
+                if (!conn->setZeroCopy(mode == 'z', 0) && mode == 'z')
+                {
+                    zeroCopySupported = false;
+                }
+                for (size_t i = 0; i < batch; ++i)
+                {
+                    conn->send(payload);
+                }
+            }
+        });
+        server->start();
+    });
+
+    EventLoop loop;
+    size_t sizeIndex = 0;
+    int modeIndex = 0;
+    const char kModes[] = { 'c', 'z' };
+    int rounds = 0;
+    int roundsLeft = 0;
+    size_t batchBytes = 0;
+    size_t received = 0;
+    int64_t start = 0;
+
+    // 开始一组测试：一种大小、一种发送方式
+    std::function<void(const TcpConnectionPtr&)> startGroup = [&](const TcpConnectionPtr &conn) {
+        const size_t size = sizes[sizeIndex];
+        if (modeIndex == 0)
+        {
+            payload = makePayload(std::string(size, 'x'));
+        }
+        batch = std::max<size_t>(1, batchMB * 1024 * 1024 / size);
+        batchBytes = batch * size;
+        rounds = std::max<int>(3, static_cast<int>(totalMB * 1024 * 1024 / batchBytes));
+        roundsLeft = rounds;
+        received = 0;
+        start = nowMicros();
+        conn->send(&kModes[modeIndex], 1);
+    };
+
+    const ConnectionCallback onConnection = [&](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            startGroup(conn);
+        }
+    };
+    const MessageCallback onMessage = [&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        received += buf->readableBytes();
+        buf->retrieveAll();
+        if (received < batchBytes)
+        {
+            return;
+        }
+        received = 0;
+        if (--roundsLeft > 0)
+        {
+            conn->send(&kModes[modeIndex], 1);
+            return;
+        }
+        const double elapsed = secondsSince(start);
+        printf("%-9s size=%9zu %9.1f MB/s\n", kModes[modeIndex] == 'z' ? "zerocopy" : "copy",
+            sizes[sizeIndex], static_cast<double>(batchBytes) * rounds / elapsed / 1e6);
+        if (++modeIndex == 2)
+        {
+            modeIndex = 0;
+            ++sizeIndex;
+        }
+        if (sizeIndex == sizes.size())
+        {
+            loop.quit();
+            return;
+        }
+        startGroup(conn);
+    };
+    TcpConnectionPtr client = connectTo(&loop, serverAddr, "ZeroCopyClient", onConnection, onMessage);
+    loop.loop();
+
+    runInLoopAndWait(serverLoop, [&]() { server.reset(); });
+    if (!zeroCopySupported)
+    {
+        printf("SO_ZEROCOPY not supported by this kernel, 'zerocopy' rows used the copy path\n");
+    }
+    return 0;
+}
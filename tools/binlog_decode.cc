@@ -0,0 +1,310 @@
+// 把BinaryLogging写的二进制日志还原成文本，格式和Logger的文本日志一样
+// 用法：binlog_decode file.binlog > file.log
+
+#include "BinaryLogging.h"
+#include "Logger.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+struct Format
+{
+    int level;
+    std::string file;
+    uint32_t line;
+    std::string fmt;
+    std::string types;
+};
+
+static bool readBytes(FILE *fp, void *data, size_t len)
+{
+    return ::fread(data, 1, len, fp) == len;
+}
+
+static bool readU32(FILE *fp, uint32_t *v)
+{
+    return readBytes(fp, v, sizeof *v);
+}
+
+static bool readString(FILE *fp, std::string *s)
+{
+    uint32_t len = 0;
+    if (!readU32(fp, &len))
+    {
+        return false;
+    }
+    s->resize(len);
+    return len == 0 || readBytes(fp, &(*s)[0], len);
+}
+
+static const char* levelName(int level)
+{
+    switch (level)
+    {
+    case INFO: return "[INFO]";
+    case ERROR: return "[ERROR]";
+    case FATAL: return "[FATAL]";
+    case DEBUG: return "[DEBUG]";
+    default: return "";
+    }
+}
+
+// 一段记录的读指针，越界的时候返回false
+class Reader
+{
+public:
+    Reader(const char *data, size_t len) : data_(data), len_(len), pos_(0) {}
+
+    bool done() const { return pos_ >= len_; }
+    bool read(void *out, size_t n)
+    {
+        if (len_ - pos_ < n)
+        {
+            return false;
+        }
+        ::memcpy(out, data_ + pos_, n);
+        pos_ += n;
+        return true;
+    }
+    bool readString(std::string *s)
+    {
+        uint32_t n = 0;
+        if (!read(&n, sizeof n) || len_ - pos_ < n)
+        {
+            return false;
+        }
+        s->assign(data_ + pos_, n);
+        pos_ += n;
+        return true;
+    }
+private:
+    const char *data_;
+    size_t len_;
+    size_t pos_;
+};
+
+struct Arg
+{
+    char type;
+    uint64_t bits;
+    std::string str;
+};
+
+// 按原来的格式串把参数格式化，长度修饰符统一换成和记录中的8字节值对应的
+static std::string formatMessage(const Format &format, const std::vector<Arg> &args)
+{
+    std::string out;
+    const std::string &fmt = format.fmt;
+    size_t argIndex = 0;
+    char buf[512];
+    for (size_t i = 0; i < fmt.size(); ++i)
+    {
+        if (fmt[i] != '%')
+        {
+            out += fmt[i];
+            continue;
+        }
+        if (i + 1 < fmt.size() && fmt[i + 1] == '%')
+        {
+            out += '%';
+            ++i;
+            continue;
+        }
+
+        std::string spec = "%";
+        size_t j = i + 1;
+        while (j < fmt.size() && strchr("-+ #0123456789.", fmt[j]))
+        {
+            spec += fmt[j++];
+        }
+        while (j < fmt.size() && strchr("hlLqjzt", fmt[j]))
+        {
+            ++j;
+        }
+        if (j >= fmt.size())
+        {
+            out += fmt.substr(i);
+            break;
+        }
+        const char conv = fmt[j];
+        i = j;
+
+        if (argIndex >= args.size())
+        {
+            out += "(missing)";
+            continue;
+        }
+        const Arg &arg = args[argIndex++];
+        if (strchr("di", conv))
+        {
+            spec += "ll";
+            spec += conv;
+            long long v = arg.type == 'u' ? static_cast<long long>(arg.bits) : static_cast<long long>(static_cast<int64_t>(arg.bits));
+            snprintf(buf, sizeof buf, spec.c_str(), v);
+        }
+        else if (strchr("uxXo", conv))
+        {
+            spec += "ll";
+            spec += conv;
+            snprintf(buf, sizeof buf, spec.c_str(), static_cast<unsigned long long>(arg.bits));
+        }
+        else if (conv == 'c')
+        {
+            spec += conv;
+            snprintf(buf, sizeof buf, spec.c_str(), static_cast<int>(arg.bits));
+        }
+        else if (strchr("feEgGaA", conv))
+        {
+            double v = 0;
+            if (arg.type == 'f')
+            {
+                ::memcpy(&v, &arg.bits, sizeof v);
+            }
+            spec += conv;
+            snprintf(buf, sizeof buf, spec.c_str(), v);
+        }
+        else if (conv == 's')
+        {
+            spec += conv;
+            snprintf(buf, sizeof buf, spec.c_str(), arg.type == 's' ? arg.str.c_str() : "(bad)");
+        }
+        else if (conv == 'p')
+        {
+            spec += conv;
+            snprintf(buf, sizeof buf, spec.c_str(), reinterpret_cast<void*>(static_cast<uintptr_t>(arg.bits)));
+        }
+        else
+        {
+            snprintf(buf, sizeof buf, "%%%c", conv);
+        }
+        out += buf;
+    }
+    return out;
+}
+
+static bool decodeChunk(const std::unordered_map<uint32_t, Format> &formats, const std::string &chunk, uint32_t tid)
+{
+    Reader reader(chunk.data(), chunk.size());
+    std::vector<Arg> args;
+    while (!reader.done())
+    {
+        uint32_t fmtId = 0;
+        uint64_t ns = 0;
+        if (!reader.read(&fmtId, sizeof fmtId) || !reader.read(&ns, sizeof ns))
+        {
+            return false;
+        }
+        auto it = formats.find(fmtId);
+        if (it == formats.end())
+        {
+            fprintf(stderr, "unknown format id %u in thread %u\n", fmtId, tid);
+            return false;
+        }
+        const Format &format = it->second;
+
+        args.clear();
+        for (char type : format.types)
+        {
+            Arg arg;
+            arg.type = type;
+            arg.bits = 0;
+            bool ok = type == 's' ? reader.readString(&arg.str) : reader.read(&arg.bits, sizeof arg.bits);
+            if (!ok)
+            {
+                return false;
+            }
+            args.push_back(std::move(arg));
+        }
+
+        time_t seconds = static_cast<time_t>(ns / 1000000000);
+        struct tm tm;
+        ::localtime_r(&seconds, &tm);
+        char timebuf[64] = {0};
+        snprintf(timebuf, sizeof timebuf, "%4d/%02d/%02d %02d:%02d:%02d.%06d",
+            tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+            tm.tm_hour, tm.tm_min, tm.tm_sec,
+            static_cast<int>(ns % 1000000000 / 1000));
+
+        std::string line = levelName(format.level);
+        line += timebuf;
+        line += " : ";
+        line += formatMessage(format, args);
+        line += '\n';
+        ::fwrite(line.data(), 1, line.size(), stdout);
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s file.binlog\n", argv[0]);
+        return 1;
+    }
+    FILE *fp = ::fopen(argv[1], "rb");
+    if (fp == nullptr)
+    {
+        perror("fopen");
+        return 1;
+    }
+
+    char magic[sizeof BinaryLogging::kMagic];
+    if (!readBytes(fp, magic, sizeof magic) || ::memcmp(magic, BinaryLogging::kMagic, sizeof magic) != 0)
+    {
+        fprintf(stderr, "%s is not a binary log\n", argv[1]);
+        return 1;
+    }
+
+    std::unordered_map<uint32_t, Format> formats;
+    std::string chunk;
+    int type = 0;
+    // 最后一段可能因为进程崩溃没写完，读到一半就结束
+    while ((type = ::fgetc(fp)) != EOF)
+    {
+        bool ok = false;
+        if (type == 'F')
+        {
+            uint32_t id = 0;
+            Format format;
+            ok = readU32(fp, &id) && (format.level = ::fgetc(fp)) != EOF && readU32(fp, &format.line)
+                && readString(fp, &format.file) && readString(fp, &format.fmt) && readString(fp, &format.types);
+            if (ok)
+            {
+                formats[id] = std::move(format);
+            }
+        }
+        else if (type == 'C')
+        {
+            uint32_t tid = 0;
+            ok = readU32(fp, &tid) && readString(fp, &chunk);
+            if (ok && !decodeChunk(formats, chunk, tid))
+            {
+                fprintf(stderr, "corrupted records in thread %u\n", tid);
+            }
+        }
+        else if (type == 'D')
+        {
+            uint32_t tid = 0;
+            uint64_t dropped = 0;
+            ok = readU32(fp, &tid) && readBytes(fp, &dropped, sizeof dropped);
+            if (ok)
+            {
+                printf("[ERROR] thread %u dropped %llu records in total, ring buffer was full\n",
+                    tid, static_cast<unsigned long long>(dropped));
+            }
+        }
+        if (!ok)
+        {
+            fprintf(stderr, "truncated or unknown entry '%c'\n", type);
+            break;
+        }
+    }
+    ::fclose(fp);
+    return 0;
+}